@@ -0,0 +1,153 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "utility.h"
+
+/* the union keeps the chunk payload maximally aligned */
+struct ArenaChunk {
+  union {
+    struct {
+      ArenaChunk   *next;
+      unsigned long size;
+    } header;
+    long double align_ld;
+    void       *align_ptr;
+    long        align_l;
+  } u;
+};
+
+/* `chunks` and `large` are ordered newest first; `spare` holds rewound chunks for reuse */
+struct Arena {
+  ArenaChunk   *chunks;
+  ArenaChunk   *large;
+  ArenaChunk   *spare;
+  unsigned long chunk_size;
+  unsigned long offset;
+  unsigned long used;
+  unsigned long reserved;
+};
+
+#define CHUNK_DATA(chunk) ((char *) ((chunk) + 1))
+
+static ArenaChunk *chunk_new(Arena *arena, unsigned long size)
+{
+  ArenaChunk *chunk    = xmalloc(sizeof(ArenaChunk) + size);
+  chunk->u.header.size = size;
+  arena->reserved += size;
+  return chunk;
+}
+
+static void chunk_free_list(ArenaChunk *chunk)
+{
+  while (chunk) {
+    ArenaChunk *next = chunk->u.header.next;
+    free(chunk);
+    chunk = next;
+  }
+}
+
+Arena *arena_new(unsigned long chunk_size)
+{
+  Arena *arena      = xmalloc(sizeof(Arena));
+  arena->chunks     = NULL;
+  arena->large      = NULL;
+  arena->spare      = NULL;
+  arena->chunk_size = chunk_size;
+  arena->offset     = 0;
+  arena->used       = 0;
+  arena->reserved   = 0;
+  return arena;
+}
+
+void arena_free(Arena *arena)
+{
+  if (arena) {
+    chunk_free_list(arena->chunks);
+    chunk_free_list(arena->large);
+    chunk_free_list(arena->spare);
+    free(arena);
+  }
+}
+
+void *arena_alloc(Arena *arena, unsigned long size, unsigned long align)
+{
+  unsigned long offset = (arena->offset + align - 1) & ~(align - 1);
+
+  if (!arena->chunks || offset + size > arena->chunks->u.header.size) {
+    ArenaChunk *chunk;
+    if (size > arena->chunk_size / 4) {
+      chunk                = chunk_new(arena, size);
+      chunk->u.header.next = arena->large;
+      arena->large         = chunk;
+      arena->used += size;
+      return CHUNK_DATA(chunk);
+    }
+
+    if (arena->spare) {
+      chunk        = arena->spare;
+      arena->spare = chunk->u.header.next;
+    } else {
+      chunk = chunk_new(arena, arena->chunk_size);
+    }
+    chunk->u.header.next = arena->chunks;
+    arena->chunks        = chunk;
+    offset               = 0;
+  }
+
+  arena->offset = offset + size;
+  arena->used += size;
+  return CHUNK_DATA(arena->chunks) + offset;
+}
+
+void arena_mark(const Arena *arena, ArenaMark *mark)
+{
+  mark->_chunk  = arena->chunks;
+  mark->_large  = arena->large;
+  mark->_offset = arena->offset;
+  mark->_used   = arena->used;
+}
+
+void arena_rewind(Arena *arena, const ArenaMark *mark)
+{
+  while (arena->chunks != mark->_chunk) {
+    ArenaChunk *chunk    = arena->chunks;
+    arena->chunks        = chunk->u.header.next;
+    chunk->u.header.next = arena->spare;
+    arena->spare         = chunk;
+  }
+  while (arena->large != mark->_large) {
+    ArenaChunk *chunk = arena->large;
+    arena->large      = chunk->u.header.next;
+    arena->reserved -= chunk->u.header.size;
+    free(chunk);
+  }
+  arena->offset = mark->_offset;
+  arena->used   = mark->_used;
+}
+
+unsigned long arena_used(const Arena *arena)
+{
+  return arena->used;
+}
+
+unsigned long arena_reserved(const Arena *arena)
+{
+  return arena->reserved;
+}
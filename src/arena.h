@@ -0,0 +1,40 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+typedef struct ArenaChunk ArenaChunk;
+typedef struct ArenaMark  ArenaMark;
+typedef struct Arena      Arena;
+
+struct ArenaMark {
+  ArenaChunk   *_chunk;
+  ArenaChunk   *_large;
+  unsigned long _offset;
+  unsigned long _used;
+};
+
+Arena *arena_new(unsigned long chunk_size);
+void   arena_free(Arena *arena);
+
+void         *arena_alloc(Arena *arena, unsigned long size, unsigned long align);
+void          arena_mark(const Arena *arena, ArenaMark *mark);
+void          arena_rewind(Arena *arena, const ArenaMark *mark);
+unsigned long arena_used(const Arena *arena);
+unsigned long arena_reserved(const Arena *arena);
+
+#endif
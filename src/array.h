@@ -17,6 +17,10 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include <stdlib.h>
+
+#include "utility.h"
+
 typedef struct Array Array;
 
 Array *array_new(unsigned long size);
@@ -38,4 +42,89 @@ void          array_pop_count(Array *array, unsigned long count);
 void          array_clear(Array *array);
 void         *array_steal(Array *array);
 
+/* typed array for hot paths; `Type` is stored by value and copied by assignment */
+#define DEFINE_ARRAY(Name, prefix, Type)                                         \
+  typedef struct Name Name;                                                      \
+                                                                                 \
+  struct Name {                                                                  \
+    Type         *data;                                                          \
+    unsigned long count;                                                         \
+    unsigned long capacity;                                                      \
+  };                                                                             \
+                                                                                 \
+  static INLINE void prefix##_init(Name *array)                                  \
+  {                                                                              \
+    array->data     = NULL;                                                      \
+    array->count    = 0;                                                         \
+    array->capacity = 0;                                                         \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_deinit(Name *array)                                \
+  {                                                                              \
+    free(array->data);                                                           \
+  }                                                                              \
+                                                                                 \
+  static INLINE unsigned long prefix##_count(const Name *array)                  \
+  {                                                                              \
+    return array->count;                                                         \
+  }                                                                              \
+                                                                                 \
+  static INLINE Type *prefix##_data(const Name *array)                           \
+  {                                                                              \
+    return array->data;                                                          \
+  }                                                                              \
+                                                                                 \
+  static INLINE Type *prefix##_at(const Name *array, unsigned long index)        \
+  {                                                                              \
+    return array->data + index;                                                  \
+  }                                                                              \
+                                                                                 \
+  static INLINE Type *prefix##_back(const Name *array)                           \
+  {                                                                              \
+    return array->data + array->count - 1;                                       \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_reserve(Name *array, unsigned long capacity)       \
+  {                                                                              \
+    if (array->capacity < capacity) {                                            \
+      unsigned long new_capacity = array->capacity ? array->capacity : 16;       \
+      while (new_capacity < capacity) {                                          \
+        new_capacity *= 2;                                                       \
+      }                                                                          \
+      array->data     = xrealloc(array->data, sizeof(Type) * new_capacity);      \
+      array->capacity = new_capacity;                                            \
+    }                                                                            \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_push(Name *array, Type value)                      \
+  {                                                                              \
+    if (array->count == array->capacity) {                                       \
+      prefix##_reserve(array, array->count + 1);                                 \
+    }                                                                            \
+    array->data[array->count++] = value;                                         \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_fill(Name *array, unsigned long count, Type value) \
+  {                                                                              \
+    prefix##_reserve(array, count);                                              \
+    while (array->count < count) {                                               \
+      array->data[array->count++] = value;                                       \
+    }                                                                            \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_pop_count(Name *array, unsigned long count)        \
+  {                                                                              \
+    array->count = array->count > count ? array->count - count : 0;              \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_pop(Name *array)                                   \
+  {                                                                              \
+    prefix##_pop_count(array, 1);                                                \
+  }                                                                              \
+                                                                                 \
+  static INLINE void prefix##_clear(Name *array)                                 \
+  {                                                                              \
+    array->count = 0;                                                            \
+  }
+
 #endif
@@ -0,0 +1,47 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+/* atomic_increment / atomic_decrement operate on `unsigned long` and evaluate to the new value */
+
+#ifdef MPPLC_THREAD_SAFE
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#define atomic_increment(ptr) __atomic_add_fetch((ptr), 1ul, __ATOMIC_RELAXED)
+#define atomic_decrement(ptr) __atomic_sub_fetch((ptr), 1ul, __ATOMIC_ACQ_REL)
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define atomic_increment(ptr) ((unsigned long) _InterlockedIncrement((volatile long *) (ptr)))
+#define atomic_decrement(ptr) ((unsigned long) _InterlockedDecrement((volatile long *) (ptr)))
+
+#else
+#error "MPPLC_THREAD_SAFE requires GCC, Clang or MSVC"
+#endif
+
+#else
+
+#define atomic_increment(ptr) (++*(ptr))
+#define atomic_decrement(ptr) (--*(ptr))
+
+#endif
+
+#endif
@@ -21,6 +21,7 @@
 
 #include "array.h"
 #include "canvas.h"
+#include "string_builder.h"
 #include "terminal.h"
 #include "utility.h"
 
@@ -41,10 +42,11 @@ struct CanvasCell {
 };
 
 struct Canvas {
-  Array        *lines;
-  unsigned long current_line;
-  unsigned long current_column;
-  CanvasStyle   style;
+  Array         *lines;
+  StringBuilder *buffer;
+  unsigned long  current_line;
+  unsigned long  current_column;
+  CanvasStyle    style;
 };
 
 Canvas *canvas_new(void)
@@ -52,6 +54,7 @@ Canvas *canvas_new(void)
   Canvas *canvas = malloc(sizeof(Canvas));
   Array  *line   = array_new(sizeof(CanvasCell));
   canvas->lines  = array_new(sizeof(Array *));
+  canvas->buffer = string_builder_new();
   array_push(canvas->lines, &line);
   canvas->current_line    = 0;
   canvas->current_column  = 0;
@@ -72,12 +75,11 @@ void canvas_free(Canvas *canvas)
       array_free(*line);
     }
     array_free(canvas->lines);
+    string_builder_free(canvas->buffer);
     free(canvas);
   }
 }
 
-#define BUFFER_SIZE 1024
-
 void canvas_next_line(Canvas *canvas)
 {
   ++canvas->current_line;
@@ -199,43 +201,40 @@ void canvas_style(Canvas *canvas, int attr, ...)
 
 void canvas_write(Canvas *canvas, const char *format, ...)
 {
-  va_list args;
-  Array **line  = array_at(canvas->lines, canvas->current_line);
-  FILE   *file  = tmpfile();
-  long    index = 0;
-  char    buffer[BUFFER_SIZE + 1];
+  va_list       args;
+  Array       **line = array_at(canvas->lines, canvas->current_line);
+  const char   *text;
+  unsigned long length;
+  unsigned long index = 0;
 
+  string_builder_clear(canvas->buffer);
   va_start(args, format);
-  vfprintf(file, format, args);
+  string_builder_vprintf(canvas->buffer, format, args);
   va_end(args);
-  rewind(file);
-  while (fgets(buffer + index, BUFFER_SIZE - index, file)) {
-    while (buffer[index]) {
-      long size = utf8_len(buffer + index, BUFFER_SIZE - index);
-      if (size < 0) {
-        int remain = strlen(buffer + index);
-        memmove(buffer, buffer + index, remain);
-        index = remain;
-        break;
-      }
 
-      {
-        unsigned long initial_line_width = array_count(*line);
-        CanvasCell    cell;
-        cell.style = canvas->style;
-        cell.size  = size;
-        memcpy(cell.character, buffer + index, size);
-        if (canvas->current_column < initial_line_width) {
-          memcpy(array_at(*line, canvas->current_column), &cell, sizeof(CanvasCell));
-        } else {
-          array_push(*line, &cell);
-        }
-        ++canvas->current_column;
-        index += size;
+  text   = string_builder_data(canvas->buffer);
+  length = string_builder_length(canvas->buffer);
+  while (index < length) {
+    long size = utf8_len(text + index, length - index);
+    if (size < 0) {
+      break;
+    }
+
+    {
+      unsigned long initial_line_width = array_count(*line);
+      CanvasCell    cell;
+      cell.style = canvas->style;
+      cell.size  = size;
+      memcpy(cell.character, text + index, size);
+      if (canvas->current_column < initial_line_width) {
+        memcpy(array_at(*line, canvas->current_column), &cell, sizeof(CanvasCell));
+      } else {
+        array_push(*line, &cell);
       }
+      ++canvas->current_column;
+      index += size;
     }
   }
-  fclose(file);
 }
 
 unsigned long canvas_line(const Canvas *canvas)
@@ -19,22 +19,49 @@
 #include <string.h>
 
 #include "array.h"
+#include "atomic.h"
 #include "compiler.h"
 #include "context.h"
 #include "context_fwd.h"
 #include "mppl_syntax.h"
 #include "mppl_syntax_ext.h"
 #include "report.h"
+#include "resolver.h"
 #include "string.h"
 #include "syntax_kind.h"
 #include "syntax_tree.h"
+#include "thread.h"
 #include "utility.h"
 
-typedef struct Checker Checker;
+typedef struct CheckJob  CheckJob;
+typedef struct CheckPool CheckPool;
+typedef struct Checker   Checker;
 
+/* the body of a procedure whose reports go after the first `position` ones of the program */
+struct CheckJob {
+  const MpplProcDecl *syntax;
+  unsigned long       position;
+  Array              *errors;
+};
+
+DEFINE_ARRAY(CheckJobArray, check_job_array, CheckJob)
+
+struct CheckPool {
+  const MpplAstWalker *walker;
+  Ctx                 *ctx;
+  CheckJobArray       *jobs;
+  unsigned long        next;
+};
+
+/* `resolver` is set when names are resolved during the same walk, and is
+   NULL when `mpplc_resolve` has already run. procedure bodies are queued
+   to `jobs` instead of being walked when it is set. `errors` also
+   collects warnings, which do not fail the check */
 struct Checker {
-  Ctx   *ctx;
-  Array *errors;
+  Ctx           *ctx;
+  Resolver      *resolver;
+  CheckJobArray *jobs;
+  Array         *errors;
 };
 
 static const char *op_to_str(SyntaxKind kind)
@@ -71,6 +98,29 @@ static const char *op_to_str(SyntaxKind kind)
 
 static const Type *check_expr(Checker *checker, const AnyMpplExpr *syntax);
 
+static const Def *resolve_var(Checker *checker, const MpplToken *name_syntax)
+{
+  if (checker->resolver) {
+    return resolver_resolve_var(checker->resolver, name_syntax);
+  } else {
+    return ctx_resolve(checker->ctx, (const SyntaxTree *) name_syntax, NULL);
+  }
+}
+
+static const Def *resolve_proc(Checker *checker, const MpplToken *name_syntax)
+{
+  if (checker->resolver) {
+    return resolver_resolve_proc(checker->resolver, name_syntax);
+  } else {
+    return ctx_resolve(checker->ctx, (const SyntaxTree *) name_syntax, NULL);
+  }
+}
+
+static const Type *type_of_def(Checker *checker, const Def *def)
+{
+  return def ? ctx_type_of(checker->ctx, def_syntax(def), NULL) : NULL;
+}
+
 static void error_binary_expr_invalid_operand(
   const Checker    *checker,
   const SyntaxTree *node, const SyntaxTree *op_token,
@@ -154,6 +204,116 @@ static void error_relational_mismatched_type(
   free(rhs_type_string);
 }
 
+static void warn_constant_overflow(Checker *checker, const SyntaxTree *node, long value)
+{
+  unsigned long offset = syntax_tree_offset(node);
+  unsigned long length = syntax_tree_text_length(node);
+
+  Report *report = report_new(REPORT_KIND_WARN, offset, "constant expression overflows `integer`");
+  report_annotation(report, offset, offset + length, "evaluates to %ld, which does not fit in 16 bits", value);
+  array_push(checker->errors, &report);
+}
+
+static void warn_constant_zero_division(Checker *checker, const SyntaxTree *node, const SyntaxTree *rhs)
+{
+  unsigned long rhs_offset = syntax_tree_offset(rhs);
+  unsigned long rhs_length = syntax_tree_text_length(rhs);
+
+  Report *report = report_new(REPORT_KIND_WARN, syntax_tree_offset(node), "constant expression divides by zero");
+  report_annotation(report, rhs_offset, rhs_offset + rhs_length, "divisor evaluates to 0");
+  array_push(checker->errors, &report);
+}
+
+/* folds a well-typed binary expression whose value is known at compile time.
+   arithmetic follows the 16-bit semantics of the generated code: unary minus wraps,
+   while an overflowing `+`, `-`, `*` or `div` and a division by zero are warned about
+   and left unfolded, so that the backends keep the run-time check. the expression may
+   sit in code that never runs, like `if false then x := 1 div 0`.
+   the rhs of `and` and `or` is not evaluated when the lhs decides the result */
+static void fold_binary_expr(Checker *checker, const MpplBinaryExpr *syntax,
+  SyntaxKind op, const AnyMpplExpr *lhs, const AnyMpplExpr *rhs)
+{
+  long lhs_value, rhs_value, value;
+  int  lhs_folded = lhs && ctx_folded(checker->ctx, (const SyntaxTree *) lhs, &lhs_value);
+  int  rhs_folded = ctx_folded(checker->ctx, (const SyntaxTree *) rhs, &rhs_value);
+
+  if (!lhs) {
+    if (!rhs_folded) {
+      return;
+    }
+    value = op == SYNTAX_MINUS_TOKEN && rhs_value != -32768 ? -rhs_value : rhs_value;
+  } else if (op == SYNTAX_AND_KW || op == SYNTAX_OR_KW) {
+    if (lhs_folded && lhs_value == (op == SYNTAX_OR_KW)) {
+      value = lhs_value;
+    } else if (lhs_folded && rhs_folded) {
+      value = rhs_value;
+    } else {
+      return;
+    }
+  } else if (!lhs_folded || !rhs_folded) {
+    return;
+  } else {
+    switch (op) {
+    case SYNTAX_EQUAL_TOKEN:
+      value = lhs_value == rhs_value;
+      break;
+
+    case SYNTAX_NOTEQ_TOKEN:
+      value = lhs_value != rhs_value;
+      break;
+
+    case SYNTAX_LESS_TOKEN:
+      value = lhs_value < rhs_value;
+      break;
+
+    case SYNTAX_LESSEQ_TOKEN:
+      value = lhs_value <= rhs_value;
+      break;
+
+    case SYNTAX_GREATER_TOKEN:
+      value = lhs_value > rhs_value;
+      break;
+
+    case SYNTAX_GREATEREQ_TOKEN:
+      value = lhs_value >= rhs_value;
+      break;
+
+    case SYNTAX_PLUS_TOKEN:
+      value = lhs_value + rhs_value;
+      break;
+
+    case SYNTAX_MINUS_TOKEN:
+      value = lhs_value - rhs_value;
+      break;
+
+    case SYNTAX_STAR_TOKEN:
+      value = lhs_value * rhs_value;
+      break;
+
+    case SYNTAX_DIV_KW:
+      if (!rhs_value) {
+        warn_constant_zero_division(checker, (const SyntaxTree *) syntax, (const SyntaxTree *) rhs);
+        return;
+      }
+      /* rounds toward zero, which C90 leaves to the implementation for negative operands */
+      value = (lhs_value < 0 ? -lhs_value : lhs_value) / (rhs_value < 0 ? -rhs_value : rhs_value);
+      if ((lhs_value < 0) != (rhs_value < 0)) {
+        value = -value;
+      }
+      break;
+
+    default:
+      unreachable();
+    }
+
+    if (value < -32768 || value > 32767) {
+      warn_constant_overflow(checker, (const SyntaxTree *) syntax, value);
+      return;
+    }
+  }
+  ctx_fold(checker->ctx, (const SyntaxTree *) syntax, value);
+}
+
 static const Type *check_binary_expr(Checker *checker, const MpplBinaryExpr *syntax)
 {
   AnyMpplExpr *lhs_syntax = mppl_binary_expr__lhs(syntax);
@@ -246,6 +406,10 @@ static const Type *check_binary_expr(Checker *checker, const MpplBinaryExpr *syn
     }
   }
 
+  if (result) {
+    fold_binary_expr(checker, syntax, syntax_tree_kind((SyntaxTree *) op_syntax), lhs_syntax, rhs_syntax);
+  }
+
   mppl_unref(op_syntax);
   mppl_unref(lhs_syntax);
   mppl_unref(rhs_syntax);
@@ -256,6 +420,11 @@ static const Type *check_paren_expr(Checker *checker, const MpplParenExpr *synta
 {
   AnyMpplExpr *expr_syntax = mppl_paren_expr__expr(syntax);
   const Type  *type        = check_expr(checker, expr_syntax);
+  long         value;
+
+  if (ctx_folded(checker->ctx, (const SyntaxTree *) expr_syntax, &value)) {
+    ctx_fold(checker->ctx, (const SyntaxTree *) syntax, value);
+  }
 
   mppl_unref(expr_syntax);
   return ctx_type_of(checker->ctx, (const SyntaxTree *) syntax, type);
@@ -292,6 +461,10 @@ static const Type *check_not_expr(Checker *checker, const MpplNotExpr *syntax)
         (SyntaxTree *) syntax, (SyntaxTree *) not_token, (SyntaxTree *) expr_syntax, type);
       mppl_unref(not_token);
     } else {
+      long value;
+      if (ctx_folded(checker->ctx, (const SyntaxTree *) expr_syntax, &value)) {
+        ctx_fold(checker->ctx, (const SyntaxTree *) syntax, !value);
+      }
       result = ctx_type(TYPE_BOOLEAN);
     }
   }
@@ -339,6 +512,22 @@ static const Type *check_cast_expr(Checker *checker, const MpplCastExpr *syntax)
       error_cast_expr_invalid_operand(checker,
         (SyntaxTree *) syntax, (SyntaxTree *) type_syntax, cast_type, (SyntaxTree *) expr_syntax, type);
     } else {
+      long value;
+      if (ctx_folded(checker->ctx, (const SyntaxTree *) expr_syntax, &value)) {
+        switch (type_kind(cast_type)) {
+        case TYPE_BOOLEAN:
+          value = !!value;
+          break;
+
+        case TYPE_CHAR:
+          value &= 0xFF;
+          break;
+
+        default:
+          break;
+        }
+        ctx_fold(checker->ctx, (const SyntaxTree *) syntax, value);
+      }
       result = cast_type;
     }
   }
@@ -351,8 +540,8 @@ static const Type *check_cast_expr(Checker *checker, const MpplCastExpr *syntax)
 static const Type *check_entire_var(Checker *checker, const MpplEntireVar *syntax)
 {
   MpplToken  *name_syntax = mppl_entire_var__name(syntax);
-  const Def  *def         = ctx_resolve(checker->ctx, (const SyntaxTree *) name_syntax, NULL);
-  const Type *type        = ctx_type_of(checker->ctx, def_syntax(def), NULL);
+  const Def  *def         = resolve_var(checker, name_syntax);
+  const Type *type        = type_of_def(checker, def);
 
   mppl_unref(name_syntax);
   return ctx_type_of(checker->ctx, (const SyntaxTree *) syntax, type);
@@ -386,8 +575,8 @@ static const Type *check_indexed_var(Checker *checker, const MpplIndexedVar *syn
 {
   MpplToken   *name_syntax  = mppl_indexed_var__name(syntax);
   AnyMpplExpr *index_syntax = mppl_indexed_var__expr(syntax);
-  const Def   *def          = ctx_resolve(checker->ctx, (const SyntaxTree *) name_syntax, NULL);
-  const Type  *def_type     = ctx_type_of(checker->ctx, def_syntax(def), NULL);
+  const Def   *def          = resolve_var(checker, name_syntax);
+  const Type  *def_type     = type_of_def(checker, def);
   const Type  *index_type   = check_expr(checker, index_syntax);
   const Type  *result       = NULL;
 
@@ -424,17 +613,24 @@ static const Type *check_literal(Checker *checker, const AnyMpplLit *syntax)
 {
   switch (mppl_lit__kind(syntax)) {
   case MPPL_LIT_NUMBER: {
+    /* 32768 is only meaningful as the operand of unary minus, and reads as -32768 */
+    long value = mppl_lit_number__to_long((const MpplNumberLit *) syntax);
+    ctx_fold(checker->ctx, (const SyntaxTree *) syntax, value > 32767 ? value - 65536 : value);
     return ctx_type_of(checker->ctx, (const SyntaxTree *) syntax, ctx_type(TYPE_INTEGER));
   }
 
   case MPPL_LIT_STRING: {
     char       *text   = mppl_lit_string__to_string((const MpplStringLit *) syntax);
     const Type *result = strlen(text) == 1 ? ctx_type(TYPE_CHAR) : ctx_type(TYPE_STRING);
+    if (strlen(text) == 1) {
+      ctx_fold(checker->ctx, (const SyntaxTree *) syntax, (unsigned char) text[0]);
+    }
     free(text);
     return ctx_type_of(checker->ctx, (const SyntaxTree *) syntax, result);
   }
 
   case MPPL_LIT_BOOLEAN: {
+    ctx_fold(checker->ctx, (const SyntaxTree *) syntax, mppl_lit_boolean__to_int((const MpplBooleanLit *) syntax));
     return ctx_type_of(checker->ctx, (const SyntaxTree *) syntax, ctx_type(TYPE_BOOLEAN));
   }
 
@@ -474,6 +670,9 @@ static void visit_var_decl(const MpplAstWalker *walker, const MpplVarDecl *synta
   Checker     *self        = checker;
   AnyMpplType *type_syntax = mppl_var_decl__type(syntax);
   const Type  *type        = mppl_type__to_type(type_syntax, self->ctx);
+  if (self->resolver) {
+    resolver_define_vars(self->resolver, syntax);
+  }
   ctx_type_of(self->ctx, (const SyntaxTree *) syntax, type);
 
   mppl_unref(type_syntax);
@@ -544,19 +743,50 @@ static const TypeList *check_fml_param_list(Checker *checker, const MpplFmlParam
   }
 }
 
+static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax, void *checker)
+{
+  Checker *self = checker;
+  resolver_enter_program(self->resolver, syntax);
+  mppl_ast__walk_program(walker, syntax, checker);
+  resolver_leave(self->resolver);
+}
+
+static void visit_fml_param_sec(const MpplAstWalker *walker, const MpplFmlParamSec *syntax, void *checker)
+{
+  Checker *self = checker;
+  resolver_define_params(self->resolver, syntax);
+  mppl_ast__walk_fml_param_sec(walker, syntax, checker);
+}
+
 static void visit_proc_decl(const MpplAstWalker *walker, const MpplProcDecl *syntax, void *checker)
 {
-  Checker          *self              = checker;
-  MpplFmlParamList *param_list_syntax = mppl_proc_decl__fml_param_list(syntax);
-  const TypeList   *param_types       = check_fml_param_list(checker, param_list_syntax);
+  Checker          *self = checker;
+  MpplFmlParamList *param_list_syntax;
+  const TypeList   *param_types;
+
+  if (self->resolver) {
+    resolver_enter_proc_decl(self->resolver, syntax);
+  }
+  param_list_syntax = mppl_proc_decl__fml_param_list(syntax);
+  param_types       = check_fml_param_list(checker, param_list_syntax);
 
   if (param_types) {
     ctx_type_of(self->ctx, (const SyntaxTree *) syntax, ctx_proc_type(self->ctx, param_types));
   }
 
   mppl_unref(param_list_syntax);
-  mppl_ast__walk_proc_decl(walker, syntax, checker);
-  (void) walker;
+  if (self->jobs) {
+    CheckJob job;
+    job.syntax   = (const MpplProcDecl *) syntax_tree_ref((const SyntaxTree *) syntax);
+    job.position = array_count(self->errors);
+    job.errors   = array_new(sizeof(Report *));
+    check_job_array_push(self->jobs, job);
+  } else {
+    mppl_ast__walk_proc_decl(walker, syntax, checker);
+  }
+  if (self->resolver) {
+    resolver_leave(self->resolver);
+  }
 }
 
 static void error_assign_impossible(const Checker *checker, const SyntaxTree *lhs, const Type *lhs_type)
@@ -667,11 +897,11 @@ static void error_call_stmt_non_callable(Checker *checker, const MpplToken *synt
 }
 
 static void error_call_stmt_mismatched_param_count(
-  Checker *checker, const MpplActParamList *syntax,
+  Checker *checker, const SyntaxTree *syntax,
   const ProcType *proc_type, unsigned long act_param_count)
 {
-  unsigned long offset      = syntax_tree_offset((SyntaxTree *) syntax);
-  unsigned long length      = syntax_tree_text_length((SyntaxTree *) syntax);
+  unsigned long offset      = syntax_tree_offset(syntax);
+  unsigned long length      = syntax_tree_text_length(syntax);
   unsigned long param_count = type_list_count(proc_type_params(proc_type));
 
   Report *report = report_new(REPORT_KIND_ERROR, offset, "mismatched the number of parameter");
@@ -763,28 +993,32 @@ static const TypeList *check_act_param_list(Checker *checker, const MpplActParam
 
 static void visit_call_stmt(const MpplAstWalker *walker, const MpplCallStmt *syntax, void *checker)
 {
-  Checker    *self        = checker;
-  MpplToken  *name_syntax = mppl_call_stmt__name(syntax);
-  const Def  *def         = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-  const Type *type        = ctx_type_of(self->ctx, def_syntax(def), NULL);
+  Checker          *self                  = checker;
+  MpplToken        *name_syntax           = mppl_call_stmt__name(syntax);
+  MpplActParamList *act_param_list_syntax = mppl_call_stmt__act_param_list(syntax);
+  const Def        *def                   = resolve_proc(self, name_syntax);
+  const Type       *type                  = type_of_def(self, def);
 
   if (type) {
-    MpplActParamList *act_param_list_syntax = mppl_call_stmt__act_param_list(syntax);
-    unsigned long     param_count           = act_param_list_syntax ? mppl_act_param_list__expr_count(act_param_list_syntax) : 0;
-    const ProcType   *type_proc             = (const ProcType *) type;
-    const TypeList   *act_param_types       = check_act_param_list(checker, act_param_list_syntax);
+    unsigned long   param_count     = act_param_list_syntax ? mppl_act_param_list__expr_count(act_param_list_syntax) : 0;
+    const ProcType *type_proc       = (const ProcType *) type;
+    const TypeList *act_param_types = check_act_param_list(checker, act_param_list_syntax);
 
     if (type_kind(type) != TYPE_PROC) {
       error_call_stmt_non_callable(checker, name_syntax);
     } else if (param_count != type_list_count(proc_type_params(type_proc))) {
-      error_call_stmt_mismatched_param_count(checker, act_param_list_syntax, type_proc, param_count);
-    } else if (act_param_types != proc_type_params(type_proc)) {
+      /* a call without any argument is reported at the callee */
+      const SyntaxTree *args_syntax = act_param_list_syntax ? (SyntaxTree *) act_param_list_syntax : (SyntaxTree *) name_syntax;
+      error_call_stmt_mismatched_param_count(checker, args_syntax, type_proc, param_count);
+    } else if (act_param_types && act_param_types != proc_type_params(type_proc)) {
       error_call_stmt_wrong_param(checker, name_syntax, act_param_list_syntax, type_proc, act_param_types);
     }
-
-    mppl_unref(act_param_list_syntax);
+  } else if (self->resolver && act_param_list_syntax) {
+    /* the arguments are not checked, but their names still need resolving */
+    resolver_walk_act_param_list(self->resolver, act_param_list_syntax);
   }
 
+  mppl_unref(act_param_list_syntax);
   mppl_unref(name_syntax);
   (void) walker;
 }
@@ -964,33 +1198,150 @@ static void visit_array_type(const MpplAstWalker *walker, const MpplArrayType *s
   (void) walker;
 }
 
+static void setup_walker(MpplAstWalker *walker)
+{
+  mppl_ast_walker__setup(walker);
+  walker->visit_var_decl    = &visit_var_decl;
+  walker->visit_proc_decl   = &visit_proc_decl;
+  walker->visit_assign_stmt = &visit_assign_stmt;
+  walker->visit_if_stmt     = &visit_if_stmt;
+  walker->visit_while_stmt  = &visit_while_stmt;
+  walker->visit_call_stmt   = &visit_call_stmt;
+  walker->visit_input_stmt  = &visit_input_stmt;
+  walker->visit_output_stmt = &visit_output_stmt;
+  walker->visit_array_type  = &visit_array_type;
+}
+
+static void check_worker(void *pool)
+{
+  CheckPool    *self = pool;
+  unsigned long index;
+  while ((index = atomic_increment(&self->next) - 1) < check_job_array_count(self->jobs)) {
+    CheckJob *job = check_job_array_at(self->jobs, index);
+    Checker   checker;
+    checker.ctx      = self->ctx;
+    checker.resolver = NULL;
+    checker.jobs     = NULL;
+    checker.errors   = job->errors;
+    mppl_ast__walk_proc_decl(self->walker, job->syntax, &checker);
+  }
+}
+
+/* a procedure body only sees global declarations, procedures declared before it
+   and its own parameters and locals, all of which are typed before the bodies
+   are checked. each body writes its own range of ids in the side table */
+static void check_jobs(Checker *checker, const MpplAstWalker *walker, unsigned long thread_count)
+{
+  unsigned long i, j;
+  unsigned long next    = 0;
+  Array        *errors  = array_new(sizeof(Report *));
+  Thread      **threads = xmalloc(sizeof(Thread *) * thread_count);
+  CheckPool     pool;
+  pool.walker = walker;
+  pool.ctx    = checker->ctx;
+  pool.jobs   = checker->jobs;
+  pool.next   = 0;
+
+  for (i = 0; i < thread_count; ++i) {
+    threads[i] = thread_spawn(&check_worker, &pool);
+  }
+  for (i = 0; i < thread_count; ++i) {
+    thread_join(threads[i]);
+  }
+  free(threads);
+
+  for (i = 0; i < check_job_array_count(checker->jobs); ++i) {
+    CheckJob *job = check_job_array_at(checker->jobs, i);
+    for (; next < job->position; ++next) {
+      array_push(errors, array_at(checker->errors, next));
+    }
+    for (j = 0; j < array_count(job->errors); ++j) {
+      array_push(errors, array_at(job->errors, j));
+    }
+    array_free(job->errors);
+    mppl_unref(job->syntax);
+  }
+  for (; next < array_count(checker->errors); ++next) {
+    array_push(errors, array_at(checker->errors, next));
+  }
+
+  array_free(checker->errors);
+  checker->errors = errors;
+}
+
 int mpplc_check(const Source *source, const MpplProgram *syntax, Ctx *ctx)
+{
+  return mpplc_check_parallel(source, syntax, ctx, 1);
+}
+
+int mpplc_check_parallel(const Source *source, const MpplProgram *syntax, Ctx *ctx, unsigned long thread_count)
 {
   MpplAstWalker walker;
   Checker       checker;
+  CheckJobArray jobs;
   int           result = 1;
   checker.ctx          = ctx;
+  checker.resolver     = NULL;
+  checker.jobs         = thread_count > 1 ? &jobs : NULL;
   checker.errors       = array_new(sizeof(Report *));
 
-  mppl_ast_walker__setup(&walker);
-  walker.visit_var_decl    = &visit_var_decl;
-  walker.visit_proc_decl   = &visit_proc_decl;
-  walker.visit_assign_stmt = &visit_assign_stmt;
-  walker.visit_if_stmt     = &visit_if_stmt;
-  walker.visit_while_stmt  = &visit_while_stmt;
-  walker.visit_call_stmt   = &visit_call_stmt;
-  walker.visit_input_stmt  = &visit_input_stmt;
-  walker.visit_output_stmt = &visit_output_stmt;
-  walker.visit_array_type  = &visit_array_type;
+  check_job_array_init(&jobs);
+  if (checker.jobs) {
+    ctx_reserve(ctx, raw_syntax_node_id_end(syntax_tree_raw((const SyntaxTree *) syntax)));
+  }
+
+  setup_walker(&walker);
   mppl_ast_walker__travel(&walker, syntax, &checker);
+  if (check_job_array_count(&jobs)) {
+    unsigned long job_count = check_job_array_count(&jobs);
+    check_jobs(&checker, &walker, thread_count < job_count ? thread_count : job_count);
+  }
 
   if (array_count(checker.errors)) {
     unsigned long i;
     for (i = 0; i < array_count(checker.errors); ++i) {
-      report_emit(*(Report **) array_at(checker.errors, i), source);
+      Report *report = *(Report **) array_at(checker.errors, i);
+      if (report_is_error(report)) {
+        result = 0;
+      }
+      report_emit(report, source);
+    }
+  }
+  array_free(checker.errors);
+  check_job_array_deinit(&jobs);
+  return result;
+}
+
+int mpplc_resolve_and_check(const Source *source, const MpplProgram *syntax, Ctx *ctx)
+{
+  MpplAstWalker walker;
+  Checker       checker;
+  int           result;
+  int           failed = 0;
+  unsigned long i;
+  checker.ctx      = ctx;
+  checker.resolver = resolver_new(ctx);
+  checker.jobs     = NULL;
+  checker.errors   = array_new(sizeof(Report *));
+
+  setup_walker(&walker);
+  walker.visit_program       = &visit_program;
+  walker.visit_fml_param_sec = &visit_fml_param_sec;
+  mppl_ast_walker__travel(&walker, syntax, &checker);
+
+  /* type errors are reported only when every name resolves,
+     just as if `mpplc_check` ran after a successful `mpplc_resolve` */
+  result = resolver_finish(checker.resolver, source);
+  for (i = 0; i < array_count(checker.errors); ++i) {
+    Report *report = *(Report **) array_at(checker.errors, i);
+    if (result) {
+      failed = failed || report_is_error(report);
+      report_emit(report, source);
+    } else {
+      report_free(report);
     }
-    result = 0;
   }
+  result = result && !failed;
   array_free(checker.errors);
   return result;
 }
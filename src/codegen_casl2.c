@@ -18,9 +18,11 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "array.h"
 #include "compiler.h"
 #include "context.h"
 #include "context_fwd.h"
+#include "emitter.h"
 #include "map.h"
 #include "mppl_syntax.h"
 #include "mppl_syntax_ext.h"
@@ -30,6 +32,7 @@
 #include "utility.h"
 
 typedef enum {
+  REG_NONE = -1,
   GR0,
   GR1,
   GR2,
@@ -40,6 +43,18 @@ typedef enum {
   GR7
 } Reg;
 
+/* while planning, promoted variables live in virtual registers numbered from here */
+#define REG_VIRTUAL 8
+#define REG_BIT(r)  (1ul << (r))
+
+/* registers the allocator may hand to promoted variables: builtins take their
+   arguments in GR1 and GR2 and the prologue of procedures uses GR0 and GR1 */
+#define REG_PROMOTABLE (REG_BIT(GR3) | REG_BIT(GR4) | REG_BIT(GR5) | REG_BIT(GR6) | REG_BIT(GR7))
+#define REG_ALL        (REG_BIT(GR0) | REG_BIT(GR1) | REG_BIT(GR2) | REG_PROMOTABLE)
+
+/* at most this many variables of a body are considered for promotion */
+#define PROMOTION_LIMIT 32
+
 #define ADR_KIND_OFFSET (sizeof(Adr) * CHAR_BIT - 4)
 #define ADR_NULL        ((Adr) 0)
 #define ADR_CALL        ((Adr) 0 - 1)
@@ -51,8 +66,53 @@ typedef enum {
   ADR_PROC
 } AdrKind;
 
+typedef enum {
+  OP_START,
+  OP_END,
+  OP_DC,
+  OP_DS,
+  OP_NOP,
+  OP_LD,
+  OP_ST,
+  OP_LAD,
+  OP_ADDA,
+  OP_SUBA,
+  OP_MULA,
+  OP_DIVA,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_CPA,
+  OP_CPL,
+  OP_JUMP,
+  OP_JPL,
+  OP_JMI,
+  OP_JNZ,
+  OP_JZE,
+  OP_JOV,
+  OP_PUSH,
+  OP_POP,
+  OP_CALL,
+  OP_RET
+} Op;
+
+typedef enum {
+  OPERAND_NONE,
+  OPERAND_LABEL,
+  OPERAND_NAME,
+  OPERAND_NUMBER,
+  OPERAND_HEX,
+  OPERAND_LITERAL,
+  OPERAND_LITERAL_HEX,
+  OPERAND_STRING
+} OperandKind;
+
 typedef unsigned long     Adr;
-typedef struct RegUsage   RegUsage;
+typedef struct Operand    Operand;
+typedef struct Inst       Inst;
+typedef struct Candidate  Candidate;
+typedef struct Reload     Reload;
+typedef struct Block      Block;
 typedef struct RegState   RegState;
 typedef struct BinaryExpr BinaryExpr;
 typedef struct NotExpr    NotExpr;
@@ -60,15 +120,55 @@ typedef struct CastExpr   CastExpr;
 typedef struct VarExpr    VarExpr;
 typedef struct LitExpr    LitExpr;
 typedef struct Expr       Expr;
+typedef struct KeyItem    KeyItem;
+typedef struct Check      Check;
+typedef struct Value      Value;
+
+struct Operand {
+  OperandKind   kind;
+  unsigned long value;
+  char         *text;
+};
+
+/* `x` is the index register, or the second register of register-to-register forms */
+struct Inst {
+  Adr           label;
+  Op            op;
+  Reg           r;
+  Reg           x;
+  Operand       adr;
+  unsigned long depth;
+};
+
+/* `remat` is set on a parameter whose address is reloaded from its slot after a
+   clobbering call instead of being saved around it */
+struct Candidate {
+  const Def    *def;
+  Reg           reg;
+  int           pinned;
+  int           remat;
+  unsigned long weight;
+};
+
+struct Reload {
+  unsigned long call;
+  Reg           reg;
+  const Def    *def;
+};
 
-struct RegUsage {
-  Expr         *user;
-  unsigned long order;
+struct Block {
+  unsigned long first;
+  unsigned long last;
+  long          next[2];
+  unsigned long use;
+  unsigned long def;
+  unsigned long in;
+  unsigned long out;
 };
 
 struct RegState {
-  RegUsage      user[8];
-  unsigned long order;
+  Expr         *user[8];
+  unsigned long reserved;
 };
 
 typedef enum {
@@ -94,21 +194,29 @@ typedef enum {
   BINARY_OR
 } BinaryExprKind;
 
+/* `need` is the Ershov number: registers taken to evaluate the expression,
+   including the one holding its value, or 0 if it stays in a promoted register */
 struct Expr {
   ExprKind    kind;
   const Type *type;
   Reg         reg;
   int         spill;
+  int         need;
 };
 
+/* `fold` is set when `rhs` is read straight from the address field of the instruction.
+   `rhs->reg` then holds its index or the address of the parameter, if any */
 struct BinaryExpr {
   ExprKind       kind;
   const Type    *type;
   Reg            reg;
   int            spill;
+  int            need;
   BinaryExprKind op;
   Expr          *lhs;
   Expr          *rhs;
+  int            rhs_first;
+  int            fold;
 };
 
 struct NotExpr {
@@ -116,6 +224,7 @@ struct NotExpr {
   const Type *type;
   Reg         reg;
   int         spill;
+  int         need;
   Expr       *expr;
 };
 
@@ -124,16 +233,22 @@ struct CastExpr {
   const Type *type;
   Reg         reg;
   int         spill;
+  int         need;
   Expr       *expr;
 };
 
+/* `promoted` is the register holding the variable, or its address for parameters.
+   `resident` variables are read straight out of that register */
 struct VarExpr {
   ExprKind    kind;
   const Type *type;
   Reg         reg;
   int         spill;
+  int         need;
   const Def  *def;
   Expr       *index;
+  Reg         promoted;
+  int         resident;
 };
 
 struct LitExpr {
@@ -141,22 +256,99 @@ struct LitExpr {
   const Type   *type;
   Reg           reg;
   int           spill;
+  int           need;
   unsigned long value;
   int           hex;
 };
 
+/* a node of an expression flattened in preorder by `expr_key`. `def` is the variable
+   read, and `value` the literal, the operator, the cast type or whether it is indexed */
+struct KeyItem {
+  ExprKind      kind;
+  const Def    *def;
+  unsigned long value;
+};
+
+/* an index found to be at most `last` by a range check in the current block.
+   its key is the `count` items of `keys` from `first` */
+struct Check {
+  unsigned long first;
+  unsigned long count;
+  unsigned long last;
+};
+
+/* the value of an expression computed in the current block and kept in `slot`.
+   its key is the `count` items of the key array from `first` */
+struct Value {
+  unsigned long first;
+  unsigned long count;
+  Adr           slot;
+};
+
+static unsigned long def_hash(const Def *def)
+{
+  return hash_pointer(def);
+}
+
+static int def_equal(const Def *left, const Def *right)
+{
+  return left == right;
+}
+
+DEFINE_ARRAY(InstArray, inst_array, Inst)
+DEFINE_ARRAY(CandidateArray, candidate_array, Candidate)
+DEFINE_ARRAY(ReloadArray, reload_array, Reload)
+DEFINE_ARRAY(BlockArray, block_array, Block)
+DEFINE_ARRAY(MaskArray, mask_array, unsigned long)
+DEFINE_ARRAY(KeyArray, key_array, KeyItem)
+DEFINE_ARRAY(CheckArray, check_array, Check)
+DEFINE_ARRAY(ValueArray, value_array, Value)
+DEFINE_MAP(DefMap, def_map, const Def *, unsigned long, def_hash, def_equal)
+
 typedef struct Generator Generator;
 
 struct Generator {
-  FILE *file;
-  Ctx  *ctx;
-  Map  *symbols;
-  Adr   current_label;
-  Adr   label_count;
-  Adr   var_label_count;
-  Adr   arg_label_count;
-  Adr   proc_label_count;
-  Adr   break_label;
+  Emitter    *emitter;
+  Ctx        *ctx;
+  Casl2Option option;
+  Map      *symbols;
+  Adr       current_label;
+  Adr       label_count;
+  Adr       var_label_count;
+  Adr       arg_label_count;
+  Adr       proc_label_count;
+  Adr       break_label;
+  InstArray insts;
+
+  /* register promotion of the body being generated. the body is generated twice:
+     the planning pass keeps candidate variables in virtual registers, and the
+     second pass uses the registers `plan_promotion` picked for them */
+  const Def     *proc;
+  int            planning;
+  unsigned long  loop_depth;
+  DefMap         promotions;
+  CandidateArray candidates;
+  MaskArray      regions;
+  MaskArray      calls;
+  MaskArray      call_clobbers;
+  ReloadArray    reloads;
+  unsigned long  region_count;
+  unsigned long  call_count;
+  unsigned long  reload_count;
+  unsigned long  clobbered;
+  DefMap         clobbers;
+  DefMap         shared;
+
+  /* range checks passed and values computed since the last label. an index that was
+     checked stays within the bounds, and a value stays valid, until one of the
+     variables it reads is written. `reused` holds the expressions the planning pass
+     found computed twice in a block, which the second pass stores to their slots */
+  KeyArray      keys;
+  CheckArray    checks;
+  ValueArray    values;
+  KeyArray      reused_keys;
+  ValueArray    reused;
+  unsigned long reusing;
 
   int builtin_error_overflow;
   int builtin_error_zero_division;
@@ -174,7 +366,10 @@ struct Generator {
 
 static void fmt_reg(char *buf, Reg reg)
 {
-  sprintf(buf, "GR%d", reg);
+  buf[0] = 'G';
+  buf[1] = 'R';
+  buf[2] = (char) ('0' + reg);
+  buf[3] = '\0';
 }
 
 static void fmt_adr(char *buf, Adr a)
@@ -183,130 +378,293 @@ static void fmt_adr(char *buf, Adr a)
   a &= (1ul << ADR_KIND_OFFSET) - 1ul;
   switch (kind) {
   case ADR_NORMAL:
-    sprintf(buf, "L%lu", a);
+    buf[0] = 'L';
     break;
 
   case ADR_VAR:
-    sprintf(buf, "V%lu", a);
+    buf[0] = 'V';
     break;
 
   case ADR_ARG:
-    sprintf(buf, "A%lu", a);
+    buf[0] = 'A';
     break;
 
   case ADR_PROC:
-    sprintf(buf, "P%lu", a);
+    buf[0] = 'P';
     break;
 
   default:
     unreachable();
   }
+  format_ulong(buf + 1, a);
+}
+
+static Operand operand(OperandKind kind, unsigned long value)
+{
+  Operand self;
+  self.kind  = kind;
+  self.value = value;
+  self.text  = NULL;
+  return self;
+}
+
+static Operand none(void)
+{
+  return operand(OPERAND_NONE, 0);
 }
 
-static const char *label(Adr label)
+static Operand adr(Adr a)
 {
-  static char buf[16];
-  fmt_adr(buf, label);
-  return buf;
+  return operand(OPERAND_LABEL, a);
 }
 
-static const char *r1(Reg reg)
+static Operand num(unsigned long value)
 {
-  static char buf[16];
-  fmt_reg(buf, reg);
-  return buf;
+  return operand(OPERAND_NUMBER, value);
 }
 
-static const char *r2(Reg reg)
+static Operand lit(unsigned long value)
 {
-  static char buf[16];
-  fmt_reg(buf, reg);
-  return buf;
+  return operand(OPERAND_LITERAL, value);
 }
 
-static const char *r(Reg reg)
+static Operand sym(const char *name)
 {
-  static char buf[16];
-  fmt_reg(buf, reg);
-  return buf;
+  Operand self = operand(OPERAND_NAME, 0);
+  self.text    = (char *) name;
+  return self;
+}
+
+static int op_writes_r(Op op)
+{
+  switch (op) {
+  case OP_LD:
+  case OP_LAD:
+  case OP_ADDA:
+  case OP_SUBA:
+  case OP_MULA:
+  case OP_DIVA:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+  case OP_POP:
+    return 1;
+
+  default:
+    return 0;
+  }
 }
 
-static const char *x(Reg reg)
+static int op_reads_r(Op op)
 {
-  static char buf[16];
-  fmt_reg(buf, reg);
-  return buf;
+  switch (op) {
+  case OP_ST:
+  case OP_ADDA:
+  case OP_SUBA:
+  case OP_MULA:
+  case OP_DIVA:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+  case OP_CPA:
+  case OP_CPL:
+    return 1;
+
+  default:
+    return 0;
+  }
 }
 
-static const char *adr(Adr a)
+static int op_is_jump(Op op)
 {
-  static char buf[16];
-  fmt_adr(buf, a);
-  return buf;
+  switch (op) {
+  case OP_JUMP:
+  case OP_JPL:
+  case OP_JMI:
+  case OP_JNZ:
+  case OP_JZE:
+  case OP_JOV:
+    return 1;
+
+  default:
+    return 0;
+  }
 }
 
-static RegState reg_state(void)
+static RegState reg_state(Generator *self)
 {
-  RegState      self;
+  RegState      state;
   unsigned long i;
   for (i = 0; i < 8; ++i) {
-    self.user[i].user  = NULL;
-    self.user[i].order = -1ul;
+    state.user[i] = NULL;
   }
-  return self;
+  state.reserved = 0;
+  if (self->planning) {
+    mask_array_push(&self->regions, inst_array_count(&self->insts));
+  } else if (self->region_count < mask_array_count(&self->regions)) {
+    state.reserved = *mask_array_at(&self->regions, self->region_count);
+  }
+  ++self->region_count;
+  return state;
 }
 
 static void reg_state_use(RegState *self, Reg reg, Expr *user)
 {
-  self->user[reg].user  = user;
-  self->user[reg].order = self->order++;
+  self->user[reg] = user;
 }
 
 static void reg_state_release(RegState *self, Reg reg)
 {
-  self->user[reg].user  = NULL;
-  self->user[reg].order = -1ul;
+  self->user[reg] = NULL;
+}
+
+static int reg_state_is_vacant(const RegState *self, Reg reg)
+{
+  return !self->user[reg] && !(self->reserved & REG_BIT(reg));
 }
 
 static Reg reg_state_vacant(RegState *self)
 {
   unsigned long i;
-  unsigned long oldest = -1ul;
-
   for (i = 1; i < 8; ++i) {
-    if (!self->user[i].user) {
+    if (reg_state_is_vacant(self, (Reg) i)) {
       return (Reg) i;
     }
   }
+  unreachable();
+}
 
+/* registers an expression computed into `reg` may use, `reg` included */
+static int reg_state_room(const RegState *self, Reg reg)
+{
+  unsigned long i;
+  int           room = !reg_state_is_vacant(self, reg);
   for (i = 1; i < 8; ++i) {
-    if (self->user[i].order < oldest) {
-      oldest = self->user[i].order;
+    room += reg_state_is_vacant(self, (Reg) i);
+  }
+  return room;
+}
+
+static Reg promoted(Generator *self, const Def *def);
+
+/* nonzero if the cast changes the bits of its operand in place */
+static int cast_converts(const CastExpr *self)
+{
+  if (self->type == self->expr->type) {
+    return 0;
+  }
+  switch (type_kind(self->type)) {
+  case TYPE_BOOLEAN:
+    return 1;
+
+  case TYPE_CHAR:
+    return type_kind(self->expr->type) == TYPE_INTEGER;
+
+  default:
+    return 0;
+  }
+}
+
+/* drop the casts around `self` that leave its bits alone */
+static Expr *expr_strip(Expr *self)
+{
+  while (self->kind == EXPR_CAST && !cast_converts((const CastExpr *) self)) {
+    Expr *expr = ((CastExpr *) self)->expr;
+    free(self);
+    self = expr;
+  }
+  return self;
+}
+
+/* nonzero if the rhs of `self` can be read from the address field of the instruction.
+   a divisor is folded only when it is known not to be zero, and AND and OR turn into
+   bitwise instructions that always read their rhs, so it must not fail a range check */
+static int binary_folds(const BinaryExpr *self)
+{
+  switch (self->op) {
+  case BINARY_DIV:
+    return self->rhs->kind == EXPR_LIT && ((const LitExpr *) self->rhs)->value;
+
+  case BINARY_AND:
+  case BINARY_OR:
+    return self->rhs->kind == EXPR_LIT || (self->rhs->kind == EXPR_VAR && !((const VarExpr *) self->rhs)->index);
+
+  default:
+    return self->rhs->kind == EXPR_LIT || self->rhs->kind == EXPR_VAR;
+  }
+}
+
+/* registers taken to read `self` from the address field of an instruction.
+   the planning pass loads the address of a parameter as if it stayed in memory */
+static int operand_need(const Generator *generator, const Expr *self)
+{
+  if (self->kind == EXPR_VAR) {
+    const VarExpr *expr = (const VarExpr *) self;
+    if (expr->index) {
+      return expr->index->need;
+    } else if (def_kind(expr->def) == DEF_PARAM) {
+      return generator->planning || expr->promoted == REG_NONE;
     }
   }
+  return 0;
+}
+
+/* the lhs ends up in the register of the whole expression, so it takes one even when resident.
+   the operands of an arithmetic or relational operator may be evaluated in either order */
+static int binary_need(const BinaryExpr *self)
+{
+  int lhs = self->lhs->need ? self->lhs->need : 1;
+  int rhs = self->rhs->need;
+
+  if (lhs == rhs && (self->fold || (self->op != BINARY_AND && self->op != BINARY_OR))) {
+    return lhs + 1;
+  }
+  return lhs > rhs ? lhs : rhs;
+}
 
-  self->user[oldest].user->spill = 1;
-  reg_state_release(self, (Reg) oldest);
-  return (Reg) oldest;
+/* negative numbers are written in hexadecimal, as are characters */
+static Expr *lit_expr_new(const Type *type, long value)
+{
+  LitExpr *self = malloc(sizeof(LitExpr));
+  self->kind    = EXPR_LIT;
+  self->type    = type;
+  self->reg     = GR0;
+  self->spill   = 0;
+  self->need    = 1;
+  self->value   = (unsigned long) value & 0xFFFF;
+  self->hex     = value < 0 || type_kind(type) == TYPE_CHAR;
+  return (Expr *) self;
 }
 
-static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
+static Expr *expr_create_tree(Generator *generator, const AnyMpplExpr *syntax)
 {
+  Ctx *ctx = generator->ctx;
+  long value;
+
+  if (ctx_folded(ctx, (const SyntaxTree *) syntax, &value)) {
+    return lit_expr_new(ctx_type_of(ctx, (const SyntaxTree *) syntax, NULL), value);
+  }
+
   switch (mppl_expr__kind(syntax)) {
   case MPPL_EXPR_BINARY: {
-    const MpplBinaryExpr *binary_syntax = (const MpplBinaryExpr *) syntax;
-    AnyMpplExpr          *lhs_syntax    = mppl_binary_expr__lhs(binary_syntax);
-    AnyMpplExpr          *rhs_syntax    = mppl_binary_expr__rhs(binary_syntax);
-    MpplToken            *op_syntax     = mppl_binary_expr__op_token(binary_syntax);
+    const MpplBinaryExpr *binary_syntax  = (const MpplBinaryExpr *) syntax;
+    AnyMpplExpr          *lhs_syntax     = mppl_binary_expr__lhs(binary_syntax);
+    AnyMpplExpr          *rhs_syntax     = mppl_binary_expr__rhs(binary_syntax);
+    MpplToken            *op_syntax      = mppl_binary_expr__op_token(binary_syntax);
+    AnyMpplExpr          *operand_syntax = mppl_binary_expr__identity_operand(binary_syntax, ctx);
     Expr                 *result;
 
-    if (lhs_syntax) {
+    if (operand_syntax) {
+      result = expr_create_tree(generator, operand_syntax);
+      mppl_unref(operand_syntax);
+    } else if (lhs_syntax) {
       BinaryExpr *self = malloc(sizeof(BinaryExpr));
       self->kind       = EXPR_BINARY;
-      self->type       = ctx_type_of(ctx, (const SyntaxTree *) lhs_syntax, NULL);
+      self->type       = ctx_type_of(ctx, (const SyntaxTree *) binary_syntax, NULL);
       self->spill      = 0;
-      self->lhs        = expr_create_tree(ctx, lhs_syntax);
-      self->rhs        = expr_create_tree(ctx, rhs_syntax);
+      self->lhs        = expr_create_tree(generator, lhs_syntax);
+      self->rhs        = expr_strip(expr_create_tree(generator, rhs_syntax));
+      self->rhs_first  = 0;
 
       switch (syntax_tree_kind((const SyntaxTree *) op_syntax)) {
       case SYNTAX_PLUS_TOKEN:
@@ -361,11 +719,16 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
         unreachable();
       }
 
-      result = (Expr *) self;
+      self->fold = binary_folds(self);
+      if (self->fold) {
+        self->rhs->need = operand_need(generator, self->rhs);
+      }
+      self->need = binary_need(self);
+      result     = (Expr *) self;
     } else {
       switch (syntax_tree_kind((const SyntaxTree *) op_syntax)) {
       case SYNTAX_PLUS_TOKEN:
-        result = expr_create_tree(ctx, rhs_syntax);
+        result = expr_create_tree(generator, rhs_syntax);
         break;
 
       case SYNTAX_MINUS_TOKEN: {
@@ -373,16 +736,15 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
         self->kind       = EXPR_BINARY;
         self->type       = ctx_type_of(ctx, (const SyntaxTree *) rhs_syntax, NULL);
         self->spill      = 0;
-        {
-          LitExpr *zero = malloc(sizeof(LitExpr));
-          zero->kind    = EXPR_LIT;
-          zero->spill   = 0;
-          zero->value   = 0;
-          zero->hex     = 0;
-          self->lhs     = (Expr *) zero;
+        self->lhs       = lit_expr_new(self->type, 0);
+        self->rhs       = expr_strip(expr_create_tree(generator, rhs_syntax));
+        self->op        = BINARY_SUB;
+        self->rhs_first = 0;
+        self->fold      = binary_folds(self);
+        if (self->fold) {
+          self->rhs->need = operand_need(generator, self->rhs);
         }
-        self->rhs = expr_create_tree(ctx, rhs_syntax);
-        self->op  = BINARY_SUB;
+        self->need = binary_need(self);
 
         result = (Expr *) self;
         break;
@@ -401,7 +763,7 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
   case MPPL_EXPR_PAREN: {
     const MpplParenExpr *paren_syntax = (const MpplParenExpr *) syntax;
     AnyMpplExpr         *expr_syntax  = mppl_paren_expr__expr(paren_syntax);
-    Expr                *result       = expr_create_tree(ctx, expr_syntax);
+    Expr                *result       = expr_create_tree(generator, expr_syntax);
 
     mppl_unref(expr_syntax);
     return result;
@@ -416,7 +778,8 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
     self->type    = ctx_type_of(ctx, (const SyntaxTree *) expr_syntax, NULL);
     self->reg     = GR0;
     self->spill   = 0;
-    self->expr    = expr_create_tree(ctx, expr_syntax);
+    self->expr    = expr_create_tree(generator, expr_syntax);
+    self->need    = self->expr->need ? self->expr->need : 1;
 
     mppl_unref(expr_syntax);
     return (Expr *) self;
@@ -428,10 +791,11 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
 
     CastExpr *self = malloc(sizeof(CastExpr));
     self->kind     = EXPR_CAST;
-    self->type     = ctx_type_of(ctx, (const SyntaxTree *) expr_syntax, NULL);
+    self->type     = ctx_type_of(ctx, (const SyntaxTree *) cast_syntax, NULL);
     self->reg      = GR0;
     self->spill    = 0;
-    self->expr     = expr_create_tree(ctx, expr_syntax);
+    self->expr     = expr_create_tree(generator, expr_syntax);
+    self->need     = cast_converts(self) && !self->expr->need ? 1 : self->expr->need;
 
     mppl_unref(expr_syntax);
     return (Expr *) self;
@@ -451,8 +815,11 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
       MpplEntireVar *entire_syntax = (MpplEntireVar *) var_syntax;
       MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
 
-      self->def   = ctx_resolve(ctx, (const SyntaxTree *) name_syntax, NULL);
-      self->index = NULL;
+      self->def      = ctx_resolve(ctx, (const SyntaxTree *) name_syntax, NULL);
+      self->index    = NULL;
+      self->promoted = promoted(generator, self->def);
+      self->resident = !generator->planning && self->promoted != REG_NONE && def_kind(self->def) != DEF_PARAM;
+      self->need     = !self->resident;
 
       mppl_unref(name_syntax);
       break;
@@ -463,8 +830,11 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
       MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
       AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
 
-      self->def   = ctx_resolve(ctx, (const SyntaxTree *) name_syntax, NULL);
-      self->index = expr_create_tree(ctx, index_syntax);
+      self->def      = ctx_resolve(ctx, (const SyntaxTree *) name_syntax, NULL);
+      self->index    = expr_create_tree(generator, index_syntax);
+      self->promoted = REG_NONE;
+      self->resident = 0;
+      self->need     = self->index->need ? self->index->need : 1;
 
       mppl_unref(name_syntax);
       mppl_unref(index_syntax);
@@ -478,77 +848,174 @@ static Expr *expr_create_tree(Ctx *ctx, const AnyMpplExpr *syntax)
     return (Expr *) self;
   }
 
-  case MPPL_EXPR_LIT: {
-    const AnyMpplLit *lit_syntax = (const AnyMpplLit *) syntax;
+  case MPPL_EXPR_LIT:
+    /* the checker folds every literal that can appear in an expression */
+    unreachable();
 
-    LitExpr *self = malloc(sizeof(LitExpr));
-    self->kind    = EXPR_LIT;
-    self->type    = ctx_type_of(ctx, (const SyntaxTree *) lit_syntax, NULL);
-    self->reg     = GR0;
-    self->spill   = 0;
+  default:
+    unreachable();
+  }
+}
 
-    switch (mppl_lit__kind(lit_syntax)) {
-    case MPPL_LIT_BOOLEAN:
-      self->value = mppl_lit_boolean__to_int((const MpplBooleanLit *) lit_syntax);
-      self->hex   = 0;
-      break;
+/* nonzero if evaluating `self` reads the register `reg` of a promoted variable */
+static int expr_reads(const Expr *self, Reg reg)
+{
+  switch (self->kind) {
+  case EXPR_BINARY: {
+    const BinaryExpr *expr = (const BinaryExpr *) self;
+    return expr_reads(expr->lhs, reg) || expr_reads(expr->rhs, reg);
+  }
 
-    case MPPL_LIT_NUMBER:
-      self->value = mppl_lit_number__to_long((const MpplNumberLit *) lit_syntax);
-      self->hex   = 0;
-      break;
+  case EXPR_NOT:
+    return expr_reads(((const NotExpr *) self)->expr, reg);
 
-    case MPPL_LIT_STRING: {
-      char *string = mppl_lit_string__to_string((const MpplStringLit *) lit_syntax);
-      self->value  = (unsigned long) string[0];
-      self->hex    = 1;
-      free(string);
-      break;
+  case EXPR_CAST:
+    return expr_reads(((const CastExpr *) self)->expr, reg);
+
+  case EXPR_VAR: {
+    const VarExpr *expr = (const VarExpr *) self;
+    return expr->promoted == reg || (expr->index && expr_reads(expr->index, reg));
+  }
+
+  case EXPR_LIT:
+    return 0;
+
+  default:
+    unreachable();
+  }
+}
+
+/* nonzero if `self` may be computed straight into the register `reg` of `def`.
+   that register must not be written while it is still to be read, which holds
+   when the only write is the final arithmetic on `def` itself. a variable dead
+   at this point may share the register with one read here, so it is the
+   register that is looked for rather than `def` */
+static int expr_can_target(const Expr *self, const Def *def, Reg reg)
+{
+  if (self->kind == EXPR_BINARY) {
+    const BinaryExpr *expr = (const BinaryExpr *) self;
+    if (expr->op <= BINARY_DIV && expr->lhs->kind == EXPR_VAR) {
+      const VarExpr *lhs = (const VarExpr *) expr->lhs;
+      if (lhs->def == def && !lhs->index) {
+        return 1;
+      }
     }
+  }
+  return !expr_reads(self, reg);
+}
 
-    default:
-      unreachable();
+static void expr_assign_reg(Expr *self, Reg reg, int writable, RegState *state);
+
+/* assign registers to `self` read from the address field of an instruction.
+   only the index of an indexed variable or the address of a parameter takes one,
+   and `reg` is REG_NONE unless `self` needs it */
+static void expr_assign_operand(Expr *self, Reg reg, RegState *state)
+{
+  if (self->kind == EXPR_VAR && ((VarExpr *) self)->index) {
+    VarExpr *expr = (VarExpr *) self;
+    expr_assign_reg(expr->index, reg, 0, state);
+    self->reg = expr->index->reg;
+  } else {
+    self->reg = reg;
+    if (reg != REG_NONE) {
+      reg_state_use(state, reg, self);
     }
+  }
+}
 
-    return (Expr *) self;
+static void expr_assign_rhs(Expr *self, Reg reg, int fold, RegState *state)
+{
+  if (fold) {
+    expr_assign_operand(self, reg, state);
+  } else {
+    expr_assign_reg(self, reg, 0, state);
   }
+}
 
-  default:
-    unreachable();
+/* assign registers to two operands held at the same time, `lhs` landing in `reg`.
+   the needier one is evaluated first, and spilled to the stack while the other
+   is evaluated if the other no longer fits. returns nonzero if `rhs` goes first */
+static int expr_assign_pair(Expr *lhs, Expr *rhs, Reg reg, int writable, int fold, RegState *state)
+{
+  int lhs_need = writable && !lhs->need ? 1 : lhs->need;
+
+  if (rhs->need > lhs_need) {
+    Reg other;
+    reg_state_use(state, reg, lhs);
+    other = reg_state_vacant(state);
+    reg_state_release(state, reg);
+
+    expr_assign_rhs(rhs, other, fold, state);
+    if (reg_state_room(state, reg) < lhs_need) {
+      rhs->spill = 1;
+      reg_state_release(state, other);
+      expr_assign_reg(lhs, reg, writable, state);
+      reg_state_use(state, other, rhs);
+    } else {
+      expr_assign_reg(lhs, reg, writable, state);
+    }
+    return 1;
+  } else if (rhs->need == 0) {
+    expr_assign_reg(lhs, reg, writable, state);
+    expr_assign_rhs(rhs, REG_NONE, fold, state);
+    return 0;
+  } else {
+    Reg other;
+    expr_assign_reg(lhs, reg, writable, state);
+    other = reg_state_vacant(state);
+    if (state->user[reg] == lhs && reg_state_room(state, other) < rhs->need) {
+      lhs->spill = 1;
+      reg_state_release(state, reg);
+      expr_assign_rhs(rhs, other, fold, state);
+      reg_state_use(state, reg, lhs);
+    } else {
+      expr_assign_rhs(rhs, other, fold, state);
+    }
+    return 0;
   }
 }
 
-static void expr_assign_reg(Expr *self, Reg reg, RegState *state)
+/* `writable` is set when the consumer overwrites the register of `self`,
+   so a resident variable has to be copied out first */
+static void expr_assign_reg(Expr *self, Reg reg, int writable, RegState *state)
 {
   switch (self->kind) {
   case EXPR_BINARY: {
     BinaryExpr *expr = (BinaryExpr *) self;
-    if (expr->op == BINARY_AND || expr->op == BINARY_OR) {
-      expr_assign_reg(expr->lhs, reg, state);
+    if ((expr->op == BINARY_AND || expr->op == BINARY_OR) && !expr->fold) {
+      expr_assign_reg(expr->lhs, reg, 0, state);
       reg_state_release(state, reg);
-      expr_assign_reg(expr->rhs, reg, state);
+      expr_assign_reg(expr->rhs, reg, 0, state);
       reg_state_release(state, reg);
     } else {
-      Reg rhs;
-      expr_assign_reg(expr->lhs, reg, state);
-      rhs = reg_state_vacant(state);
-      expr_assign_reg(expr->rhs, rhs, state);
+      int writable    = expr->op <= BINARY_DIV || expr->op >= BINARY_AND;
+      expr->rhs_first = expr_assign_pair(expr->lhs, expr->rhs, reg, writable, expr->fold, state);
+      if (expr->rhs->reg != REG_NONE) {
+        reg_state_release(state, expr->rhs->reg);
+      }
       reg_state_release(state, reg);
-      reg_state_release(state, rhs);
     }
     break;
   }
 
   case EXPR_NOT: {
     NotExpr *expr = (NotExpr *) self;
-    expr_assign_reg(expr->expr, reg, state);
+    expr_assign_reg(expr->expr, reg, 1, state);
     reg_state_release(state, reg);
     break;
   }
 
   case EXPR_CAST: {
     CastExpr *expr = (CastExpr *) self;
-    expr_assign_reg(expr->expr, reg, state);
+    if (cast_converts(expr)) {
+      expr_assign_reg(expr->expr, reg, 1, state);
+    } else {
+      expr_assign_reg(expr->expr, reg, writable, state);
+      if (expr->expr->reg != reg) {
+        self->reg = expr->expr->reg;
+        return;
+      }
+    }
     reg_state_release(state, reg);
     break;
   }
@@ -556,8 +1023,11 @@ static void expr_assign_reg(Expr *self, Reg reg, RegState *state)
   case EXPR_VAR: {
     VarExpr *expr = (VarExpr *) self;
     if (expr->index) {
-      expr_assign_reg(expr->index, reg, state);
+      expr_assign_reg(expr->index, reg, 0, state);
       reg_state_release(state, reg);
+    } else if (expr->resident && (!writable || expr->promoted == reg)) {
+      self->reg = expr->promoted;
+      return;
     }
     break;
   }
@@ -573,9 +1043,9 @@ static void expr_assign_reg(Expr *self, Reg reg, RegState *state)
   reg_state_use(state, self->reg = reg, self);
 }
 
-static Expr *expr_new(Ctx *ctx, const AnyMpplExpr *syntax)
+static Expr *expr_new(Generator *generator, const AnyMpplExpr *syntax)
 {
-  return expr_create_tree(ctx, syntax);
+  return expr_create_tree(generator, syntax);
 }
 
 static void expr_free(Expr *self)
@@ -632,6 +1102,12 @@ static Adr locate(Generator *self, const Def *def, Adr label)
       return label;
     }
   } else {
+    if (self->proc && def_kind(def) == DEF_VAR) {
+      DefMapIndex shared;
+      if (!def_map_entry(&self->shared, def, &shared)) {
+        def_map_update(&self->shared, &shared, def, 1);
+      }
+    }
     if (map_entry(self->symbols, (void *) def, &index)) {
       return *(Adr *) map_value(self->symbols, &index);
     } else {
@@ -640,804 +1116,2516 @@ static Adr locate(Generator *self, const Def *def, Adr label)
   }
 }
 
-static void write_inst(Generator *self, const char *inst, const char *args[], int count)
+/* only scalar locals and parameters of the current procedure, and scalar
+   globals of the main program that no procedure touches, are promoted */
+static int promotable(Generator *self, const Def *def)
 {
-  int i;
+  switch (def_kind(def)) {
+  case DEF_PARAM:
+    return 1;
 
-  fprintf(self->file, "%-10s", self->current_label ? label(self->current_label) : "");
-  if (count) {
-    fprintf(self->file, "%-6s", inst);
-    for (i = 0; i < count; ++i) {
-      if (i) {
-        fprintf(self->file, ", ");
-      }
-      fprintf(self->file, "%s", args[i]);
+  case DEF_LOCAL:
+    break;
+
+  case DEF_VAR: {
+    DefMapIndex index;
+    if (self->proc || def_map_entry(&self->shared, def, &index)) {
+      return 0;
     }
-  } else {
-    fprintf(self->file, "%s", inst);
+    break;
   }
-  fprintf(self->file, "\n");
 
-  self->current_label = ADR_NULL;
+  default:
+    return 0;
+  }
+  return type_kind(ctx_type_of(self->ctx, def_syntax(def), NULL)) != TYPE_ARRAY;
 }
 
-static void write_inst0(Generator *self, const char *inst)
+static Candidate *candidate_of(Generator *self, const Def *def)
 {
-  write_inst(self, inst, NULL, 0);
+  DefMapIndex index;
+  if (def_map_entry(&self->promotions, def, &index)) {
+    return candidate_array_at(&self->candidates, def_map_value(&self->promotions, &index));
+  } else if (self->planning && promotable(self, def)) {
+    Candidate candidate;
+    candidate.def    = def;
+    candidate.reg    = (Reg) (REG_VIRTUAL + candidate_array_count(&self->candidates));
+    candidate.pinned = 0;
+    candidate.remat  = 0;
+    candidate.weight = 0;
+    def_map_update(&self->promotions, &index, def, candidate_array_count(&self->candidates));
+    candidate_array_push(&self->candidates, candidate);
+    return candidate_array_back(&self->candidates);
+  } else {
+    return NULL;
+  }
 }
 
-static void write_inst1(Generator *self, const char *inst, const char *arg1)
+static Reg promoted(Generator *self, const Def *def)
 {
-  const char *args[1];
-  args[0] = arg1;
-  write_inst(self, inst, args, 1);
+  Candidate *candidate = candidate_of(self, def);
+  return candidate ? candidate->reg : REG_NONE;
 }
 
-static void write_inst2(Generator *self, const char *inst, const char *arg1, const char *arg2)
+/* the address of `def` escapes, so it has to stay in memory */
+static void pin(Generator *self, const Def *def)
 {
-  const char *args[2];
-  args[0] = arg1;
-  args[1] = arg2;
-  write_inst(self, inst, args, 2);
+  Candidate *candidate = candidate_of(self, def);
+  if (candidate) {
+    candidate->pinned = 1;
+  }
 }
 
-static void write_inst3(Generator *self, const char *inst, const char *arg1, const char *arg2, const char *arg3)
+static void write_field(Generator *self, const char *text, unsigned long width)
 {
-  const char *args[3];
-  args[0] = arg1;
-  args[1] = arg2;
-  args[2] = arg3;
-  write_inst(self, inst, args, 3);
+  unsigned long length = strlen(text);
+  emitter_write(self->emitter, text, length);
+  if (length < width) {
+    emitter_pad(self->emitter, width - length);
+  }
 }
 
-static void write_label(Generator *self, Adr a)
+static void write_inst(Generator *self, Op op, Reg r, Operand adr, Reg x)
 {
-  if (self->current_label && self->current_label != a) {
-    write_inst0(self, "NOP");
+  Inst inst;
+  inst.label = self->current_label;
+  inst.op    = op;
+  inst.r     = r;
+  inst.x     = x;
+  inst.adr   = adr;
+  inst.depth = self->loop_depth;
+  inst_array_push(&self->insts, inst);
+
+  if (op_writes_r(op) && r < REG_VIRTUAL) {
+    self->clobbered |= REG_BIT(r);
   }
-  self->current_label = a;
+  self->current_label = ADR_NULL;
 }
 
-static void write_builtin(Generator *self, const char **lines, unsigned long count)
+static void write_inst0(Generator *self, Op op)
 {
-  unsigned long i;
-  for (i = 0; i < count; ++i) {
-    fprintf(self->file, "%s\n", lines[i]);
-  }
+  write_inst(self, op, REG_NONE, none(), REG_NONE);
 }
 
-static void write_expr_core(Generator *self, const Expr *expr, Adr sink);
-
-static void write_relational_expr(Generator *self, const char *inst, const BinaryExpr *expr, int reverse, Adr sink)
+static void write_inst_r(Generator *self, Op op, Reg r)
 {
-  Adr else_block = self->label_count++;
-  Adr next_block = sink ? sink : self->label_count++;
-
-  write_expr_core(self, expr->lhs, ADR_NULL);
-  write_expr_core(self, expr->rhs, ADR_NULL);
-  if (expr->lhs->spill) {
-    write_inst1(self, "POP", r(expr->lhs->reg));
-  }
-  if (reverse) {
-    write_inst2(self, "CPA", r1(expr->rhs->reg), r2(expr->lhs->reg));
-  } else {
-    write_inst2(self, "CPA", r1(expr->lhs->reg), r2(expr->rhs->reg));
-  }
-  write_inst1(self, inst, adr(else_block));
-  write_inst2(self, "LAD", r(expr->reg), "0");
-  write_inst1(self, "JUMP", adr(next_block));
-  write_label(self, else_block);
-  write_inst2(self, "LAD", r(expr->reg), "1");
-
-  if (!sink) {
-    write_label(self, next_block);
-  }
+  write_inst(self, op, r, none(), REG_NONE);
 }
 
-static void write_arithmetic_expr(Generator *self, const char *inst, const BinaryExpr *expr, int check_overflow, int check_zero_division)
+static void write_inst_rr(Generator *self, Op op, Reg r1, Reg r2)
 {
-  write_expr_core(self, expr->lhs, ADR_NULL);
-  write_expr_core(self, expr->rhs, ADR_NULL);
-  if (check_zero_division) {
-    write_inst2(self, "CPA", r1(expr->rhs->reg), "=0");
-    write_inst1(self, "JZE", "E0DIV");
-    self->builtin_error_zero_division = 1;
-  }
-  if (expr->lhs->spill) {
-    write_inst1(self, "POP", r(expr->lhs->reg));
-  }
-  write_inst2(self, inst, r1(expr->lhs->reg), r2(expr->rhs->reg));
-  if (check_overflow) {
-    write_inst1(self, "JOV", "EOVF");
-    self->builtin_error_overflow = 1;
-  }
-  if (expr->reg != expr->lhs->reg) {
-    write_inst2(self, "LD", r1(expr->reg), r2(expr->lhs->reg));
-  }
+  write_inst(self, op, r1, none(), r2);
 }
 
-static void write_logical_expr(Generator *self, const char *inst, const BinaryExpr *expr, Adr sink)
+static void write_inst_ra(Generator *self, Op op, Reg r, Operand adr)
 {
-  Adr next_block = sink ? sink : self->label_count++;
-  if (expr->reg != expr->lhs->reg) {
-    Adr else_block = self->label_count++;
-    write_expr_core(self, expr->lhs, ADR_NULL);
-    write_inst2(self, "CPA", r(expr->lhs->reg), "=1");
-    write_inst1(self, inst, adr(else_block));
-    write_expr_core(self, expr->rhs, ADR_NULL);
-    if (expr->reg != expr->rhs->reg) {
-      write_inst2(self, "LD", r1(expr->reg), r2(expr->rhs->reg));
-    }
-    write_inst1(self, "JUMP", adr(next_block));
-    write_label(self, else_block);
-    write_inst2(self, "LD", r1(expr->reg), r2(expr->lhs->reg));
-  } else {
-    write_expr_core(self, expr->lhs, ADR_NULL);
-    write_inst2(self, "CPA", r(expr->lhs->reg), "=1");
-    write_inst1(self, inst, adr(next_block));
-    if (expr->reg != expr->rhs->reg) {
-      write_expr_core(self, expr->rhs, ADR_NULL);
-      write_inst2(self, "LD", r1(expr->reg), r2(expr->rhs->reg));
-    } else {
-      write_expr_core(self, expr->rhs, next_block);
-    }
-  }
+  write_inst(self, op, r, adr, REG_NONE);
+}
 
-  if (!sink) {
-    write_label(self, next_block);
-  }
+static void write_inst_a(Generator *self, Op op, Operand adr)
+{
+  write_inst(self, op, REG_NONE, adr, REG_NONE);
 }
 
-static void write_binary_expr(Generator *self, const BinaryExpr *expr, Adr sink)
+/* flatten `self` into `keys` in preorder */
+static void expr_key(const Expr *self, KeyArray *keys)
 {
-  switch (expr->op) {
-  case BINARY_EQ:
-    write_relational_expr(self, "JZE", expr, 0, sink);
-    break;
+  KeyItem item;
+  item.kind  = self->kind;
+  item.def   = NULL;
+  item.value = 0;
 
-  case BINARY_NE:
-    write_relational_expr(self, "JNZ", expr, 0, sink);
+  switch (self->kind) {
+  case EXPR_BINARY: {
+    const BinaryExpr *expr = (const BinaryExpr *) self;
+    item.value             = expr->op;
+    key_array_push(keys, item);
+    expr_key(expr->lhs, keys);
+    expr_key(expr->rhs, keys);
     break;
+  }
 
-  case BINARY_LT:
-    write_relational_expr(self, "JMI", expr, 0, sink);
+  case EXPR_NOT:
+    key_array_push(keys, item);
+    expr_key(((const NotExpr *) self)->expr, keys);
     break;
 
-  case BINARY_LE:
-    write_relational_expr(self, "JPL", expr, 1, sink);
+  case EXPR_CAST:
+    item.value = type_kind(self->type);
+    key_array_push(keys, item);
+    expr_key(((const CastExpr *) self)->expr, keys);
     break;
 
-  case BINARY_GT:
-    write_relational_expr(self, "JPL", expr, 0, sink);
+  case EXPR_VAR: {
+    const VarExpr *expr = (const VarExpr *) self;
+    item.def            = expr->def;
+    item.value          = expr->index != NULL;
+    key_array_push(keys, item);
+    if (expr->index) {
+      expr_key(expr->index, keys);
+    }
     break;
+  }
 
-  case BINARY_GE:
-    write_relational_expr(self, "JMI", expr, 1, sink);
+  case EXPR_LIT:
+    item.value = ((const LitExpr *) self)->value;
+    key_array_push(keys, item);
     break;
 
-  case BINARY_ADD:
-    write_arithmetic_expr(self, "ADDA", expr, 1, 0);
-    break;
+  default:
+    unreachable();
+  }
+}
 
-  case BINARY_SUB:
-    write_arithmetic_expr(self, "SUBA", expr, 0, 0);
-    break;
+/* a rough count of the instructions evaluating `self` takes */
+static unsigned long expr_cost(const Expr *self)
+{
+  switch (self->kind) {
+  case EXPR_BINARY: {
+    const BinaryExpr *expr = (const BinaryExpr *) self;
+    return expr_cost(expr->lhs) + expr_cost(expr->rhs) + (expr->op == BINARY_ADD || expr->op == BINARY_MUL || expr->op == BINARY_DIV ? 2 : 1);
+  }
 
-  case BINARY_MUL:
-    write_arithmetic_expr(self, "MULA", expr, 1, 0);
-    break;
+  case EXPR_NOT:
+    return expr_cost(((const NotExpr *) self)->expr) + 1;
 
-  case BINARY_DIV:
-    write_arithmetic_expr(self, "DIVA", expr, 0, 1);
-    break;
+  case EXPR_CAST:
+    return expr_cost(((const CastExpr *) self)->expr) + 1;
 
-  case BINARY_AND:
-    write_logical_expr(self, "JNZ", expr, sink);
-    break;
+  case EXPR_VAR: {
+    const VarExpr *expr = (const VarExpr *) self;
+    return expr->index && expr->index->kind != EXPR_LIT ? expr_cost(expr->index) + 1 : 1;
+  }
 
-  case BINARY_OR:
-    write_logical_expr(self, "JZE", expr, sink);
-    break;
+  case EXPR_LIT:
+    return 1;
 
   default:
     unreachable();
   }
 }
 
-static void write_not_expr(Generator *self, const NotExpr *expr)
+/* whether the value of `self` is worth keeping in memory to be loaded back when the
+   same expression is evaluated again in the block. expressions branching to labels
+   of their own are left out, and so are those as cheap as loading the value back
+   after paying for the store */
+static int expr_reusable(const Expr *self)
 {
-  write_expr_core(self, expr->expr, ADR_NULL);
-  write_inst2(self, "XOR", r(expr->expr->reg), "=1");
-  if (expr->reg != expr->expr->reg) {
-    write_inst2(self, "LD", r1(expr->reg), r2(expr->expr->reg));
+  switch (self->kind) {
+  case EXPR_BINARY: {
+    const BinaryExpr *expr = (const BinaryExpr *) self;
+    if (expr->op != BINARY_ADD && expr->op != BINARY_SUB && expr->op != BINARY_MUL && expr->op != BINARY_DIV) {
+      return 0;
+    }
+    break;
+  }
+
+  case EXPR_VAR:
+    if (!((const VarExpr *) self)->index) {
+      return 0;
+    }
+    break;
+
+  default:
+    return 0;
   }
+  return expr_cost(self) >= 4;
 }
 
-static void write_cast_expr(Generator *self, const CastExpr *expr, Adr sink)
+/* whether the `count` items of `left` from `left_first` equal those of `right` from `right_first` */
+static int key_equal(const KeyArray *left, unsigned long left_first, const KeyArray *right, unsigned long right_first, unsigned long count)
 {
-  if (expr->type == expr->expr->type) {
-    if (expr->reg != expr->expr->reg) {
-      write_expr_core(self, expr->expr, ADR_NULL);
-      write_inst2(self, "LD", r1(expr->reg), r2(expr->expr->reg));
-    } else {
-      write_expr_core(self, expr->expr, sink);
+  unsigned long i;
+  for (i = 0; i < count; ++i) {
+    const KeyItem *l = key_array_at(left, left_first + i);
+    const KeyItem *r = key_array_at(right, right_first + i);
+    if (l->kind != r->kind || l->def != r->def || l->value != r->value) {
+      return 0;
     }
-  } else {
-    switch (type_kind(expr->type)) {
-    case TYPE_BOOLEAN: {
-      write_expr_core(self, expr->expr, ADR_NULL);
-      if (expr->reg != expr->expr->reg) {
-        Adr next_block = self->label_count++;
-        write_inst2(self, "CPA", r(expr->expr->reg), "=0");
-        write_inst1(self, "JZE", adr(next_block));
-        write_inst2(self, "LAD", r(expr->expr->reg), "1");
-        write_label(self, next_block);
-        write_inst2(self, "LD", r1(expr->reg), r2(expr->expr->reg));
-      } else {
-        Adr next_block = sink ? sink : self->label_count++;
-        write_inst2(self, "CPA", r(expr->expr->reg), "=0");
-        write_inst1(self, "JZE", adr(next_block));
-        write_inst2(self, "LAD", r(expr->expr->reg), "1");
-        if (!sink) {
-          write_label(self, next_block);
-        }
-      }
-      break;
+  }
+  return 1;
+}
+
+/* whether the `count` items of `keys` from `first` read `def`, which was just written.
+   a parameter may refer to any variable, so a key reading one is affected by any write */
+static int key_reads(const KeyArray *keys, unsigned long first, unsigned long count, const Def *def)
+{
+  unsigned long i;
+  for (i = 0; i < count; ++i) {
+    const KeyItem *item = key_array_at(keys, first + i);
+    if (item->def && (item->def == def || def_kind(item->def) == DEF_PARAM)) {
+      return 1;
     }
+  }
+  return 0;
+}
 
-    case TYPE_INTEGER: {
-      if (expr->reg != expr->expr->reg) {
-        write_expr_core(self, expr->expr, ADR_NULL);
-        write_inst2(self, "LD", r1(expr->reg), r2(expr->expr->reg));
-      } else {
-        write_expr_core(self, expr->expr, sink);
-      }
-      break;
+/* the check whose key is the `count` items of `keys` from `first`, if any */
+static Check *find_check(Generator *self, unsigned long first, unsigned long count)
+{
+  unsigned long i;
+  for (i = 0; i < check_array_count(&self->checks); ++i) {
+    Check *check = check_array_at(&self->checks, i);
+    if (check->count == count && key_equal(&self->keys, check->first, &self->keys, first, count)) {
+      return check;
     }
+  }
+  return NULL;
+}
 
-    case TYPE_CHAR: {
-      switch (type_kind(expr->expr->type)) {
-      case TYPE_BOOLEAN:
-        if (expr->reg != expr->expr->reg) {
-          write_expr_core(self, expr->expr, ADR_NULL);
-          write_inst2(self, "LD", r1(expr->reg), r2(expr->expr->reg));
-        } else {
-          write_expr_core(self, expr->expr, sink);
-        }
-        break;
+/* the position in `values`, whose keys are in `value_keys`, of the value whose key is
+   the `count` items of `keys` from `first`, or -1 if there is none */
+static long find_value(const ValueArray *values, const KeyArray *value_keys, const KeyArray *keys, unsigned long first, unsigned long count)
+{
+  unsigned long i;
+  for (i = 0; i < value_array_count(values); ++i) {
+    const Value *value = value_array_at(values, i);
+    if (value->count == count && key_equal(value_keys, value->first, keys, first, count)) {
+      return (long) i;
+    }
+  }
+  return -1;
+}
 
-      case TYPE_INTEGER:
-        write_expr_core(self, expr->expr, ADR_NULL);
-        write_inst2(self, "AND", r(expr->expr->reg), "=#00FF");
+/* forget the checks and values reading `def`, which was just written, or all of them
+   if `def` is NULL. writing a parameter forgets everything, since it may refer to any variable */
+static void forget_known(Generator *self, const Def *def)
+{
+  unsigned long i, j;
 
-        if (expr->reg != expr->expr->reg) {
-          write_inst2(self, "LD", r1(expr->reg), r2(expr->expr->reg));
-        }
-        break;
+  if (!def || def_kind(def) == DEF_PARAM) {
+    key_array_clear(&self->keys);
+    check_array_clear(&self->checks);
+    value_array_clear(&self->values);
+    return;
+  }
 
-      default:
-        unreachable();
-      }
-      break;
+  for (i = j = 0; i < check_array_count(&self->checks); ++i) {
+    Check check = *check_array_at(&self->checks, i);
+    if (!key_reads(&self->keys, check.first, check.count, def)) {
+      *check_array_at(&self->checks, j++) = check;
     }
+  }
+  check_array_pop_count(&self->checks, i - j);
 
-    default:
-      unreachable();
+  for (i = j = 0; i < value_array_count(&self->values); ++i) {
+    Value value = *value_array_at(&self->values, i);
+    if (!key_reads(&self->keys, value.first, value.count, def)) {
+      *value_array_at(&self->values, j++) = value;
     }
   }
+  value_array_pop_count(&self->values, i - j);
 }
 
-static void write_var(Generator *self, const VarExpr *expr)
+static void write_label(Generator *self, Adr a)
 {
-  Adr label = locate(self, expr->def, ADR_NULL);
-  if (expr->index) {
-    const Type   *type   = ctx_type_of(self->ctx, def_syntax(expr->def), NULL);
-    unsigned long length = array_type_length((const ArrayType *) type);
-
-    if (length > 0) {
-      char buf[16];
-      sprintf(buf, "=%lu", length - 1);
-      write_expr_core(self, expr->index, ADR_NULL);
-      write_inst2(self, "CPA", r(expr->index->reg), buf);
-      write_inst1(self, "JPL", "ERNG");
-      write_inst3(self, "LD", r(expr->reg), adr(label), x(expr->index->reg));
-    } else {
-      write_inst1(self, "JPL", "ERNG");
-    }
-    self->builtin_error_range = 1;
-  } else if (def_kind(expr->def) == DEF_PARAM) {
-    write_inst2(self, "LD", r(expr->reg), adr(label));
-    write_inst3(self, "LD", r(expr->reg), "0", x(expr->reg));
-  } else {
-    write_inst2(self, "LD", r(expr->reg), adr(label));
+  forget_known(self, NULL);
+  if (self->current_label && self->current_label != a) {
+    write_inst0(self, OP_NOP);
   }
+  self->current_label = a;
 }
 
-static void write_lit(Generator *self, const LitExpr *expr)
+/* put back `label`, left over from instructions dropped at the end of the list,
+   in front of the next instruction */
+static void write_pending_label(Generator *self, Adr label)
 {
-  char buf[16];
-  if (expr->hex) {
-    sprintf(buf, "#%04lX", expr->value);
-  } else {
-    sprintf(buf, "%lu", expr->value);
+  Adr current         = self->current_label;
+  self->current_label = label;
+  if (current) {
+    write_label(self, current);
   }
-  write_inst2(self, "LAD", r(expr->reg), buf);
 }
 
-static void write_expr_core(Generator *self, const Expr *expr, Adr sink)
+static void truncate_insts(Generator *self, unsigned long count)
 {
-  switch (expr->kind) {
-  case EXPR_BINARY:
-    write_binary_expr(self, (const BinaryExpr *) expr, sink);
+  unsigned long i;
+  for (i = count; i < inst_array_count(&self->insts); ++i) {
+    Inst *inst = inst_array_at(&self->insts, i);
+    if (inst->adr.kind == OPERAND_STRING) {
+      free(inst->adr.text);
+    }
+  }
+  self->insts.count = count;
+}
+
+static void print_operand(Generator *self, const Operand *operand)
+{
+  char buf[24];
+  switch (operand->kind) {
+  case OPERAND_LABEL:
+    fmt_adr(buf, operand->value);
     break;
 
-  case EXPR_NOT:
-    write_not_expr(self, (const NotExpr *) expr);
+  case OPERAND_NAME:
+  case OPERAND_STRING:
+    emitter_puts(self->emitter, operand->text);
+    return;
+
+  case OPERAND_NUMBER:
+    format_ulong(buf, operand->value);
     break;
 
-  case EXPR_CAST:
-    write_cast_expr(self, (const CastExpr *) expr, sink);
+  case OPERAND_HEX:
+    sprintf(buf, "#%04lX", operand->value);
     break;
 
-  case EXPR_VAR:
-    write_var(self, (const VarExpr *) expr);
+  case OPERAND_LITERAL:
+    buf[0] = '=';
+    format_ulong(buf + 1, operand->value);
     break;
 
-  case EXPR_LIT:
-    write_lit(self, (const LitExpr *) expr);
+  case OPERAND_LITERAL_HEX:
+    sprintf(buf, "=#%04lX", operand->value);
     break;
 
   default:
     unreachable();
   }
+  emitter_puts(self->emitter, buf);
+}
 
-  if (expr->spill) {
-    write_inst2(self, "PUSH", "0", r(expr->reg));
+/* print the instructions generated so far and release them */
+static void flush_insts(Generator *self)
+{
+  static const char *mnemonics[] = {
+    "START", "END", "DC", "DS", "NOP", "LD", "ST", "LAD", "ADDA", "SUBA", "MULA", "DIVA", "AND",
+    "OR", "XOR", "CPA", "CPL", "JUMP", "JPL", "JMI", "JNZ", "JZE", "JOV", "PUSH", "POP", "CALL", "RET"
+  };
+
+  unsigned long i;
+  char          buf[24];
+
+  for (i = 0; i < inst_array_count(&self->insts); ++i) {
+    const Inst *inst = inst_array_at(&self->insts, i);
+    const char *sep  = "";
+
+    if (inst->label) {
+      fmt_adr(buf, inst->label);
+      write_field(self, buf, 10);
+    } else {
+      emitter_pad(self->emitter, 10);
+    }
+    if (inst->r == REG_NONE && inst->x == REG_NONE && inst->adr.kind == OPERAND_NONE) {
+      emitter_puts(self->emitter, mnemonics[inst->op]);
+    } else {
+      write_field(self, mnemonics[inst->op], 6);
+      if (inst->r != REG_NONE) {
+        fmt_reg(buf, inst->r);
+        emitter_puts(self->emitter, buf);
+        sep = ", ";
+      }
+      if (inst->adr.kind != OPERAND_NONE) {
+        emitter_puts(self->emitter, sep);
+        print_operand(self, &inst->adr);
+        sep = ", ";
+      }
+      if (inst->x != REG_NONE) {
+        emitter_puts(self->emitter, sep);
+        fmt_reg(buf, inst->x);
+        emitter_puts(self->emitter, buf);
+      }
+    }
+    emitter_putc(self->emitter, '\n');
   }
+  truncate_insts(self, 0);
 }
 
-static Reg write_expr(Generator *self, const AnyMpplExpr *syntax, Adr sink)
+static void write_builtin(Generator *self, const char **lines, unsigned long count)
 {
-  Expr    *expr  = expr_new(self->ctx, syntax);
-  RegState state = reg_state();
-  Reg      reg   = reg_state_vacant(&state);
-
-  expr_assign_reg(expr, reg, &state);
-  write_expr_core(self, expr, sink);
-  expr_free(expr);
-  return reg;
+  unsigned long i;
+  for (i = 0; i < count; ++i) {
+    emitter_puts(self->emitter, lines[i]);
+    emitter_putc(self->emitter, '\n');
+  }
 }
 
-static Adr write_stmt(Generator *self, const AnyMpplStmt *syntax, Adr source, Adr sink);
+static void write_expr_core(Generator *self, const Expr *expr, Adr sink);
 
-static Adr write_assign_stmt(Generator *self, const MpplAssignStmt *syntax)
+/* check `index`, already evaluated, against the length of the array `def`, unless it is
+   a constant within the bounds or the same index already passed a check as tight earlier
+   in the block. the comparison is unsigned, so negative indices fail it as well */
+static void write_range_check(Generator *self, const Def *def, const Expr *index)
 {
-  AnyMpplVar  *lhs_syntax = mppl_assign_stmt__lhs(syntax);
-  AnyMpplExpr *rhs_syntax = mppl_assign_stmt__rhs(syntax);
+  const Type   *type   = ctx_type_of(self->ctx, def_syntax(def), NULL);
+  unsigned long length = array_type_length((const ArrayType *) type);
 
-  switch (mppl_var__kind(lhs_syntax)) {
-  case MPPL_VAR_ENTIRE: {
-    MpplEntireVar *entire_syntax = (MpplEntireVar *) lhs_syntax;
-    MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
-    const Def     *def           = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-    Adr            label         = locate(self, def, ADR_NULL);
-
-    RegState state     = reg_state();
-    Expr    *value     = expr_new(self->ctx, rhs_syntax);
-    Reg      value_reg = reg_state_vacant(&state);
-    expr_assign_reg(value, value_reg, &state);
-
-    write_expr_core(self, value, ADR_NULL);
-    if (def_kind(def) == DEF_PARAM) {
-      Reg reg = reg_state_vacant(&state);
-      write_inst2(self, "LD", r(reg), adr(label));
-      write_inst3(self, "ST", r(value_reg), "0", x(reg));
-    } else {
-      write_inst2(self, "ST", r(value_reg), adr(label));
+  if (length > 0) {
+    unsigned long first;
+    Check        *check;
+
+    if (index->kind == EXPR_LIT && ((const LitExpr *) index)->value < length) {
+      return;
     }
 
-    expr_free(value);
-    mppl_unref(name_syntax);
-    break;
+    first = key_array_count(&self->keys);
+    expr_key(index, &self->keys);
+    check = find_check(self, first, key_array_count(&self->keys) - first);
+    if (check && check->last <= length - 1) {
+      key_array_pop_count(&self->keys, key_array_count(&self->keys) - first);
+      return;
+    }
+    write_inst_ra(self, OP_CPL, index->reg, lit(length - 1));
+    if (check) {
+      check->last = length - 1;
+      key_array_pop_count(&self->keys, key_array_count(&self->keys) - first);
+    } else {
+      Check checked;
+      checked.first = first;
+      checked.count = key_array_count(&self->keys) - first;
+      checked.last  = length - 1;
+      check_array_push(&self->checks, checked);
+    }
   }
+  write_inst_a(self, OP_JPL, sym("ERNG"));
+  self->builtin_error_range = 1;
+}
 
-  case MPPL_VAR_INDEXED: {
-    MpplIndexedVar *indexed_syntax = (MpplIndexedVar *) lhs_syntax;
-    MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
-    AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
-    const Def      *def            = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-    Adr             label          = locate(self, def, ADR_NULL);
-
-    RegState state = reg_state();
-    Expr    *value = expr_new(self->ctx, rhs_syntax);
-    Expr    *index = expr_new(self->ctx, index_syntax);
-    Reg      value_reg, index_reg;
-
-    value_reg = reg_state_vacant(&state);
-    expr_assign_reg(value, value_reg, &state);
-    index_reg = reg_state_vacant(&state);
-    expr_assign_reg(index, index_reg, &state);
-    reg_state_release(&state, value_reg);
-    reg_state_release(&state, index_reg);
+/* evaluate the index of `expr` and check it */
+static void write_index(Generator *self, const VarExpr *expr)
+{
+  write_expr_core(self, expr->index, ADR_NULL);
+  write_range_check(self, expr->def, expr->index);
+}
 
-    write_expr_core(self, value, ADR_NULL);
-    write_expr_core(self, index, ADR_NULL);
+/* evaluate the index `syntax` into the array `def` and check it */
+static Reg write_checked_index(Generator *self, const Def *def, const AnyMpplExpr *syntax)
+{
+  Expr    *expr  = expr_new(self, syntax);
+  RegState state = reg_state(self);
+  Reg      reg   = reg_state_vacant(&state);
 
-    write_inst3(self, "ST", r(value_reg), adr(label), x(index_reg));
+  expr_assign_reg(expr, reg, 0, &state);
+  write_expr_core(self, expr, ADR_NULL);
+  write_range_check(self, def, expr);
+  reg = expr->reg;
+  expr_free(expr);
+  return reg;
+}
 
-    expr_free(value);
-    expr_free(index);
-    mppl_unref(name_syntax);
-    mppl_unref(index_syntax);
-    break;
+/* prepare `expr` to be read from the address field of an instruction */
+static void write_operand(Generator *self, const Expr *expr)
+{
+  if (expr->kind == EXPR_VAR) {
+    const VarExpr *var = (const VarExpr *) expr;
+    if (var->index) {
+      write_index(self, var);
+    } else if (expr->need) {
+      if (var->promoted != REG_NONE) {
+        write_inst_rr(self, OP_LD, expr->reg, var->promoted);
+      } else {
+        write_inst_ra(self, OP_LD, expr->reg, adr(locate(self, var->def, ADR_NULL)));
+      }
+    }
   }
 
-  default:
-    unreachable();
+  if (expr->spill) {
+    write_inst(self, OP_PUSH, REG_NONE, num(0), expr->reg);
   }
+}
 
-  mppl_unref(lhs_syntax);
-  mppl_unref(rhs_syntax);
+/* the address field reading `expr` prepared by `write_operand`, with the index register in `x` */
+static Operand operand_of(Generator *self, const Expr *expr, Reg *x)
+{
+  if (expr->kind == EXPR_LIT) {
+    const LitExpr *lit = (const LitExpr *) expr;
+    *x                 = REG_NONE;
+    return operand(lit->hex ? OPERAND_LITERAL_HEX : OPERAND_LITERAL, lit->value);
+  } else {
+    const VarExpr *var = (const VarExpr *) expr;
+    if (var->index || expr->need) {
+      *x = expr->reg;
+    } else {
+      *x = var->promoted;
+    }
 
-  return ADR_NULL;
+    if (var->index) {
+      return adr(locate(self, var->def, ADR_NULL));
+    } else if (def_kind(var->def) == DEF_PARAM) {
+      return num(0);
+    } else if (var->promoted != REG_NONE) {
+      return none();
+    } else {
+      return adr(locate(self, var->def, ADR_NULL));
+    }
+  }
 }
 
-static Adr write_if_stmt(Generator *self, const MpplIfStmt *syntax, Adr sink)
+/* evaluate two operands assigned by `expr_assign_pair`, reloading the spilled one */
+static void write_pair(Generator *self, const Expr *lhs, const Expr *rhs, int rhs_first, int fold)
 {
-  AnyMpplExpr *cond_syntax = mppl_if_stmt__cond(syntax);
-  AnyMpplStmt *then_syntax = mppl_if_stmt__then_stmt(syntax);
-  AnyMpplStmt *else_syntax = mppl_if_stmt__else_stmt(syntax);
-  Adr          next_block  = sink ? sink : self->label_count++;
-  Adr          false_block = else_syntax ? self->label_count++ : next_block;
-  Reg          reg;
-
-  reg = write_expr(self, cond_syntax, ADR_NULL);
-  write_inst2(self, "CPA", r(reg), "=1");
-  write_inst1(self, "JNZ", adr(false_block));
-  write_stmt(self, then_syntax, ADR_NULL, ADR_NULL);
+  if (rhs_first) {
+    if (fold) {
+      write_operand(self, rhs);
+    } else {
+      write_expr_core(self, rhs, ADR_NULL);
+    }
+    write_expr_core(self, lhs, ADR_NULL);
+    if (rhs->spill) {
+      write_inst_r(self, OP_POP, rhs->reg);
+    }
+  } else {
+    write_expr_core(self, lhs, ADR_NULL);
+    if (fold) {
+      write_operand(self, rhs);
+    } else {
+      write_expr_core(self, rhs, ADR_NULL);
+    }
+    if (lhs->spill) {
+      write_inst_r(self, OP_POP, lhs->reg);
+    }
+  }
+}
 
-  if (else_syntax) {
-    write_inst1(self, "JUMP", adr(next_block));
-    write_label(self, false_block);
-    write_stmt(self, else_syntax, false_block, next_block);
+/* apply `op` to the operands of `expr`, folding the rhs into the address field if possible */
+static void write_binary_inst(Generator *self, Op op, const BinaryExpr *expr)
+{
+  if (expr->fold) {
+    Reg     x;
+    Operand rhs = operand_of(self, expr->rhs, &x);
+    write_inst(self, op, expr->lhs->reg, rhs, x);
+  } else {
+    write_inst_rr(self, op, expr->lhs->reg, expr->rhs->reg);
   }
+}
+
+/* `op` jumps when the comparison holds, or when it fails if `negate` is set */
+static void write_relational_expr(Generator *self, Op op, const BinaryExpr *expr, int negate, Adr sink)
+{
+  Adr else_block = self->label_count++;
+  Adr next_block = sink ? sink : self->label_count++;
+
+  write_pair(self, expr->lhs, expr->rhs, expr->rhs_first, expr->fold);
+  write_binary_inst(self, OP_CPA, expr);
+  write_inst_a(self, op, adr(else_block));
+  write_inst_ra(self, OP_LAD, expr->reg, num(negate));
+  write_inst_a(self, OP_JUMP, adr(next_block));
+  write_label(self, else_block);
+  write_inst_ra(self, OP_LAD, expr->reg, num(!negate));
 
   if (!sink) {
     write_label(self, next_block);
   }
-
-  mppl_unref(cond_syntax);
-  mppl_unref(then_syntax);
-  mppl_unref(else_syntax);
-
-  return next_block;
 }
 
-static Adr write_while_stmt(Generator *self, const MpplWhileStmt *syntax, Adr source, Adr sink)
+static void write_arithmetic_expr(Generator *self, Op op, const BinaryExpr *expr, int check_overflow, int check_zero_division)
 {
-  AnyMpplExpr *cond_syntax          = mppl_while_stmt__cond(syntax);
+  write_pair(self, expr->lhs, expr->rhs, expr->rhs_first, expr->fold);
+  if (check_zero_division && !expr->fold) {
+    write_inst_ra(self, OP_CPA, expr->rhs->reg, lit(0));
+    write_inst_a(self, OP_JZE, sym("E0DIV"));
+    self->builtin_error_zero_division = 1;
+  }
+  write_binary_inst(self, op, expr);
+  if (check_overflow) {
+    write_inst_a(self, OP_JOV, sym("EOVF"));
+    self->builtin_error_overflow = 1;
+  }
+  if (expr->reg != expr->lhs->reg) {
+    write_inst_rr(self, OP_LD, expr->reg, expr->lhs->reg);
+  }
+}
+
+static void write_logical_expr(Generator *self, Op op, const BinaryExpr *expr, Adr sink)
+{
+  Adr next_block = sink ? sink : self->label_count++;
+  if (expr->reg != expr->lhs->reg) {
+    Adr else_block = self->label_count++;
+    write_expr_core(self, expr->lhs, ADR_NULL);
+    write_inst_ra(self, OP_CPA, expr->lhs->reg, lit(1));
+    write_inst_a(self, op, adr(else_block));
+    write_expr_core(self, expr->rhs, ADR_NULL);
+    if (expr->reg != expr->rhs->reg) {
+      write_inst_rr(self, OP_LD, expr->reg, expr->rhs->reg);
+    }
+    write_inst_a(self, OP_JUMP, adr(next_block));
+    write_label(self, else_block);
+    write_inst_rr(self, OP_LD, expr->reg, expr->lhs->reg);
+  } else {
+    write_expr_core(self, expr->lhs, ADR_NULL);
+    write_inst_ra(self, OP_CPA, expr->lhs->reg, lit(1));
+    write_inst_a(self, op, adr(next_block));
+    if (expr->reg != expr->rhs->reg) {
+      write_expr_core(self, expr->rhs, ADR_NULL);
+      write_inst_rr(self, OP_LD, expr->reg, expr->rhs->reg);
+    } else {
+      write_expr_core(self, expr->rhs, next_block);
+    }
+  }
+
+  if (!sink) {
+    write_label(self, next_block);
+  }
+}
+
+static void write_binary_expr(Generator *self, const BinaryExpr *expr, Adr sink)
+{
+  switch (expr->op) {
+  case BINARY_EQ:
+    write_relational_expr(self, OP_JZE, expr, 0, sink);
+    break;
+
+  case BINARY_NE:
+    write_relational_expr(self, OP_JNZ, expr, 0, sink);
+    break;
+
+  case BINARY_LT:
+    write_relational_expr(self, OP_JMI, expr, 0, sink);
+    break;
+
+  case BINARY_LE:
+    write_relational_expr(self, OP_JPL, expr, 1, sink);
+    break;
+
+  case BINARY_GT:
+    write_relational_expr(self, OP_JPL, expr, 0, sink);
+    break;
+
+  case BINARY_GE:
+    write_relational_expr(self, OP_JMI, expr, 1, sink);
+    break;
+
+  case BINARY_ADD:
+    write_arithmetic_expr(self, OP_ADDA, expr, 1, 0);
+    break;
+
+  case BINARY_SUB:
+    write_arithmetic_expr(self, OP_SUBA, expr, 0, 0);
+    break;
+
+  case BINARY_MUL:
+    write_arithmetic_expr(self, OP_MULA, expr, 1, 0);
+    break;
+
+  case BINARY_DIV:
+    write_arithmetic_expr(self, OP_DIVA, expr, 0, 1);
+    break;
+
+  case BINARY_AND:
+    if (expr->fold) {
+      write_arithmetic_expr(self, OP_AND, expr, 0, 0);
+    } else {
+      write_logical_expr(self, OP_JNZ, expr, sink);
+    }
+    break;
+
+  case BINARY_OR:
+    if (expr->fold) {
+      write_arithmetic_expr(self, OP_OR, expr, 0, 0);
+    } else {
+      write_logical_expr(self, OP_JZE, expr, sink);
+    }
+    break;
+
+  default:
+    unreachable();
+  }
+}
+
+static void write_not_expr(Generator *self, const NotExpr *expr)
+{
+  write_expr_core(self, expr->expr, ADR_NULL);
+  write_inst_ra(self, OP_XOR, expr->expr->reg, lit(1));
+  if (expr->reg != expr->expr->reg) {
+    write_inst_rr(self, OP_LD, expr->reg, expr->expr->reg);
+  }
+}
+
+static void write_cast_expr(Generator *self, const CastExpr *expr, Adr sink)
+{
+  if (expr->type == expr->expr->type) {
+    if (expr->reg != expr->expr->reg) {
+      write_expr_core(self, expr->expr, ADR_NULL);
+      write_inst_rr(self, OP_LD, expr->reg, expr->expr->reg);
+    } else {
+      write_expr_core(self, expr->expr, sink);
+    }
+  } else {
+    switch (type_kind(expr->type)) {
+    case TYPE_BOOLEAN: {
+      write_expr_core(self, expr->expr, ADR_NULL);
+      if (expr->reg != expr->expr->reg) {
+        Adr next_block = self->label_count++;
+        write_inst_ra(self, OP_CPA, expr->expr->reg, lit(0));
+        write_inst_a(self, OP_JZE, adr(next_block));
+        write_inst_ra(self, OP_LAD, expr->expr->reg, num(1));
+        write_label(self, next_block);
+        write_inst_rr(self, OP_LD, expr->reg, expr->expr->reg);
+      } else {
+        Adr next_block = sink ? sink : self->label_count++;
+        write_inst_ra(self, OP_CPA, expr->expr->reg, lit(0));
+        write_inst_a(self, OP_JZE, adr(next_block));
+        write_inst_ra(self, OP_LAD, expr->expr->reg, num(1));
+        if (!sink) {
+          write_label(self, next_block);
+        }
+      }
+      break;
+    }
+
+    case TYPE_INTEGER: {
+      if (expr->reg != expr->expr->reg) {
+        write_expr_core(self, expr->expr, ADR_NULL);
+        write_inst_rr(self, OP_LD, expr->reg, expr->expr->reg);
+      } else {
+        write_expr_core(self, expr->expr, sink);
+      }
+      break;
+    }
+
+    case TYPE_CHAR: {
+      switch (type_kind(expr->expr->type)) {
+      case TYPE_BOOLEAN:
+        if (expr->reg != expr->expr->reg) {
+          write_expr_core(self, expr->expr, ADR_NULL);
+          write_inst_rr(self, OP_LD, expr->reg, expr->expr->reg);
+        } else {
+          write_expr_core(self, expr->expr, sink);
+        }
+        break;
+
+      case TYPE_INTEGER:
+        write_expr_core(self, expr->expr, ADR_NULL);
+        write_inst_ra(self, OP_AND, expr->expr->reg, operand(OPERAND_LITERAL_HEX, 0x00FF));
+
+        if (expr->reg != expr->expr->reg) {
+          write_inst_rr(self, OP_LD, expr->reg, expr->expr->reg);
+        }
+        break;
+
+      default:
+        unreachable();
+      }
+      break;
+    }
+
+    default:
+      unreachable();
+    }
+  }
+}
+
+static void write_var(Generator *self, const VarExpr *expr)
+{
+  if (expr->index) {
+    write_index(self, expr);
+    write_inst(self, OP_LD, expr->reg, adr(locate(self, expr->def, ADR_NULL)), expr->index->reg);
+  } else if (expr->promoted != REG_NONE) {
+    if (def_kind(expr->def) == DEF_PARAM) {
+      write_inst(self, OP_LD, expr->reg, num(0), expr->promoted);
+    } else if (expr->reg != expr->promoted) {
+      write_inst_rr(self, OP_LD, expr->reg, expr->promoted);
+    }
+  } else if (def_kind(expr->def) == DEF_PARAM) {
+    write_inst_ra(self, OP_LD, expr->reg, adr(locate(self, expr->def, ADR_NULL)));
+    write_inst(self, OP_LD, expr->reg, num(0), expr->reg);
+  } else {
+    write_inst_ra(self, OP_LD, expr->reg, adr(locate(self, expr->def, ADR_NULL)));
+  }
+}
+
+static void write_lit(Generator *self, const LitExpr *expr)
+{
+  write_inst_ra(self, OP_LAD, expr->reg, operand(expr->hex ? OPERAND_HEX : OPERAND_NUMBER, expr->value));
+}
+
+static void write_expr_value(Generator *self, const Expr *expr, Adr sink)
+{
+  switch (expr->kind) {
+  case EXPR_BINARY:
+    write_binary_expr(self, (const BinaryExpr *) expr, sink);
+    break;
+
+  case EXPR_NOT:
+    write_not_expr(self, (const NotExpr *) expr);
+    break;
+
+  case EXPR_CAST:
+    write_cast_expr(self, (const CastExpr *) expr, sink);
+    break;
+
+  case EXPR_VAR:
+    write_var(self, (const VarExpr *) expr);
+    break;
+
+  case EXPR_LIT:
+    write_lit(self, (const LitExpr *) expr);
+    break;
+
+  default:
+    unreachable();
+  }
+}
+
+/* evaluate `expr` into its register. the planning pass notes the expressions computed
+   again while their first value is still valid, and the second pass keeps the first
+   value of those in a slot of their own and loads it back instead of recomputing it */
+static void write_expr_core(Generator *self, const Expr *expr, Adr sink)
+{
+  if (self->reusing || !expr_reusable(expr)) {
+    write_expr_value(self, expr, sink);
+  } else {
+    unsigned long first = key_array_count(&self->keys);
+    unsigned long count;
+    long          known;
+    long          reused;
+
+    expr_key(expr, &self->keys);
+    count  = key_array_count(&self->keys) - first;
+    known  = find_value(&self->values, &self->keys, &self->keys, first, count);
+    reused = find_value(&self->reused, &self->reused_keys, &self->keys, first, count);
+    if (self->planning && known >= 0 && reused < 0) {
+      Value         value;
+      unsigned long i;
+      value.first = key_array_count(&self->reused_keys);
+      value.count = count;
+      value.slot  = ADR_NULL;
+      for (i = 0; i < count; ++i) {
+        key_array_push(&self->reused_keys, *key_array_at(&self->keys, first + i));
+      }
+      value_array_push(&self->reused, value);
+    }
+    key_array_pop_count(&self->keys, count);
+
+    if (known >= 0 && !self->planning) {
+      write_inst_ra(self, OP_LD, expr->reg, adr(value_array_at(&self->values, known)->slot));
+    } else if (known >= 0) {
+      /* the children of an expression reused in the second pass are not evaluated there */
+      ++self->reusing;
+      write_expr_value(self, expr, sink);
+      --self->reusing;
+    } else {
+      write_expr_value(self, expr, sink);
+      if (self->planning || reused >= 0) {
+        Value value;
+        value.first = key_array_count(&self->keys);
+        expr_key(expr, &self->keys);
+        value.count = key_array_count(&self->keys) - value.first;
+        value.slot  = ADR_NULL;
+        if (!self->planning) {
+          Value *entry = value_array_at(&self->reused, reused);
+          if (!entry->slot) {
+            entry->slot = self->var_label_count++;
+          }
+          value.slot = entry->slot;
+          write_inst_ra(self, OP_ST, expr->reg, adr(value.slot));
+        }
+        value_array_push(&self->values, value);
+      }
+    }
+  }
+
+  if (expr->spill) {
+    write_inst(self, OP_PUSH, REG_NONE, num(0), expr->reg);
+  }
+}
+
+static Reg write_expr(Generator *self, const AnyMpplExpr *syntax, Adr sink)
+{
+  Expr    *expr  = expr_new(self, syntax);
+  RegState state = reg_state(self);
+  Reg      reg   = reg_state_vacant(&state);
+
+  expr_assign_reg(expr, reg, 0, &state);
+  write_expr_core(self, expr, sink);
+  reg = expr->reg;
+  expr_free(expr);
+  return reg;
+}
+
+static Adr write_stmt(Generator *self, const AnyMpplStmt *syntax, Adr source, Adr sink);
+
+/* registers each builtin overwrites, including the builtins it calls */
+#define CLOBBER_WRITE_INTEGER (REG_ALL & ~REG_BIT(GR3))
+#define CLOBBER_WRITE_BOOLEAN (REG_ALL & ~REG_BIT(GR3))
+#define CLOBBER_WRITE_STRING  (REG_ALL & ~REG_BIT(GR3))
+#define CLOBBER_WRITE_CHAR    (REG_BIT(GR0) | REG_BIT(GR2) | REG_BIT(GR6) | REG_BIT(GR7))
+#define CLOBBER_WRITE_NEWLINE (REG_BIT(GR0) | REG_BIT(GR6) | REG_BIT(GR7))
+#define CLOBBER_FLUSH         (REG_BIT(GR0))
+#define CLOBBER_READ_INTEGER  (REG_BIT(GR0) | REG_BIT(GR5) | REG_BIT(GR6) | REG_BIT(GR7))
+#define CLOBBER_READ_CHAR     (REG_BIT(GR0) | REG_BIT(GR5) | REG_BIT(GR7))
+#define CLOBBER_READ_LINE     (REG_BIT(GR0))
+
+/* save the promoted registers the call clobbers; arguments are pushed after this */
+static unsigned long call_begin(Generator *self)
+{
+  unsigned long call = self->call_count++;
+  if (!self->planning && call < mask_array_count(&self->calls)) {
+    unsigned long saves = *mask_array_at(&self->calls, call);
+    Reg           reg;
+    for (reg = GR0; reg <= GR7; ++reg) {
+      if (saves & REG_BIT(reg)) {
+        write_inst(self, OP_PUSH, REG_NONE, num(0), reg);
+      }
+    }
+  }
+  return call;
+}
+
+static void write_call(Generator *self, unsigned long call, Operand target, unsigned long clobber)
+{
+  write_inst_a(self, OP_CALL, target);
+  if (self->planning) {
+    mask_array_push(&self->calls, inst_array_count(&self->insts) - 1);
+    mask_array_push(&self->call_clobbers, clobber);
+    self->clobbered |= clobber;
+  } else {
+    unsigned long saves = call < mask_array_count(&self->calls) ? *mask_array_at(&self->calls, call) : 0;
+    unsigned long clobbered = self->clobbered;
+    Reg           reg;
+    for (reg = GR7; reg >= GR0; --reg) {
+      if (saves & REG_BIT(reg)) {
+        write_inst_r(self, OP_POP, reg);
+      }
+    }
+    while (self->reload_count < reload_array_count(&self->reloads)) {
+      const Reload *reload = reload_array_at(&self->reloads, self->reload_count);
+      if (reload->call != call) {
+        break;
+      }
+      write_inst_ra(self, OP_LD, reload->reg, adr(locate(self, reload->def, ADR_NULL)));
+      ++self->reload_count;
+    }
+    self->clobbered = clobbered | (clobber & ~saves);
+  }
+}
+
+static void write_builtin_call(Generator *self, const char *builtin, unsigned long clobber)
+{
+  write_call(self, call_begin(self), sym(builtin), clobber);
+}
+
+static Adr write_assign_stmt(Generator *self, const MpplAssignStmt *syntax)
+{
+  AnyMpplVar  *lhs_syntax = mppl_assign_stmt__lhs(syntax);
+  AnyMpplExpr *rhs_syntax = mppl_assign_stmt__rhs(syntax);
+
+  switch (mppl_var__kind(lhs_syntax)) {
+  case MPPL_VAR_ENTIRE: {
+    MpplEntireVar *entire_syntax = (MpplEntireVar *) lhs_syntax;
+    MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
+    const Def     *def           = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
+    Reg            target        = promoted(self, def);
+
+    RegState state = reg_state(self);
+    Expr    *value = expr_new(self, rhs_syntax);
+
+    if (target != REG_NONE && def_kind(def) != DEF_PARAM) {
+      if (!self->planning && expr_can_target(value, def, target)) {
+        expr_assign_reg(value, target, 1, &state);
+        write_expr_core(self, value, ADR_NULL);
+      } else {
+        expr_assign_reg(value, reg_state_vacant(&state), 0, &state);
+        write_expr_core(self, value, ADR_NULL);
+        if (value->reg != target) {
+          write_inst_rr(self, OP_LD, target, value->reg);
+        }
+      }
+    } else {
+      expr_assign_reg(value, reg_state_vacant(&state), 0, &state);
+      write_expr_core(self, value, ADR_NULL);
+      if (def_kind(def) == DEF_PARAM) {
+        if (target != REG_NONE && !self->planning) {
+          write_inst(self, OP_ST, value->reg, num(0), target);
+        } else {
+          Reg reg = reg_state_vacant(&state);
+          if (target != REG_NONE) {
+            write_inst_rr(self, OP_LD, reg, target);
+          } else {
+            write_inst_ra(self, OP_LD, reg, adr(locate(self, def, ADR_NULL)));
+          }
+          write_inst(self, OP_ST, value->reg, num(0), reg);
+        }
+      } else {
+        write_inst_ra(self, OP_ST, value->reg, adr(locate(self, def, ADR_NULL)));
+      }
+    }
+
+    forget_known(self, def);
+    expr_free(value);
+    mppl_unref(name_syntax);
+    break;
+  }
+
+  case MPPL_VAR_INDEXED: {
+    MpplIndexedVar *indexed_syntax = (MpplIndexedVar *) lhs_syntax;
+    MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
+    AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
+    const Def      *def            = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
+    Adr             label          = locate(self, def, ADR_NULL);
+
+    RegState state = reg_state(self);
+    Expr    *value = expr_new(self, rhs_syntax);
+    Expr    *index = expr_new(self, index_syntax);
+    int      index_first;
+
+    index_first = expr_assign_pair(value, index, reg_state_vacant(&state), 0, 0, &state);
+    write_pair(self, value, index, index_first, 0);
+    write_range_check(self, def, index);
+
+    write_inst(self, OP_ST, value->reg, adr(label), index->reg);
+    forget_known(self, def);
+
+    expr_free(value);
+    expr_free(index);
+    mppl_unref(name_syntax);
+    mppl_unref(index_syntax);
+    break;
+  }
+
+  default:
+    unreachable();
+  }
+
+  mppl_unref(lhs_syntax);
+  mppl_unref(rhs_syntax);
+
+  return ADR_NULL;
+}
+
+/* jump to `false_block` unless `syntax` holds. a folded condition leaves
+   a jump or nothing, and the blocks it skips are dropped by `layout` */
+static void write_cond(Generator *self, const AnyMpplExpr *syntax, Adr false_block)
+{
+  long value;
+  if (ctx_folded(self->ctx, (const SyntaxTree *) syntax, &value)) {
+    if (!value) {
+      write_inst_a(self, OP_JUMP, adr(false_block));
+    }
+  } else {
+    Reg reg = write_expr(self, syntax, ADR_NULL);
+    write_inst_ra(self, OP_CPA, reg, lit(1));
+    write_inst_a(self, OP_JNZ, adr(false_block));
+  }
+}
+
+static Adr write_if_stmt(Generator *self, const MpplIfStmt *syntax, Adr sink)
+{
+  AnyMpplExpr *cond_syntax = mppl_if_stmt__cond(syntax);
+  AnyMpplStmt *then_syntax = mppl_if_stmt__then_stmt(syntax);
+  AnyMpplStmt *else_syntax = mppl_if_stmt__else_stmt(syntax);
+  Adr          next_block  = sink ? sink : self->label_count++;
+  Adr          false_block = else_syntax ? self->label_count++ : next_block;
+
+  write_cond(self, cond_syntax, false_block);
+  write_stmt(self, then_syntax, ADR_NULL, ADR_NULL);
+
+  if (else_syntax) {
+    write_inst_a(self, OP_JUMP, adr(next_block));
+    write_label(self, false_block);
+    write_stmt(self, else_syntax, false_block, next_block);
+  }
+
+  if (!sink) {
+    write_label(self, next_block);
+  }
+
+  mppl_unref(cond_syntax);
+  mppl_unref(then_syntax);
+  mppl_unref(else_syntax);
+
+  return next_block;
+}
+
+static Adr write_while_stmt(Generator *self, const MpplWhileStmt *syntax, Adr source, Adr sink)
+{
+  AnyMpplExpr *cond_syntax          = mppl_while_stmt__cond(syntax);
   AnyMpplStmt *do_syntax            = mppl_while_stmt__do_stmt(syntax);
   Adr          cond_block           = source ? source : self->label_count++;
   Adr          next_block           = sink ? sink : self->label_count++;
   Adr          previous_break_label = self->break_label;
-  Reg          reg;
 
-  self->break_label = next_block;
+  self->break_label = next_block;
+
+  write_label(self, cond_block);
+  ++self->loop_depth;
+  write_cond(self, cond_syntax, next_block);
+  write_stmt(self, do_syntax, ADR_NULL, ADR_NULL);
+  write_inst_a(self, OP_JUMP, adr(cond_block));
+  --self->loop_depth;
+
+  if (!sink) {
+    write_label(self, next_block);
+  }
+
+  self->break_label = previous_break_label;
+
+  mppl_unref(cond_syntax);
+  mppl_unref(do_syntax);
+
+  return next_block;
+}
+
+static Adr write_comp_stmt(Generator *self, const MpplCompStmt *syntax, Adr source, Adr sink)
+{
+  unsigned long i;
+
+  Adr current = source;
+
+  for (i = 0; i < mppl_comp_stmt__stmt_count(syntax); ++i) {
+    AnyMpplStmt *stmt = mppl_comp_stmt__stmt(syntax, i);
+
+    if (stmt) {
+      Adr next = i + 1 < mppl_comp_stmt__stmt_count(syntax) ? ADR_NULL : sink;
+      current  = write_stmt(self, stmt, current, next);
+    }
+    mppl_unref(stmt);
+  }
+
+  return current;
+}
+
+static Adr write_call_stmt(Generator *self, const MpplCallStmt *syntax)
+{
+  long              i;
+  MpplToken        *name   = mppl_call_stmt__name(syntax);
+  MpplActParamList *params = mppl_call_stmt__act_param_list(syntax);
+  const Def        *def    = ctx_resolve(self->ctx, (const SyntaxTree *) name, NULL);
+  Adr               label  = locate(self, def, ADR_NULL);
+  unsigned long     call   = call_begin(self);
+  unsigned long     clobber;
+
+  if (params) {
+    for (i = mppl_act_param_list__expr_count(params) - 1; i >= 0; --i) {
+      AnyMpplExpr *expr_syntax = mppl_act_param_list__expr(params, i);
+
+      if (mppl_expr__kind(expr_syntax) == MPPL_EXPR_VAR) {
+        const AnyMpplVar *var_syntax = (AnyMpplVar *) expr_syntax;
+        switch (mppl_var__kind(var_syntax)) {
+        case MPPL_VAR_ENTIRE: {
+          MpplEntireVar *entire_syntax = (MpplEntireVar *) var_syntax;
+          MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
+          const Def     *def           = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
+
+          if (def_kind(def) == DEF_PARAM) {
+            Reg reg = promoted(self, def);
+            if (reg == REG_NONE) {
+              write_inst_ra(self, OP_LD, GR1, adr(locate(self, def, ADR_NULL)));
+              write_inst(self, OP_PUSH, REG_NONE, num(0), GR1);
+            } else if (self->planning) {
+              write_inst_rr(self, OP_LD, GR1, reg);
+              write_inst(self, OP_PUSH, REG_NONE, num(0), GR1);
+            } else {
+              write_inst(self, OP_PUSH, REG_NONE, num(0), reg);
+            }
+          } else {
+            pin(self, def);
+            write_inst_a(self, OP_PUSH, adr(locate(self, def, ADR_NULL)));
+          }
+
+          mppl_unref(name_syntax);
+          break;
+        }
+
+        case MPPL_VAR_INDEXED: {
+          MpplIndexedVar *indexed_syntax = (MpplIndexedVar *) var_syntax;
+          MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
+          AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
+          const Def      *def            = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
+          Adr             label          = locate(self, def, ADR_NULL);
+
+          Reg index = write_checked_index(self, def, index_syntax);
+          write_inst(self, OP_PUSH, REG_NONE, adr(label), index);
+
+          mppl_unref(name_syntax);
+          mppl_unref(index_syntax);
+          break;
+        }
+
+        default:
+          unreachable();
+        }
+      } else {
+        RegState state = reg_state(self);
+        Expr    *expr  = expr_new(self, expr_syntax);
+        Reg      tmp;
+
+        expr_assign_reg(expr, reg_state_vacant(&state), 0, &state);
+        tmp = reg_state_vacant(&state);
+
+        write_expr_core(self, expr, ADR_NULL);
+        write_inst_ra(self, OP_LAD, tmp, lit(0));
+        write_inst(self, OP_ST, expr->reg, num(0), tmp);
+        write_inst(self, OP_PUSH, REG_NONE, num(0), tmp);
+
+        expr_free(expr);
+      }
+
+      mppl_unref(expr_syntax);
+    }
+  }
+
+  {
+    DefMapIndex index;
+    clobber = def_map_entry(&self->clobbers, def, &index) ? def_map_value(&self->clobbers, &index) : REG_ALL;
+  }
+  write_call(self, call, adr(label), clobber);
+  forget_known(self, NULL);
+
+  mppl_unref(name);
+  mppl_unref(params);
+  return ADR_NULL;
+}
+
+static Adr write_input_stmt(Generator *self, const MpplInputStmt *syntax)
+{
+  unsigned long  i;
+  MpplToken     *read_syntax       = mppl_input_stmt__read_token(syntax);
+  MpplInputList *input_list_syntax = mppl_input_stmt__input_list(syntax);
+
+  if (input_list_syntax) {
+    for (i = 0; i < mppl_input_list__var_count(input_list_syntax); ++i) {
+      AnyMpplVar *var_syntax = mppl_input_list__var(input_list_syntax, i);
+      const Type *type       = ctx_type_of(self->ctx, (const SyntaxTree *) var_syntax, NULL);
+
+      switch (mppl_var__kind(var_syntax)) {
+      case MPPL_VAR_ENTIRE: {
+        MpplEntireVar *entire_syntax = (MpplEntireVar *) var_syntax;
+        MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
+        const Def     *def           = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
+
+        switch (def_kind(def)) {
+        case DEF_PARAM: {
+          Reg reg = promoted(self, def);
+          if (reg != REG_NONE) {
+            write_inst_rr(self, OP_LD, GR1, reg);
+          } else {
+            write_inst_ra(self, OP_LD, GR1, adr(locate(self, def, ADR_NULL)));
+          }
+          break;
+        }
+
+        case DEF_VAR:
+        case DEF_LOCAL:
+          pin(self, def);
+          write_inst_ra(self, OP_LAD, GR1, adr(locate(self, def, ADR_NULL)));
+          break;
+
+        default:
+          unreachable();
+        }
+
+        mppl_unref(name_syntax);
+        break;
+      }
+
+      case MPPL_VAR_INDEXED: {
+        MpplIndexedVar *indexed_syntax = (MpplIndexedVar *) var_syntax;
+        MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
+        AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
+        const Def      *def            = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
+        Adr             label          = locate(self, def, ADR_NULL);
+
+        Reg index = write_checked_index(self, def, index_syntax);
+        write_inst(self, OP_LAD, GR1, adr(label), index);
+
+        mppl_unref(name_syntax);
+        mppl_unref(index_syntax);
+        break;
+      }
+      }
+
+      switch (type_kind(type)) {
+      case TYPE_CHAR:
+        write_builtin_call(self, "RCHAR", CLOBBER_READ_CHAR);
+        self->builtin_read_char = 1;
+        break;
+
+      case TYPE_INTEGER:
+        write_builtin_call(self, "RINT", CLOBBER_READ_INTEGER);
+        self->builtin_read_integer = 1;
+        break;
+
+      default:
+        unreachable();
+      }
+      forget_known(self, NULL);
+      mppl_unref(var_syntax);
+    }
+  }
+
+  if (syntax_tree_kind((const SyntaxTree *) read_syntax) == SYNTAX_READLN_KW) {
+    write_builtin_call(self, "RLINE", CLOBBER_READ_LINE);
+    self->builtin_read_line = 1;
+  }
+
+  mppl_unref(read_syntax);
+  mppl_unref(input_list_syntax);
+  return ADR_NULL;
+}
+
+static Adr write_output_stmt(Generator *self, const MpplOutputStmt *syntax)
+{
+  unsigned long i;
+  MpplToken    *write_syntax       = mppl_output_stmt__write_token(syntax);
+  MpplOutList  *output_list_syntax = mppl_output_stmt__output_list(syntax);
+
+  if (output_list_syntax) {
+    for (i = 0; i < mppl_out_list__out_value_count(output_list_syntax); ++i) {
+      MpplOutValue  *out_value_syntax = mppl_out_list__out_value(output_list_syntax, i);
+      AnyMpplExpr   *expr_syntax      = mppl_out_value__expr(out_value_syntax);
+      MpplNumberLit *width_syntax     = mppl_out_value__width(out_value_syntax);
+      const Type    *type             = ctx_type_of(self->ctx, (const SyntaxTree *) expr_syntax, NULL);
+
+      if (type_kind(type) == TYPE_STRING) {
+        const MpplStringLit  *string_syntax = (MpplStringLit *) expr_syntax;
+        const RawSyntaxToken *token         = (const RawSyntaxToken *) syntax_tree_raw((const SyntaxTree *) string_syntax);
+        Operand               string        = operand(OPERAND_STRING, 0);
+
+        string.text = xmalloc(string_length(token->string) + 2);
+        sprintf(string.text, "=%s", string_data(token->string));
+
+        write_inst_ra(self, OP_LAD, GR1, string);
+        write_inst_ra(self, OP_LAD, GR2, num(0));
+        write_builtin_call(self, "WSTR", CLOBBER_WRITE_STRING);
+        self->builtin_write_string = 1;
+      } else {
+        Expr    *value_expr = expr_new(self, expr_syntax);
+        Expr    *width_expr = width_syntax ? lit_expr_new(ctx_type(TYPE_INTEGER), mppl_lit_number__to_long(width_syntax)) : NULL;
+        RegState state      = reg_state(self);
+
+        expr_assign_reg(value_expr, GR1, 1, &state);
+        if (width_expr) {
+          expr_assign_reg(width_expr, GR2, 1, &state);
+        }
+        reg_state_release(&state, GR1);
+        reg_state_release(&state, GR2);
+
+        write_expr_core(self, value_expr, ADR_NULL);
+        if (width_expr) {
+          write_expr_core(self, width_expr, ADR_NULL);
+        } else {
+          write_inst_ra(self, OP_LAD, GR2, num(0));
+        }
+
+        switch (type_kind(type)) {
+        case TYPE_CHAR:
+          write_builtin_call(self, "WCHAR", CLOBBER_WRITE_CHAR);
+          self->builtin_write_char = 1;
+          break;
+
+        case TYPE_INTEGER:
+          write_builtin_call(self, "WINT", CLOBBER_WRITE_INTEGER);
+          self->builtin_write_integer = 1;
+          break;
+
+        case TYPE_BOOLEAN:
+          write_builtin_call(self, "WBOOL", CLOBBER_WRITE_BOOLEAN);
+          self->builtin_write_boolean = 1;
+          break;
 
-  write_label(self, cond_block);
-  reg = write_expr(self, cond_syntax, ADR_NULL);
-  write_inst2(self, "CPA", r(reg), "=1");
-  write_inst1(self, "JNZ", adr(next_block));
-  write_stmt(self, do_syntax, ADR_NULL, ADR_NULL);
-  write_inst1(self, "JUMP", adr(cond_block));
+        default:
+          unreachable();
+        }
 
-  if (!sink) {
-    write_label(self, next_block);
-  }
+        expr_free(value_expr);
+        expr_free(width_expr);
+      }
 
-  self->break_label = previous_break_label;
+      mppl_unref(expr_syntax);
+      mppl_unref(width_syntax);
+      mppl_unref(out_value_syntax);
+    }
+  }
 
-  mppl_unref(cond_syntax);
-  mppl_unref(do_syntax);
+  if (syntax_tree_kind((const SyntaxTree *) write_syntax) == SYNTAX_WRITELN_KW) {
+    write_builtin_call(self, "WLINE", CLOBBER_WRITE_NEWLINE);
+    self->builtin_write_newline = 1;
+  }
+  write_builtin_call(self, "FLUSH", CLOBBER_FLUSH);
+  self->builtin_flush = 1;
 
-  return next_block;
+  mppl_unref(write_syntax);
+  mppl_unref(output_list_syntax);
+  return ADR_NULL;
 }
 
-static Adr write_comp_stmt(Generator *self, const MpplCompStmt *syntax, Adr source, Adr sink)
+static Adr write_stmt(Generator *self, const AnyMpplStmt *syntax, Adr source, Adr sink)
 {
-  unsigned long i;
+  switch (mppl_stmt__kind(syntax)) {
+  case MPPL_STMT_ASSIGN:
+    return write_assign_stmt(self, (const MpplAssignStmt *) syntax);
 
-  Adr current = source;
+  case MPPL_STMT_IF:
+    return write_if_stmt(self, (const MpplIfStmt *) syntax, sink);
 
-  for (i = 0; i < mppl_comp_stmt__stmt_count(syntax); ++i) {
-    AnyMpplStmt *stmt = mppl_comp_stmt__stmt(syntax, i);
+  case MPPL_STMT_WHILE:
+    return write_while_stmt(self, (const MpplWhileStmt *) syntax, source, sink);
 
-    if (stmt) {
-      Adr next = i + 1 < mppl_comp_stmt__stmt_count(syntax) ? ADR_NULL : sink;
-      current  = write_stmt(self, stmt, current, next);
-    }
-    mppl_unref(stmt);
+  case MPPL_STMT_BREAK:
+    write_inst_a(self, OP_JUMP, adr(self->break_label));
+    return ADR_NULL;
+
+  case MPPL_STMT_CALL:
+    return write_call_stmt(self, (const MpplCallStmt *) syntax);
+
+  case MPPL_STMT_RETURN:
+    write_inst0(self, OP_RET);
+    return ADR_CALL;
+
+  case MPPL_STMT_INPUT:
+    return write_input_stmt(self, (const MpplInputStmt *) syntax);
+
+  case MPPL_STMT_OUTPUT:
+    return write_output_stmt(self, (const MpplOutputStmt *) syntax);
+
+  case MPPL_STMT_COMP:
+    return write_comp_stmt(self, (const MpplCompStmt *) syntax, source, sink);
+
+  default:
+    unreachable();
   }
+}
 
-  return current;
+static unsigned long frequency(unsigned long depth)
+{
+  return 1ul << 3 * (depth < 5 ? depth : 5);
 }
 
-static Adr write_call_stmt(Generator *self, const MpplCallStmt *syntax)
+static void inst_liveness(const Inst *inst, const long *bits, unsigned long *use, unsigned long *def)
 {
-  long              i;
-  MpplToken        *name   = mppl_call_stmt__name(syntax);
-  MpplActParamList *params = mppl_call_stmt__act_param_list(syntax);
-  const Def        *def    = ctx_resolve(self->ctx, (const SyntaxTree *) name, NULL);
-  Adr               label  = locate(self, def, ADR_NULL);
+  *use = 0;
+  *def = 0;
+  if (inst->x >= REG_VIRTUAL && bits[inst->x - REG_VIRTUAL] >= 0) {
+    *use |= 1ul << bits[inst->x - REG_VIRTUAL];
+  }
+  if (inst->r >= REG_VIRTUAL && bits[inst->r - REG_VIRTUAL] >= 0) {
+    if (op_reads_r(inst->op)) {
+      *use |= 1ul << bits[inst->r - REG_VIRTUAL];
+    }
+    if (op_writes_r(inst->op)) {
+      *def |= 1ul << bits[inst->r - REG_VIRTUAL];
+    }
+  }
+}
 
-  if (params) {
-    for (i = mppl_act_param_list__expr_count(params) - 1; i >= 0; --i) {
-      AnyMpplExpr *expr_syntax = mppl_act_param_list__expr(params, i);
+/* pick registers for the candidates of the body planned from instruction `start` on.
+
+   candidates are colored in order of their use counts weighted by loop depth.
+   two candidates interfere when both are live at some instruction. every
+   expression must keep as many free registers as it used in the planning pass,
+   and a candidate live across a call that clobbers its register costs a save
+   and a restore there. a parameter only holds its address, which is reloaded
+   from the parameter slot instead. on return `regions` and `calls` hold the
+   registers reserved by each expression and saved around each call, and
+   `reloads` the parameters to reload after each call */
+static void plan_promotion(Generator *self, unsigned long start, Adr labels)
+{
+  unsigned long  count      = inst_array_count(&self->insts) - start;
+  Inst          *insts      = inst_array_at(&self->insts, start);
+  unsigned long  candidates = candidate_array_count(&self->candidates);
+  unsigned long  regions    = mask_array_count(&self->regions);
+  unsigned long  calls      = mask_array_count(&self->calls);
+  unsigned long  label_span = self->label_count - labels;
+  long          *bits       = xmalloc(sizeof(long) * candidates);
+  long          *blocks_of  = xmalloc(sizeof(long) * (label_span + 1));
+  unsigned long *live_out   = xmalloc(sizeof(unsigned long) * (count + 1));
+  unsigned long *occupied   = xmalloc(sizeof(unsigned long) * (count + 1));
+  unsigned long *need       = xmalloc(sizeof(unsigned long) * (regions + 1));
+  unsigned long *held       = xmalloc(sizeof(unsigned long) * (regions + 1));
+  unsigned long *used       = xmalloc(sizeof(unsigned long) * (regions + 1));
+  long           order[PROMOTION_LIMIT];
+  unsigned long  interfere[PROMOTION_LIMIT];
+  Reg            assigned[PROMOTION_LIMIT];
+  unsigned long  selected = 0;
+  unsigned long  entry    = 0;
+  BlockArray     blocks;
+  unsigned long  i, j, k;
+
+  block_array_init(&blocks);
+
+  /* weigh the candidates and keep the heaviest ones */
+  for (i = 0; i < count; ++i) {
+    if (insts[i].r >= REG_VIRTUAL) {
+      candidate_array_at(&self->candidates, insts[i].r - REG_VIRTUAL)->weight += frequency(insts[i].depth);
+    }
+    if (insts[i].x >= REG_VIRTUAL) {
+      candidate_array_at(&self->candidates, insts[i].x - REG_VIRTUAL)->weight += frequency(insts[i].depth);
+    }
+  }
+  for (i = 0; i < candidates; ++i) {
+    bits[i] = -1;
+  }
+  while (selected < PROMOTION_LIMIT) {
+    long best = -1;
+    for (i = 0; i < candidates; ++i) {
+      Candidate *candidate = candidate_array_at(&self->candidates, i);
+      if (bits[i] < 0 && !candidate->pinned && candidate->weight > 0
+        && (best < 0 || candidate->weight > candidate_array_at(&self->candidates, best)->weight)) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    order[selected] = best;
+    bits[best]      = selected++;
+  }
 
-      if (mppl_expr__kind(expr_syntax) == MPPL_EXPR_VAR) {
-        const AnyMpplVar *var_syntax = (AnyMpplVar *) expr_syntax;
-        switch (mppl_var__kind(var_syntax)) {
-        case MPPL_VAR_ENTIRE: {
-          MpplEntireVar *entire_syntax = (MpplEntireVar *) var_syntax;
-          MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
-          const Def     *def           = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-          Adr            label         = locate(self, def, ADR_NULL);
+  /* split the body into basic blocks */
+  for (i = 0; i <= label_span; ++i) {
+    blocks_of[i] = -1;
+  }
+  for (i = 0; i < count; ++i) {
+    if (i == 0 || insts[i].label || op_is_jump(insts[i - 1].op) || insts[i - 1].op == OP_RET) {
+      Block block;
+      block.first   = i;
+      block.last    = i + 1;
+      block.next[0] = -1;
+      block.next[1] = -1;
+      block.use     = 0;
+      block.def     = 0;
+      block.in      = 0;
+      block.out     = 0;
+      block_array_push(&blocks, block);
+      if (insts[i].label >= labels && insts[i].label < self->label_count) {
+        blocks_of[insts[i].label - labels] = block_array_count(&blocks) - 1;
+      }
+    }
+    block_array_back(&blocks)->last = i + 1;
+  }
+  for (k = 0; k < block_array_count(&blocks); ++k) {
+    Block      *block = block_array_at(&blocks, k);
+    const Inst *last  = &insts[block->last - 1];
+    long        fall  = k + 1 < block_array_count(&blocks) ? (long) k + 1 : -1;
+    long        jump  = -1;
+
+    if (op_is_jump(last->op)) {
+      if (last->adr.kind == OPERAND_LABEL) {
+        jump = last->adr.value >= labels && last->adr.value < self->label_count ? blocks_of[last->adr.value - labels] : -2;
+      }
+      if (last->op == OP_JUMP) {
+        fall = -1;
+      }
+    } else if (last->op == OP_RET) {
+      fall = -1;
+    }
+    block->next[0] = fall;
+    block->next[1] = jump;
+    for (i = block->first; i < block->last; ++i) {
+      unsigned long use, def;
+      inst_liveness(&insts[i], bits, &use, &def);
+      block->use |= use & ~block->def;
+      block->def |= def;
+    }
+  }
 
-          if (def_kind(def) == DEF_PARAM) {
-            write_inst2(self, "LD", r(GR1), adr(label));
-            write_inst2(self, "PUSH", "0", r(GR1));
-          } else {
-            write_inst1(self, "PUSH", adr(label));
+  /* solve liveness over the blocks */
+  {
+    int changed = 1;
+    while (changed) {
+      changed = 0;
+      for (k = block_array_count(&blocks); k-- > 0;) {
+        Block        *block = block_array_at(&blocks, k);
+        unsigned long out   = 0;
+        unsigned long in;
+        for (j = 0; j < 2; ++j) {
+          if (block->next[j] == -2) {
+            out = -1ul;
+          } else if (block->next[j] >= 0) {
+            out |= block_array_at(&blocks, block->next[j])->in;
           }
-
-          mppl_unref(name_syntax);
-          break;
         }
+        in = block->use | (out & ~block->def);
+        if (in != block->in || out != block->out) {
+          block->in  = in;
+          block->out = out;
+          changed    = 1;
+        }
+      }
+    }
+  }
 
-        case MPPL_VAR_INDEXED: {
-          MpplIndexedVar *indexed_syntax = (MpplIndexedVar *) var_syntax;
-          MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
-          AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
-          const Def      *def            = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-          Adr             label          = locate(self, def, ADR_NULL);
+  /* walk every block backwards for the liveness at each instruction */
+  for (k = 0; k < block_array_count(&blocks); ++k) {
+    Block        *block = block_array_at(&blocks, k);
+    unsigned long live  = block->out;
+    for (i = block->last; i-- > block->first;) {
+      unsigned long use, def;
+      inst_liveness(&insts[i], bits, &use, &def);
+      live_out[i] = live;
+      occupied[i] = live | use | def;
+      live        = use | (live & ~def);
+    }
+    if (k == 0) {
+      entry = live;
+    }
+  }
 
-          Reg index = write_expr(self, index_syntax, ADR_NULL);
-          write_inst2(self, "PUSH", adr(label), x(index));
+  /* a variable read before it is written keeps the value it had in memory */
+  for (j = 0; j < selected; ++j) {
+    interfere[j] = 0;
+    assigned[j]  = REG_NONE;
+  }
+  for (i = 0; i < count; ++i) {
+    occupied[i] &= ~entry;
+    for (j = 0; j < selected; ++j) {
+      if (occupied[i] & (1ul << j)) {
+        interfere[j] |= occupied[i];
+      }
+    }
+  }
 
-          mppl_unref(name_syntax);
-          mppl_unref(index_syntax);
+  /* count the registers each expression used and the candidates live in it */
+  for (k = 0; k < regions; ++k) {
+    unsigned long first = *mask_array_at(&self->regions, k) - start;
+    unsigned long last  = k + 1 < regions ? *mask_array_at(&self->regions, k + 1) - start : count;
+    unsigned long regs  = 0;
+    need[k]             = 0;
+    held[k]             = 0;
+    used[k]             = 0;
+    for (i = first; i < last; ++i) {
+      if (insts[i].r > GR0 && insts[i].r < REG_VIRTUAL) {
+        regs |= REG_BIT(insts[i].r);
+      }
+      if (insts[i].x > GR0 && insts[i].x < REG_VIRTUAL) {
+        regs |= REG_BIT(insts[i].x);
+      }
+      held[k] |= occupied[i];
+    }
+    need[k] = popcount(&regs, sizeof(regs));
+  }
+
+  for (j = 0; j < selected; ++j) {
+    Candidate    *candidate = candidate_array_at(&self->candidates, order[j]);
+    unsigned long best_cost = candidate->weight;
+    Reg           best      = REG_NONE;
+    int           fits      = !(entry & (1ul << j));
+    int           param     = def_kind(candidate->def) == DEF_PARAM;
+    Reg           reg;
+
+    for (k = 0; k < regions && fits; ++k) {
+      if ((held[k] & (1ul << j)) && used[k] + need[k] >= 7) {
+        fits = 0;
+      }
+    }
+    for (reg = GR3; reg <= GR7 && fits; ++reg) {
+      unsigned long cost = 0;
+      for (i = 0; i < j; ++i) {
+        if (assigned[i] == reg && (interfere[j] & (1ul << i))) {
           break;
         }
+      }
+      if (i < j) {
+        continue;
+      }
+      for (k = 0; k < calls; ++k) {
+        unsigned long call = *mask_array_at(&self->calls, k) - start;
+        if ((live_out[call] & (1ul << j)) && (*mask_array_at(&self->call_clobbers, k) & REG_BIT(reg))) {
+          cost += (param ? 1 : 2) * frequency(insts[call].depth);
+        }
+      }
+      if (param && cost) {
+        cost += 1; /* storing the address in the prologue */
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        best      = reg;
+      }
+    }
 
-        default:
-          unreachable();
+    assigned[j] = best;
+    if (best != REG_NONE) {
+      for (k = 0; k < regions; ++k) {
+        if (held[k] & (1ul << j)) {
+          ++used[k];
         }
+      }
+    }
+  }
+
+  /* publish the assignment for the second pass */
+  for (i = 0; i < candidates; ++i) {
+    candidate_array_at(&self->candidates, i)->reg = bits[i] >= 0 ? assigned[bits[i]] : REG_NONE;
+  }
+  for (k = 0; k < regions; ++k) {
+    unsigned long reserved = 0;
+    for (j = 0; j < selected; ++j) {
+      if ((held[k] & (1ul << j)) && assigned[j] != REG_NONE) {
+        reserved |= REG_BIT(assigned[j]);
+      }
+    }
+    *mask_array_at(&self->regions, k) = reserved;
+  }
+  for (k = 0; k < calls; ++k) {
+    unsigned long call    = *mask_array_at(&self->calls, k) - start;
+    unsigned long clobber = *mask_array_at(&self->call_clobbers, k);
+    unsigned long saves   = 0;
+    for (j = 0; j < selected; ++j) {
+      Candidate *candidate = candidate_array_at(&self->candidates, order[j]);
+      if (!(live_out[call] & (1ul << j)) || assigned[j] == REG_NONE || !(clobber & REG_BIT(assigned[j]))) {
+        continue;
+      }
+      if (def_kind(candidate->def) == DEF_PARAM) {
+        Reload reload;
+        reload.call      = k;
+        reload.reg       = assigned[j];
+        reload.def       = candidate->def;
+        candidate->remat = 1;
+        reload_array_push(&self->reloads, reload);
       } else {
-        RegState state = reg_state();
-        Expr    *expr  = expr_new(self->ctx, expr_syntax);
-        Reg      reg, tmp;
+        saves |= REG_BIT(assigned[j]);
+      }
+    }
+    *mask_array_at(&self->calls, k) = saves;
+  }
+
+  block_array_deinit(&blocks);
+  free(bits);
+  free(blocks_of);
+  free(live_out);
+  free(occupied);
+  free(need);
+  free(held);
+  free(used);
+}
+
+/* state of one pass of `peephole` over the instructions of a body */
+typedef struct Peephole Peephole;
+
+struct Peephole {
+  Inst          *insts;
+  unsigned long  count;
+  char          *removed;
+  long          *targets;
+  Adr            labels;
+  Adr            label_end;
+};
+
+static int operand_equal(const Operand *left, const Operand *right)
+{
+  if (left->kind != right->kind || left->value != right->value) {
+    return 0;
+  }
+  return (left->kind != OPERAND_NAME && left->kind != OPERAND_STRING) || strcmp(left->text, right->text) == 0;
+}
+
+static unsigned long peephole_next(const Peephole *self, unsigned long i)
+{
+  do {
+    ++i;
+  } while (i < self->count && self->removed[i]);
+  return i;
+}
+
+static long peephole_target(const Peephole *self, const Inst *inst)
+{
+  if (inst->adr.kind == OPERAND_LABEL && inst->adr.value >= self->labels && inst->adr.value < self->label_end) {
+    return self->targets[inst->adr.value - self->labels];
+  } else {
+    return -1;
+  }
+}
+
+/* nonzero if the flags are overwritten before anything reads them on every path
+   from instruction `i`. unconditional jumps are followed for a few steps */
+static int peephole_flags_dead(const Peephole *self, unsigned long i)
+{
+  unsigned long steps;
+  for (steps = 0; steps < 16 && i < self->count; ++steps) {
+    const Inst *inst = &self->insts[i];
+    if (self->removed[i]) {
+      ++i;
+      continue;
+    }
+    switch (inst->op) {
+    case OP_LD:
+    case OP_ADDA:
+    case OP_SUBA:
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+    case OP_CPA:
+    case OP_CPL:
+      return 1;
+
+    case OP_ST:
+    case OP_LAD:
+    case OP_PUSH:
+    case OP_POP:
+    case OP_NOP:
+      ++i;
+      break;
+
+    case OP_JUMP: {
+      long target = peephole_target(self, inst);
+      if (target < 0) {
+        return 0;
+      }
+      i = target;
+      break;
+    }
+
+    default:
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/* a PUSH whose register is popped back untouched, with nothing in between that
+   jumps, is entered from elsewhere, or uses the stack. returns the POP or `count` */
+static unsigned long peephole_push_pop(const Peephole *self, unsigned long i)
+{
+  Reg           reg = self->insts[i].x;
+  unsigned long j;
+  for (j = peephole_next(self, i); j < self->count; j = peephole_next(self, j)) {
+    const Inst *inst = &self->insts[j];
+    if (inst->label || op_is_jump(inst->op) || inst->op == OP_CALL || inst->op == OP_RET || inst->op == OP_PUSH) {
+      break;
+    } else if (inst->op == OP_POP) {
+      return inst->r == reg ? j : self->count;
+    } else if (op_writes_r(inst->op) && inst->r == reg) {
+      break;
+    }
+  }
+  return self->count;
+}
+
+static Inst peephole_nop(const Inst *inst, Adr label)
+{
+  Inst nop  = *inst;
+  nop.label = label;
+  nop.op    = OP_NOP;
+  nop.r     = REG_NONE;
+  nop.x     = REG_NONE;
+  nop.adr   = none();
+  return nop;
+}
+
+/* a LD reading back what the ST at `i` wrote, with neither the value, its index, nor
+   the memory changed in between. only stores to other plain labels are crossed,
+   as a store through a register may hit any address. returns the LD or `count` */
+static unsigned long peephole_reload(const Peephole *self, unsigned long i)
+{
+  const Inst   *store = &self->insts[i];
+  unsigned long steps = 0;
+  unsigned long j;
+  for (j = peephole_next(self, i); j < self->count && steps < 8; j = peephole_next(self, j), ++steps) {
+    const Inst *inst = &self->insts[j];
+    if (inst->label || op_is_jump(inst->op) || inst->op == OP_CALL || inst->op == OP_RET) {
+      break;
+    } else if (inst->op == OP_LD && inst->x == store->x && operand_equal(&inst->adr, &store->adr)) {
+      return j;
+    } else if (op_writes_r(inst->op) && (inst->r == store->r || (store->x != REG_NONE && inst->r == store->x))) {
+      break;
+    } else if (inst->op == OP_ST && (inst->x != REG_NONE || operand_equal(&inst->adr, &store->adr))) {
+      break;
+    }
+  }
+  return self->count;
+}
+
+static int peephole_pass(Peephole *self)
+{
+  int           changed = 0;
+  unsigned long i, j;
+
+  for (i = 0; i < self->count; ++i) {
+    Inst *inst = &self->insts[i];
+    if (self->removed[i]) {
+      continue;
+    }
+    j = peephole_next(self, i);
+
+    if (inst->op == OP_ST) {
+      /* ST r, X followed by LD r', X */
+      unsigned long load = peephole_reload(self, i);
+      if (load < self->count) {
+        Inst *next = &self->insts[load];
+        if (next->r != inst->r) {
+          next->adr = none();
+          next->x   = inst->r;
+          changed   = 1;
+        } else if (peephole_flags_dead(self, peephole_next(self, load))) {
+          self->removed[load] = 1;
+          changed             = 1;
+        }
+      }
+    } else if (inst->op == OP_LD && inst->adr.kind == OPERAND_NONE && inst->x == inst->r) {
+      /* LD r, r */
+      if (peephole_flags_dead(self, j)) {
+        self->removed[i] = 1;
+        changed = 1;
+      }
+    } else if (inst->op == OP_PUSH && inst->adr.kind == OPERAND_NUMBER && inst->adr.value == 0 && inst->x != REG_NONE) {
+      unsigned long pop = peephole_push_pop(self, i);
+      if (pop < self->count) {
+        self->removed[i] = 1;
+        self->removed[pop] = 1;
+        changed = 1;
+      }
+    } else if (op_is_jump(inst->op) && inst->adr.kind == OPERAND_LABEL) {
+      /* a jump to the instruction right after it, possibly behind labeled NOPs */
+      while (j < self->count && self->insts[j].label != inst->adr.value && self->insts[j].op == OP_NOP) {
+        j = peephole_next(self, j);
+      }
+      if (j < self->count && self->insts[j].label == inst->adr.value) {
+        self->removed[i] = 1;
+        changed = 1;
+      }
+    } else if (inst->op == OP_LAD && inst->adr.kind == OPERAND_NUMBER && inst->adr.value == 0 && inst->x == REG_NONE) {
+      /* XOR r, r is one word shorter but sets the flags */
+      if (peephole_flags_dead(self, j)) {
+        inst->op  = OP_XOR;
+        inst->adr = none();
+        inst->x   = inst->r;
+        changed   = 1;
+      }
+    }
+  }
+  return changed;
+}
+
+/* clean up the instructions of a body generated from `start` on, whose local labels
+   are numbered from `labels` on */
+static void peephole(Generator *self, unsigned long start, Adr labels)
+{
+  Peephole      pass;
+  unsigned long span = self->label_count - labels;
+  int           changed;
+
+  pass.labels    = labels;
+  pass.label_end = self->label_count;
+  pass.targets   = xmalloc(sizeof(long) * (span + 1));
+  do {
+    unsigned long i, out;
+    Adr           pending = ADR_NULL;
+
+    pass.insts   = inst_array_at(&self->insts, start);
+    pass.count   = inst_array_count(&self->insts) - start;
+    pass.removed = xmalloc(sizeof(char) * (pass.count + 1));
+    for (i = 0; i <= span; ++i) {
+      pass.targets[i] = -1;
+    }
+    for (i = 0; i < pass.count; ++i) {
+      pass.removed[i] = 0;
+      if (pass.insts[i].label >= labels && pass.insts[i].label < pass.label_end) {
+        pass.targets[pass.insts[i].label - labels] = i;
+      }
+    }
+    changed = peephole_pass(&pass);
+
+    /* compact the list, moving the labels of removed instructions onto the next one */
+    for (i = 0, out = 0; i < pass.count; ++i) {
+      Inst inst = pass.insts[i];
+      if (pass.removed[i]) {
+        if (inst.label) {
+          if (pending) {
+            pass.insts[out++] = peephole_nop(&inst, pending);
+          }
+          pending = inst.label;
+        }
+        continue;
+      }
+      if (pending) {
+        if (inst.label) {
+          pass.insts[out++] = peephole_nop(&inst, pending);
+        } else {
+          inst.label = pending;
+        }
+        pending = ADR_NULL;
+      }
+      pass.insts[out++] = inst;
+    }
+    self->insts.count = start + out;
+    if (pending) {
+      write_pending_label(self, pending);
+    }
+    free(pass.removed);
+  } while (changed);
+  free(pass.targets);
+}
+
+/* a basic block of a body being laid out. `last` is the jump or RET ending it, or
+   one past its end if it falls through, and `next` holds the blocks reached by
+   falling through and by the jump, or -1. `succ` and `pred` link the blocks that
+   are placed back to back. an `empty` block holds nothing but NOPs and goes on to
+   its only successor */
+typedef struct Node Node;
+
+struct Node {
+  unsigned long first;
+  unsigned long last;
+  Adr           label;
+  Op            op;
+  long          next[2];
+  long          succ;
+  long          pred;
+  unsigned long depth;
+  int           empty;
+  int           reachable;
+};
+
+/* a chance for `from` to fall into `to` instead of jumping there. edges of a lower
+   group are taken first, then the heavier ones */
+typedef struct Edge Edge;
+
+struct Edge {
+  long          from;
+  long          to;
+  int           group;
+  int           jump;
+  unsigned long weight;
+};
+
+DEFINE_ARRAY(NodeArray, node_array, Node)
+DEFINE_ARRAY(EdgeArray, edge_array, Edge)
+
+static int compare_edges(const void *left, const void *right)
+{
+  const Edge *left_edge  = left;
+  const Edge *right_edge = right;
+
+  if (left_edge->group != right_edge->group) {
+    return left_edge->group < right_edge->group ? -1 : 1;
+  } else if (left_edge->weight != right_edge->weight) {
+    return left_edge->weight > right_edge->weight ? -1 : 1;
+  } else if (left_edge->jump != right_edge->jump) {
+    return left_edge->jump < right_edge->jump ? -1 : 1;
+  } else if (left_edge->from != right_edge->from) {
+    return left_edge->from < right_edge->from ? -1 : 1;
+  } else {
+    return 0;
+  }
+}
 
-        reg = reg_state_vacant(&state);
-        expr_assign_reg(expr, reg, &state);
-        tmp = reg_state_vacant(&state);
+/* the conditional jump taken exactly when `op` is not, or OP_NOP if there is none */
+static Op invert_jump(Op op)
+{
+  switch (op) {
+  case OP_JNZ:
+    return OP_JZE;
 
-        write_expr_core(self, expr, ADR_NULL);
-        write_inst2(self, "LAD", r(tmp), "=0");
-        write_inst3(self, "ST", r(reg), "0", x(tmp));
-        write_inst2(self, "PUSH", "0", x(tmp));
+  case OP_JZE:
+    return OP_JNZ;
 
-        expr_free(expr);
-      }
+  default:
+    return OP_NOP;
+  }
+}
 
-      mppl_unref(expr_syntax);
+/* the block reached from `node` once the empty blocks on the way are skipped */
+static long layout_resolve(const NodeArray *nodes, long node)
+{
+  unsigned long steps;
+  for (steps = 0; node >= 0 && steps < node_array_count(nodes); ++steps) {
+    const Node *block = node_array_at(nodes, node);
+    if (!block->empty) {
+      break;
     }
+    node = block->next[block->op == OP_JUMP];
   }
-  write_inst1(self, "CALL", adr(label));
-
-  mppl_unref(name);
-  mppl_unref(params);
-  return ADR_NULL;
+  return node;
 }
 
-static Adr write_input_stmt(Generator *self, const MpplInputStmt *syntax)
+/* nonzero if `node` holds nothing but NOPs and a RET */
+static int layout_returns(const Node *node, const Inst *insts)
 {
-  unsigned long  i;
-  MpplToken     *read_syntax       = mppl_input_stmt__read_token(syntax);
-  MpplInputList *input_list_syntax = mppl_input_stmt__input_list(syntax);
+  unsigned long i;
+  if (node->op != OP_RET) {
+    return 0;
+  }
+  for (i = node->first; i < node->last; ++i) {
+    if (insts[i].op != OP_NOP) {
+      return 0;
+    }
+  }
+  return 1;
+}
 
-  if (input_list_syntax) {
-    for (i = 0; i < mppl_input_list__var_count(input_list_syntax); ++i) {
-      AnyMpplVar *var_syntax = mppl_input_list__var(input_list_syntax, i);
-      const Type *type       = ctx_type_of(self->ctx, (const SyntaxTree *) var_syntax, NULL);
+static Adr layout_label(Generator *self, Node *node)
+{
+  if (!node->label) {
+    node->label = self->label_count++;
+  }
+  return node->label;
+}
 
-      switch (mppl_var__kind(var_syntax)) {
-      case MPPL_VAR_ENTIRE: {
-        MpplEntireVar *entire_syntax = (MpplEntireVar *) var_syntax;
-        MpplToken     *name_syntax   = mppl_entire_var__name(entire_syntax);
-        const Def     *def           = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-        Adr            label         = locate(self, def, ADR_NULL);
+/* write to `exit` the instructions ending `node` when `next` is placed right after it,
+   and return how many there are */
+static unsigned long layout_exit(Generator *self, NodeArray *nodes, const Inst *insts, long node, long next, Inst *exit)
+{
+  Node         *block = node_array_at(nodes, node);
+  long          fall  = block->next[0];
+  long          jump  = block->next[1];
+  unsigned long count = 0;
+  Inst          inst;
+
+  inst.label = ADR_NULL;
+  inst.op    = OP_JUMP;
+  inst.r     = REG_NONE;
+  inst.x     = REG_NONE;
+  inst.adr   = none();
+  inst.depth = block->depth;
+
+  if (block->op == OP_RET) {
+    inst.op       = OP_RET;
+    exit[count++] = inst;
+  } else if (block->op == OP_JUMP && jump < 0) {
+    exit[count]       = insts[block->last];
+    exit[count].label = ADR_NULL;
+    ++count;
+  } else if (block->op == OP_JUMP) {
+    if (jump != next) {
+      inst.adr      = adr(layout_label(self, node_array_at(nodes, jump)));
+      exit[count++] = inst;
+    }
+  } else if (block->op != OP_NOP) {
+    Op inverse = invert_jump(block->op);
+    if (fall != next && jump >= 0 && jump == next && inverse != OP_NOP) {
+      inst.op       = inverse;
+      inst.adr      = adr(layout_label(self, node_array_at(nodes, fall)));
+      exit[count++] = inst;
+    } else {
+      exit[count]       = insts[block->last];
+      exit[count].label = ADR_NULL;
+      if (jump >= 0) {
+        exit[count].adr = adr(layout_label(self, node_array_at(nodes, jump)));
+      }
+      ++count;
+      if (fall >= 0 && fall != next) {
+        inst.adr      = adr(layout_label(self, node_array_at(nodes, fall)));
+        exit[count++] = inst;
+      }
+    }
+  } else if (fall >= 0 && fall != next) {
+    inst.adr      = adr(layout_label(self, node_array_at(nodes, fall)));
+    exit[count++] = inst;
+  }
+  return count;
+}
 
-        switch (def_kind(def)) {
-        case DEF_PARAM:
-          write_inst2(self, "LD", r(GR1), adr(label));
-          break;
+static void layout_push(InstArray *insts, Adr *pending, Inst inst)
+{
+  if (*pending) {
+    if (inst.label) {
+      inst_array_push(insts, peephole_nop(&inst, *pending));
+    } else {
+      inst.label = *pending;
+    }
+    *pending = ADR_NULL;
+  }
+  inst_array_push(insts, inst);
+}
 
-        case DEF_VAR:
-        case DEF_LOCAL:
-          write_inst2(self, "LAD", r(GR1), adr(label));
+/* rearrange the blocks of the body generated from instruction `start` on, whose local
+   labels are numbered from `labels` on. jumps to blocks that only jump on are threaded,
+   blocks no longer reached are dropped, and the rest are chained up so that as many
+   jumps as possible turn into fallthroughs, the ones in deeper loops first */
+static void layout(Generator *self, unsigned long start, Adr labels)
+{
+  unsigned long count      = inst_array_count(&self->insts) - start;
+  Inst         *insts      = inst_array_at(&self->insts, start);
+  Adr           label_end  = self->label_count;
+  long         *blocks_of  = xmalloc(sizeof(long) * (label_end - labels + 1));
+  long         *stack      = NULL;
+  unsigned long stack_size = 0;
+  Adr           pending    = ADR_NULL;
+  int           ended      = 1;
+  NodeArray     nodes;
+  EdgeArray     edges;
+  MaskArray     order;
+  InstArray     out;
+  unsigned long i, k;
+
+  node_array_init(&nodes);
+  edge_array_init(&edges);
+  mask_array_init(&order);
+  inst_array_init(&out);
+
+  /* split the body into basic blocks */
+  for (i = 0; i <= label_end - labels; ++i) {
+    blocks_of[i] = -1;
+  }
+  for (i = 0; i < count; ++i) {
+    const Inst *inst     = &insts[i];
+    int         internal = inst->adr.kind == OPERAND_LABEL && inst->adr.value >= labels && inst->adr.value < label_end;
+    Node       *node;
+
+    if (ended || inst->label) {
+      Node block;
+      block.first     = i;
+      block.last      = i;
+      block.label     = inst->label;
+      block.op        = OP_NOP;
+      block.next[0]   = -1;
+      block.next[1]   = -1;
+      block.succ      = -1;
+      block.pred      = -1;
+      block.depth     = inst->depth;
+      block.empty     = 0;
+      block.reachable = 0;
+      node_array_push(&nodes, block);
+      if (inst->label >= labels && inst->label < label_end) {
+        blocks_of[inst->label - labels] = node_array_count(&nodes) - 1;
+      }
+    }
+    node  = node_array_back(&nodes);
+    ended = inst->op == OP_RET || inst->op == OP_JUMP || (op_is_jump(inst->op) && internal);
+    if (ended) {
+      node->last = i;
+      node->op   = inst->op;
+    } else {
+      node->last = i + 1;
+    }
+  }
+  for (k = 0; k < node_array_count(&nodes); ++k) {
+    Node *node = node_array_at(&nodes, k);
+    if (op_is_jump(node->op) && insts[node->last].adr.kind == OPERAND_LABEL) {
+      Adr target = insts[node->last].adr.value;
+      if (target >= labels && target < label_end) {
+        node->next[1] = blocks_of[target - labels];
+      }
+    }
+    if (node->op != OP_JUMP && node->op != OP_RET && k + 1 < node_array_count(&nodes)) {
+      node->next[0] = k + 1;
+    }
+    if (k > 0 && (node->op == OP_NOP || node->op == OP_JUMP) && node->next[node->op == OP_JUMP] >= 0) {
+      node->empty = 1;
+      for (i = node->first; i < node->last; ++i) {
+        if (insts[i].op != OP_NOP) {
+          node->empty = 0;
           break;
-
-        default:
-          unreachable();
         }
-
-        mppl_unref(name_syntax);
-        break;
       }
+    }
+  }
 
-      case MPPL_VAR_INDEXED: {
-        MpplIndexedVar *indexed_syntax = (MpplIndexedVar *) var_syntax;
-        MpplToken      *name_syntax    = mppl_indexed_var__name(indexed_syntax);
-        AnyMpplExpr    *index_syntax   = mppl_indexed_var__expr(indexed_syntax);
-        const Def      *def            = ctx_resolve(self->ctx, (const SyntaxTree *) name_syntax, NULL);
-        Adr             label          = locate(self, def, ADR_NULL);
-
-        Reg index = write_expr(self, index_syntax, ADR_NULL);
-        write_inst3(self, "LAD", r(GR1), adr(label), x(index));
+  /* thread the jumps through empty blocks, and onto RET where that is all there is */
+  for (k = 0; k < node_array_count(&nodes); ++k) {
+    Node *node    = node_array_at(&nodes, k);
+    node->next[0] = layout_resolve(&nodes, node->next[0]);
+    node->next[1] = layout_resolve(&nodes, node->next[1]);
+  }
+  for (k = 0; k < node_array_count(&nodes); ++k) {
+    Node *node   = node_array_at(&nodes, k);
+    long  target = node->op == OP_JUMP ? node->next[1] : node->op == OP_NOP ? node->next[0] : -1;
+
+    if (op_is_jump(node->op) && node->op != OP_JUMP && node->next[0] == node->next[1]) {
+      node->op      = OP_NOP;
+      node->next[1] = -1;
+    } else if (target >= 0 && !node->empty && layout_returns(node_array_at(&nodes, target), insts)) {
+      node->op      = OP_RET;
+      node->next[0] = -1;
+      node->next[1] = -1;
+    }
+  }
 
-        mppl_unref(name_syntax);
-        mppl_unref(index_syntax);
-        break;
-      }
+  /* find the blocks still reached from the entry */
+  stack = xmalloc(sizeof(long) * (node_array_count(&nodes) + 1));
+  if (node_array_count(&nodes)) {
+    node_array_at(&nodes, 0)->reachable = 1;
+    stack[stack_size++]                 = 0;
+  }
+  while (stack_size > 0) {
+    Node *node = node_array_at(&nodes, stack[--stack_size]);
+    for (i = 0; i < 2; ++i) {
+      if (node->next[i] >= 0 && !node_array_at(&nodes, node->next[i])->reachable) {
+        node_array_at(&nodes, node->next[i])->reachable = 1;
+        stack[stack_size++]                             = node->next[i];
       }
+    }
+  }
 
-      switch (type_kind(type)) {
-      case TYPE_CHAR:
-        write_inst1(self, "CALL", "RCHAR");
-        self->builtin_read_char = 1;
-        break;
+  /* chain up the blocks. a conditional jump that cannot be inverted has to fall
+     through, and one that can is happy to fall into either of its targets */
+  for (k = 0; k < node_array_count(&nodes); ++k) {
+    const Node *node = node_array_at(&nodes, k);
+    if (!node->reachable) {
+      continue;
+    }
+    for (i = 0; i < 2; ++i) {
+      Edge edge;
+      if (node->next[i] < 0 || (i == 1 && node->op != OP_JUMP && invert_jump(node->op) == OP_NOP)) {
+        continue;
+      }
+      edge.from   = k;
+      edge.to     = node->next[i];
+      edge.jump   = i;
+      edge.group  = node->op == OP_NOP || node->op == OP_JUMP ? 1 : invert_jump(node->op) == OP_NOP ? 0 : 2;
+      edge.weight = frequency(node->depth < node_array_at(&nodes, edge.to)->depth ? node->depth : node_array_at(&nodes, edge.to)->depth);
+      edge_array_push(&edges, edge);
+    }
+  }
+  if (edge_array_count(&edges)) {
+    qsort(edge_array_data(&edges), edge_array_count(&edges), sizeof(Edge), &compare_edges);
+  }
+  for (k = 0; k < edge_array_count(&edges); ++k) {
+    const Edge *edge = edge_array_at(&edges, k);
+    Node       *from = node_array_at(&nodes, edge->from);
+    Node       *to   = node_array_at(&nodes, edge->to);
+    long        head = edge->from;
+
+    if (from->succ >= 0 || to->pred >= 0 || edge->to == 0) {
+      continue;
+    }
+    while (node_array_at(&nodes, head)->pred >= 0) {
+      head = node_array_at(&nodes, head)->pred;
+    }
+    if (head != edge->to) {
+      from->succ = edge->to;
+      to->pred   = edge->from;
+    }
+  }
 
-      case TYPE_INTEGER:
-        write_inst1(self, "CALL", "RINT");
-        self->builtin_read_integer = 1;
-        break;
+  /* place the chain of the entry first and the others in their original order */
+  for (k = 0; k < node_array_count(&nodes); ++k) {
+    long node = k;
+    if (!node_array_at(&nodes, k)->reachable || node_array_at(&nodes, k)->pred >= 0) {
+      continue;
+    }
+    for (; node >= 0; node = node_array_at(&nodes, node)->succ) {
+      mask_array_push(&order, node);
+    }
+  }
 
-      default:
-        unreachable();
+  /* labels for the blocks jumped to are settled first, then the body is written over */
+  for (k = 0; k < mask_array_count(&order); ++k) {
+    Inst exit[2];
+    long next = k + 1 < mask_array_count(&order) ? (long) *mask_array_at(&order, k + 1) : -1;
+    layout_exit(self, &nodes, insts, *mask_array_at(&order, k), next, exit);
+  }
+  for (k = 0; k < mask_array_count(&order); ++k) {
+    Inst          exit[2];
+    long          next  = k + 1 < mask_array_count(&order) ? (long) *mask_array_at(&order, k + 1) : -1;
+    const Node   *node  = node_array_at(&nodes, *mask_array_at(&order, k));
+    unsigned long exits = layout_exit(self, &nodes, insts, *mask_array_at(&order, k), next, exit);
+
+    if (node->label) {
+      if (pending) {
+        inst_array_push(&out, peephole_nop(&insts[node->first], pending));
+      }
+      pending = node->label;
+    }
+    for (i = node->first; i < node->last; ++i) {
+      Inst inst  = insts[i];
+      inst.label = ADR_NULL;
+      layout_push(&out, &pending, inst);
+    }
+    for (i = 0; i < exits; ++i) {
+      layout_push(&out, &pending, exit[i]);
+    }
+  }
+  for (k = 0; k < node_array_count(&nodes); ++k) {
+    const Node *node = node_array_at(&nodes, k);
+    if (!node->reachable) {
+      for (i = node->first; i < node->last; ++i) {
+        if (insts[i].adr.kind == OPERAND_STRING) {
+          free(insts[i].adr.text);
+        }
       }
-      mppl_unref(var_syntax);
     }
   }
 
-  if (syntax_tree_kind((const SyntaxTree *) read_syntax) == SYNTAX_READLN_KW) {
-    write_inst1(self, "CALL", "RLINE");
-    self->builtin_read_line = 1;
+  self->insts.count = start;
+  for (i = 0; i < inst_array_count(&out); ++i) {
+    inst_array_push(&self->insts, *inst_array_at(&out, i));
+  }
+  if (pending) {
+    write_pending_label(self, pending);
   }
 
-  mppl_unref(read_syntax);
-  mppl_unref(input_list_syntax);
-  return ADR_NULL;
+  node_array_deinit(&nodes);
+  edge_array_deinit(&edges);
+  mask_array_deinit(&order);
+  inst_array_deinit(&out);
+  free(blocks_of);
+  free(stack);
 }
 
-static Adr write_output_stmt(Generator *self, const MpplOutputStmt *syntax)
+static void write_body_insts(Generator *self, const MpplFmlParamList *params, const MpplCompStmt *body)
 {
-  unsigned long i;
-  MpplToken    *write_syntax       = mppl_output_stmt__write_token(syntax);
-  MpplOutList  *output_list_syntax = mppl_output_stmt__output_list(syntax);
-
-  if (output_list_syntax) {
-    for (i = 0; i < mppl_out_list__out_value_count(output_list_syntax); ++i) {
-      MpplOutValue  *out_value_syntax = mppl_out_list__out_value(output_list_syntax, i);
-      AnyMpplExpr   *expr_syntax      = mppl_out_value__expr(out_value_syntax);
-      MpplNumberLit *width_syntax     = mppl_out_value__width(out_value_syntax);
-      const Type    *type             = ctx_type_of(self->ctx, (const SyntaxTree *) expr_syntax, NULL);
-
-      if (type_kind(type) == TYPE_STRING) {
-        const MpplStringLit  *string_syntax = (MpplStringLit *) expr_syntax;
-        const RawSyntaxToken *token         = (const RawSyntaxToken *) syntax_tree_raw((const SyntaxTree *) string_syntax);
+  unsigned long i, j;
 
-        char *buf = xmalloc(string_length(token->string) + 2);
-        sprintf(buf, "=%s", string_data(token->string));
-
-        write_inst2(self, "LAD", r(GR1), buf);
-        write_inst2(self, "LAD", r(GR2), "0");
-        write_inst1(self, "CALL", "WSTR");
-
-        free(buf);
-      } else {
-        Expr    *value_expr = expr_new(self->ctx, expr_syntax);
-        Expr    *width_expr = width_syntax ? expr_new(self->ctx, (const AnyMpplExpr *) width_syntax) : NULL;
-        RegState state      = reg_state();
-
-        expr_assign_reg(value_expr, GR1, &state);
-        if (width_expr) {
-          expr_assign_reg(width_expr, GR2, &state);
-        }
-        reg_state_release(&state, GR1);
-        reg_state_release(&state, GR2);
-
-        write_expr_core(self, value_expr, ADR_NULL);
-        if (width_expr) {
-          write_expr_core(self, width_expr, ADR_NULL);
+  forget_known(self, NULL);
+  if (params) {
+    write_inst_r(self, OP_POP, GR1);
+    for (i = 0; i < mppl_fml_param_list__sec_count(params); ++i) {
+      MpplFmlParamSec *sec = mppl_fml_param_list__sec(params, i);
+      for (j = 0; j < mppl_fml_param_sec__name_count(sec); ++j) {
+        MpplToken *name = mppl_fml_param_sec__name(sec, j);
+        const Def *def  = ctx_resolve(self->ctx, (const SyntaxTree *) name, NULL);
+        Reg        reg  = promoted(self, def);
+
+        if (reg == REG_NONE) {
+          write_inst_r(self, OP_POP, GR0);
+          write_inst_ra(self, OP_ST, GR0, adr(locate(self, def, ADR_NULL)));
+        } else if (self->planning) {
+          write_inst_r(self, OP_POP, GR0);
+          write_inst_rr(self, OP_LD, reg, GR0);
         } else {
-          write_inst2(self, "LAD", r(GR2), "0");
-        }
-
-        switch (type_kind(type)) {
-        case TYPE_CHAR:
-          write_inst1(self, "CALL", "WCHAR");
-          self->builtin_write_char = 1;
-          break;
-
-        case TYPE_INTEGER:
-          write_inst1(self, "CALL", "WINT");
-          self->builtin_write_integer = 1;
-          break;
-
-        case TYPE_BOOLEAN:
-          write_inst1(self, "CALL", "WBOOL");
-          self->builtin_write_boolean = 1;
-          break;
-
-        default:
-          unreachable();
+          write_inst_r(self, OP_POP, reg);
+          if (candidate_of(self, def)->remat) {
+            write_inst_ra(self, OP_ST, reg, adr(locate(self, def, ADR_NULL)));
+          }
         }
-
-        expr_free(value_expr);
-        expr_free(width_expr);
+        mppl_unref(name);
       }
-
-      mppl_unref(expr_syntax);
-      mppl_unref(width_syntax);
-      mppl_unref(out_value_syntax);
+      mppl_unref(sec);
     }
+    write_inst(self, OP_PUSH, REG_NONE, num(0), GR1);
   }
 
-  if (syntax_tree_kind((const SyntaxTree *) write_syntax) == SYNTAX_WRITELN_KW) {
-    write_inst1(self, "CALL", "WLINE");
+  if (write_stmt(self, (const AnyMpplStmt *) body, ADR_NULL, ADR_NULL) != ADR_CALL) {
+    write_inst0(self, OP_RET);
   }
-  write_inst1(self, "CALL", "FLUSH");
-
-  mppl_unref(write_syntax);
-  mppl_unref(output_list_syntax);
-  return ADR_NULL;
 }
 
-static Adr write_stmt(Generator *self, const AnyMpplStmt *syntax, Adr source, Adr sink)
+/* generate a procedure or main program body, keeping its hot scalar variables in registers */
+static void write_body(Generator *self, const MpplFmlParamList *params, const MpplCompStmt *body)
 {
-  switch (mppl_stmt__kind(syntax)) {
-  case MPPL_STMT_ASSIGN:
-    return write_assign_stmt(self, (const MpplAssignStmt *) syntax);
-
-  case MPPL_STMT_IF:
-    return write_if_stmt(self, (const MpplIfStmt *) syntax, sink);
-
-  case MPPL_STMT_WHILE:
-    return write_while_stmt(self, (const MpplWhileStmt *) syntax, source, sink);
-
-  case MPPL_STMT_BREAK:
-    write_inst1(self, "JUMP", adr(self->break_label));
-    return ADR_NULL;
-
-  case MPPL_STMT_CALL:
-    return write_call_stmt(self, (const MpplCallStmt *) syntax);
-
-  case MPPL_STMT_RETURN:
-    write_inst0(self, "RET");
-    return ADR_CALL;
-
-  case MPPL_STMT_INPUT:
-    return write_input_stmt(self, (const MpplInputStmt *) syntax);
-
-  case MPPL_STMT_OUTPUT:
-    return write_output_stmt(self, (const MpplOutputStmt *) syntax);
+  unsigned long start  = inst_array_count(&self->insts);
+  Adr           labels = self->label_count;
+  Adr           label  = self->current_label;
+  unsigned long i;
 
-  case MPPL_STMT_COMP:
-    return write_comp_stmt(self, (const MpplCompStmt *) syntax, source, sink);
+  self->planning     = 1;
+  self->region_count = 0;
+  self->call_count   = 0;
+  self->clobbered    = 0;
+  write_body_insts(self, params, body);
 
-  default:
-    unreachable();
+  if (candidate_array_count(&self->candidates) || value_array_count(&self->reused)) {
+    if (candidate_array_count(&self->candidates)) {
+      plan_promotion(self, start, labels);
+    } else {
+      mask_array_clear(&self->regions);
+      mask_array_clear(&self->calls);
+      mask_array_clear(&self->call_clobbers);
+    }
+    truncate_insts(self, start);
+
+    self->planning      = 0;
+    self->label_count   = labels;
+    self->current_label = label;
+    self->region_count  = 0;
+    self->call_count    = 0;
+    self->reload_count  = 0;
+    self->clobbered     = 0;
+    write_body_insts(self, params, body);
+  }
+  layout(self, start, labels);
+  if (self->option.peephole) {
+    peephole(self, start, labels);
   }
+  for (i = 0; i < value_array_count(&self->reused); ++i) {
+    const Value *value = value_array_at(&self->reused, i);
+    if (value->slot) {
+      write_label(self, value->slot);
+      write_inst_a(self, OP_DS, num(1));
+    }
+  }
+
+  self->planning = 0;
+  def_map_clear(&self->promotions);
+  candidate_array_clear(&self->candidates);
+  mask_array_clear(&self->regions);
+  mask_array_clear(&self->calls);
+  mask_array_clear(&self->call_clobbers);
+  reload_array_clear(&self->reloads);
+  key_array_clear(&self->reused_keys);
+  value_array_clear(&self->reused);
 }
 
 static void visit_var_decl(const MpplAstWalker *walker, const MpplVarDecl *syntax, void *generator)
@@ -1446,12 +3634,17 @@ static void visit_var_decl(const MpplAstWalker *walker, const MpplVarDecl *synta
   unsigned long i;
 
   for (i = 0; i < mppl_var_decl__name_count(syntax); ++i) {
-    MpplToken *name  = mppl_var_decl__name(syntax, i);
-    const Def *def   = ctx_resolve(self->ctx, (const SyntaxTree *) name, NULL);
-    Adr        label = locate(self, def, self->var_label_count++);
+    MpplToken  *name  = mppl_var_decl__name(syntax, i);
+    const Def  *def   = ctx_resolve(self->ctx, (const SyntaxTree *) name, NULL);
+    const Type *type  = ctx_type_of(self->ctx, def_syntax(def), NULL);
+    Adr         label = locate(self, def, self->var_label_count++);
 
     write_label(self, label);
-    write_inst1(self, "DC", "1");
+    if (type_kind(type) == TYPE_ARRAY) {
+      write_inst_a(self, OP_DS, num(array_type_length((const ArrayType *) type)));
+    } else {
+      write_inst_a(self, OP_DC, num(1));
+    }
     mppl_unref(name);
   }
 
@@ -1469,7 +3662,7 @@ static void visit_fml_param_sec(const MpplAstWalker *walker, const MpplFmlParamS
     Adr        label = locate(self, def, self->arg_label_count++);
 
     write_label(self, label);
-    write_inst1(self, "DC", "1");
+    write_inst_a(self, OP_DC, num(1));
     mppl_unref(name);
   }
 
@@ -1478,7 +3671,6 @@ static void visit_fml_param_sec(const MpplAstWalker *walker, const MpplFmlParamS
 
 static void visit_proc_decl(const MpplAstWalker *walker, const MpplProcDecl *syntax, void *generator)
 {
-  unsigned long     i, j;
   Generator        *self   = generator;
   MpplFmlParamList *params = mppl_proc_decl__fml_param_list(syntax);
   MpplVarDeclPart  *vars   = mppl_proc_decl__var_decl_part(syntax);
@@ -1491,27 +3683,15 @@ static void visit_proc_decl(const MpplAstWalker *walker, const MpplProcDecl *syn
   mppl_ast__walk_var_decl_part(walker, vars, generator);
 
   write_label(self, label);
-  if (params) {
-    write_inst1(self, "POP", r(GR1));
-    for (i = 0; i < mppl_fml_param_list__sec_count(params); ++i) {
-      MpplFmlParamSec *sec = mppl_fml_param_list__sec(params, i);
-      for (j = 0; j < mppl_fml_param_sec__name_count(sec); ++j) {
-        MpplToken *name = mppl_fml_param_sec__name(sec, j);
-        const Def *def  = ctx_resolve(self->ctx, (const SyntaxTree *) name, NULL);
-
-        Adr label = locate(self, def, ADR_NULL);
-        write_inst1(self, "POP", r(GR0));
-        write_inst2(self, "ST", r(GR0), adr(label));
-        mppl_unref(name);
-      }
-      mppl_unref(sec);
-    }
-    write_inst2(self, "PUSH", "0", r(GR1));
-  }
-
-  if (write_stmt(self, (const AnyMpplStmt *) body, ADR_NULL, ADR_NULL) != ADR_CALL) {
-    write_inst0(self, "RET");
+  self->proc = def;
+  write_body(self, params, body);
+  self->proc = NULL;
+  {
+    DefMapIndex index;
+    def_map_entry(&self->clobbers, def, &index);
+    def_map_update(&self->clobbers, &index, def, self->clobbered);
   }
+  flush_insts(self);
 
   mppl_unref(params);
   mppl_unref(vars);
@@ -1528,16 +3708,15 @@ static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax
   Adr           main  = self->label_count++;
 
   write_label(self, start);
-  write_inst1(self, "START", adr(main));
+  write_inst_a(self, OP_START, adr(main));
   for (i = 0; i < mppl_program__decl_part_count(syntax); ++i) {
     AnyMpplDeclPart *decl_part_syntax = mppl_program__decl_part(syntax, i);
     mppl_ast__walk_decl_part(walker, decl_part_syntax, generator);
     mppl_unref(decl_part_syntax);
   }
   write_label(self, main);
-  if (write_stmt(self, (const AnyMpplStmt *) body, ADR_NULL, ADR_NULL) != ADR_CALL) {
-    write_inst0(self, "RET");
-  }
+  write_body(self, NULL, body);
+  flush_insts(self);
 
   if (self->builtin_error_overflow) {
     const char *csl[] = {
@@ -1746,12 +3925,13 @@ static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax
       "          JZE   RI1",
       "          CPA   GR7, =#000A",
       "          JZE   RI1",
-      "          LAD   GR5, 1",
       "          CPA   GR7, =#002D",
-      "          JNZ   RI4",
-      "          LAD   GR5, 0",
+      "          JNZ   RI6",
       "          CALL  RCHAR",
       "          LD    GR7, 0, GR1",
+      "          PUSH  0",
+      "          JUMP  RI4",
+      "RI6       PUSH  1",
       "RI4       LAD   GR6, 0",
       "RI2       CPA   GR7, =#0030",
       "          JMI   RI3",
@@ -1765,6 +3945,7 @@ static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax
       "          JUMP  RI2",
       "RI3       ST    GR7, RPBBUF",
       "          ST    GR6, 0, GR1",
+      "          POP   GR5",
       "          CPA   GR5, =0",
       "          JNZ   RI5",
       "          SUBA  GR5, GR6",
@@ -1825,16 +4006,22 @@ static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax
     write_builtin(self, csl, sizeof(csl) / sizeof(csl[0]));
   }
 
-  write_inst0(self, "END");
+  write_inst0(self, OP_END);
+  flush_insts(self);
 
   mppl_unref(body);
 }
 
-int mpplc_codegen_casl2(const Source *source, const MpplProgram *syntax, Ctx *ctx)
+int mpplc_codegen_casl2(const Source *source, const MpplProgram *syntax, Ctx *ctx, const Casl2Option *option)
 {
   MpplAstWalker walker;
 
   Generator self;
+  if (option) {
+    self.option = *option;
+  } else {
+    self.option.peephole = 1;
+  }
   self.ctx              = ctx;
   self.symbols          = map_new(NULL, NULL);
   self.current_label    = 0;
@@ -1843,14 +4030,36 @@ int mpplc_codegen_casl2(const Source *source, const MpplProgram *syntax, Ctx *ct
   self.arg_label_count  = (unsigned long) ADR_ARG << ADR_KIND_OFFSET;
   self.proc_label_count = (unsigned long) ADR_PROC << ADR_KIND_OFFSET;
   self.break_label      = ADR_NULL;
+  self.proc             = NULL;
+  self.planning         = 0;
+  self.loop_depth       = 0;
+  self.region_count     = 0;
+  self.call_count       = 0;
+  self.reload_count     = 0;
+  self.clobbered        = 0;
+  self.reusing          = 0;
+  inst_array_init(&self.insts);
+  def_map_init(&self.promotions);
+  candidate_array_init(&self.candidates);
+  mask_array_init(&self.regions);
+  mask_array_init(&self.calls);
+  mask_array_init(&self.call_clobbers);
+  reload_array_init(&self.reloads);
+  def_map_init(&self.clobbers);
+  def_map_init(&self.shared);
+  key_array_init(&self.keys);
+  check_array_init(&self.checks);
+  value_array_init(&self.values);
+  key_array_init(&self.reused_keys);
+  value_array_init(&self.reused);
   {
     char *output_filename = xmalloc(sizeof(char) * (source->file_name_length + 1));
     sprintf(output_filename, "%.*s.csl", (int) source->file_name_length - 4, source->file_name);
-    self.file = fopen(output_filename, "w");
+    self.emitter = emitter_new_file(output_filename);
     free(output_filename);
   }
 
-  if (self.file == NULL) {
+  if (!self.emitter) {
     fprintf(stderr, "error: failed to open output file\n");
     return 0;
   }
@@ -1882,7 +4091,24 @@ int mpplc_codegen_casl2(const Source *source, const MpplProgram *syntax, Ctx *ct
     }
     map_free(self.symbols);
   }
-
-  fclose(self.file);
+  inst_array_deinit(&self.insts);
+  def_map_deinit(&self.promotions);
+  candidate_array_deinit(&self.candidates);
+  mask_array_deinit(&self.regions);
+  mask_array_deinit(&self.calls);
+  mask_array_deinit(&self.call_clobbers);
+  reload_array_deinit(&self.reloads);
+  def_map_deinit(&self.clobbers);
+  def_map_deinit(&self.shared);
+  key_array_deinit(&self.keys);
+  check_array_deinit(&self.checks);
+  value_array_deinit(&self.values);
+  key_array_deinit(&self.reused_keys);
+  value_array_deinit(&self.reused);
+
+  if (!emitter_free(self.emitter)) {
+    fprintf(stderr, "error: failed to write output file\n");
+    return 0;
+  }
   return 1;
 }
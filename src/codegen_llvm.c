@@ -22,6 +22,8 @@
 #include "compiler.h"
 #include "context.h"
 #include "context_fwd.h"
+#include "emitter.h"
+#include "map.h"
 #include "mppl_syntax.h"
 #include "mppl_syntax_ext.h"
 #include "syntax_kind.h"
@@ -32,6 +34,9 @@ typedef unsigned long    Temp;
 typedef unsigned long    Label;
 typedef struct Str       Str;
 typedef struct Ptr       Ptr;
+typedef struct Value     Value;
+typedef struct Block     Block;
+typedef struct Numbering Numbering;
 typedef struct Generator Generator;
 
 #define LABEL_NULL   ((Label) 0)
@@ -52,14 +57,80 @@ struct Ptr {
   } ptr;
 };
 
+/* an operand of an instruction. constants folded by the checker are written in place */
+struct Value {
+  int  is_constant;
+  Temp temp;
+  long constant;
+  char text[24];
+};
+
+typedef enum {
+  TERM_NONE,
+  TERM_JUMP,
+  TERM_BRANCH,
+  TERM_RETURN
+} Term;
+
+/* a basic block of the function being written. its instructions are the text of the
+   function from `begin` to `end`, and its terminator is kept apart so that the
+   blocks can be threaded and rearranged before the function is written out.
+   `next` holds the targets of the terminator, the true one first */
+struct Block {
+  Label         label;
+  unsigned long begin;
+  unsigned long end;
+  Term          term;
+  Temp          cond;
+  Label         next[2];
+  unsigned long preds;
+  int           reachable;
+  int           placed;
+};
+
+static unsigned long key_hash(const char *key)
+{
+  return hash_bytes(HASH_INIT, key, strlen(key));
+}
+
+static int key_equal(const char *left, const char *right)
+{
+  return strcmp(left, right) == 0;
+}
+
+DEFINE_MAP(ValueMap, value_map, const char *, Value, key_hash, key_equal)
+
+/* the instructions written so far in the current block, keyed by their text, with
+   the values they left. `keys` owns the copies of the keys */
+struct Numbering {
+  ValueMap map;
+  Array   *keys;
+};
+
+/* while a function is written, `emitter` collects its text in `body`
+   and `output` is where the function goes */
 struct Generator {
-  Ctx  *ctx;
-  FILE *file;
+  Ctx     *ctx;
+  Emitter *emitter;
+  Emitter *output;
 
   Temp   temp;
   Label  block;
   Label  break_label;
   Array *strs;
+
+  Array      *body;
+  Array      *blocks;
+  Label       first_label;
+  const char *ret;
+
+  /* within a block, instructions without side effects are written once and their
+     values reused. loads are numbered apart from the rest because any store or call
+     may change what they read, and `key` collects the text of the instruction at hand */
+  Numbering pure;
+  Numbering memory;
+  Array    *key;
+  Emitter  *key_emitter;
 };
 
 unsigned long type_width(const Type *type)
@@ -106,30 +177,221 @@ void str_push(Str *self, const char *string)
   array_push_count(self->chars, (void *) string, i);
 }
 
-void write(Generator *self, const char *format, ...)
+static void write(Generator *self, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  emitter_vprintf(self->emitter, format, args);
+  va_end(args);
+}
+
+static void write_inst(Generator *self, const char *format, ...)
 {
   va_list args;
   va_start(args, format);
-  vfprintf(self->file, format, args);
+  emitter_write(self->emitter, "  ", 2);
+  emitter_vprintf(self->emitter, format, args);
+  emitter_putc(self->emitter, '\n');
   va_end(args);
 }
 
-void write_inst(Generator *self, const char *format, ...)
+static int push_chars(void *chars, const char *bytes, unsigned long length)
+{
+  array_push_count(chars, (void *) bytes, length);
+  return 1;
+}
+
+static void numbering_init(Numbering *self)
+{
+  value_map_init(&self->map);
+  self->keys = array_new(sizeof(char *));
+}
+
+static void numbering_clear(Numbering *self)
+{
+  unsigned long i;
+  for (i = 0; i < array_count(self->keys); ++i) {
+    free(*(char **) array_at(self->keys, i));
+  }
+  array_clear(self->keys);
+  value_map_clear(&self->map);
+}
+
+static void numbering_deinit(Numbering *self)
+{
+  numbering_clear(self);
+  array_free(self->keys);
+  value_map_deinit(&self->map);
+}
+
+static int numbering_find(const Numbering *self, const char *key, Value *value)
+{
+  ValueMapIndex index;
+  if (value_map_entry(&self->map, key, &index)) {
+    *value = value_map_value(&self->map, &index);
+    return 1;
+  }
+  return 0;
+}
+
+static void numbering_insert(Numbering *self, const char *key, Value value)
+{
+  ValueMapIndex index;
+  if (value_map_entry(&self->map, key, &index)) {
+    value_map_update(&self->map, &index, value_map_key(&self->map, &index), value);
+  } else {
+    char *copy = dup(key, sizeof(char), strlen(key) + 1);
+    array_push(self->keys, &copy);
+    value_map_update(&self->map, &index, copy, value);
+  }
+}
+
+/* format the text of an instruction into `key`, which holds it until the next call */
+static const char *format_key(Generator *self, const char *format, ...)
 {
   va_list args;
   va_start(args, format);
-  fprintf(self->file, "  ");
-  vfprintf(self->file, format, args);
-  fprintf(self->file, "\n");
+  array_clear(self->key);
+  emitter_vprintf(self->key_emitter, format, args);
+  emitter_putc(self->key_emitter, '\0');
+  emitter_flush(self->key_emitter);
   va_end(args);
+  return array_data(self->key);
+}
+
+static unsigned long body_offset(Generator *self)
+{
+  emitter_flush(self->emitter);
+  return array_count(self->body);
+}
+
+static void push_block(Generator *self, Label label, unsigned long begin)
+{
+  Block block;
+  block.label     = label;
+  block.begin     = begin;
+  block.end       = begin;
+  block.term      = TERM_NONE;
+  block.cond      = 0;
+  block.next[0]   = LABEL_NULL;
+  block.next[1]   = LABEL_NULL;
+  block.preds     = 0;
+  block.reachable = 0;
+  block.placed    = 0;
+  array_push(self->blocks, &block);
+}
+
+/* end the current block with `term`. anything written after the previous
+   terminator lands in a block of its own, which nothing reaches */
+static Block *end_block(Generator *self, Term term)
+{
+  unsigned long offset = body_offset(self);
+  Block        *block  = array_back(self->blocks);
+
+  if (block->term != TERM_NONE) {
+    push_block(self, LABEL_NULL, block->end);
+    block = array_back(self->blocks);
+  }
+  block->end  = offset;
+  block->term = term;
+
+  numbering_clear(&self->pure);
+  numbering_clear(&self->memory);
+  return block;
+}
+
+static void write_jump(Generator *self, Label label)
+{
+  Block *block   = end_block(self, TERM_JUMP);
+  block->next[0] = label;
+}
+
+static void write_branch(Generator *self, Value cond, Label then_label, Label else_label)
+{
+  if (cond.is_constant) {
+    write_jump(self, cond.constant ? then_label : else_label);
+  } else {
+    Block *block   = end_block(self, TERM_BRANCH);
+    block->cond    = cond.temp;
+    block->next[0] = then_label;
+    block->next[1] = else_label;
+  }
+}
+
+static void write_return(Generator *self)
+{
+  end_block(self, TERM_RETURN);
+}
+
+static void write_label(Generator *self, Label label)
+{
+  if (((Block *) array_back(self->blocks))->term == TERM_NONE) {
+    write_jump(self, label);
+  }
+  push_block(self, label, body_offset(self));
+}
+
+Value write_expr(Generator *self, const AnyMpplExpr *expr);
+
+Value value_temp(Temp temp)
+{
+  Value value;
+  value.is_constant = 0;
+  value.temp        = temp;
+  value.constant    = 0;
+  sprintf(value.text, "%%.t%lu", temp);
+  return value;
+}
+
+Value value_constant(long constant)
+{
+  Value value;
+  value.is_constant = 1;
+  value.temp        = 0;
+  value.constant    = constant;
+  sprintf(value.text, "%ld", constant);
+  return value;
+}
+
+/* write `key` as the instruction defining a new temporary, unless the current block
+   already has its value */
+static Value write_numbered(Generator *self, Numbering *numbering, const char *key)
+{
+  Value value;
+  if (!numbering_find(numbering, key, &value)) {
+    value = value_temp(self->temp++);
+    write_inst(self, "%s = %s", value.text, key);
+    numbering_insert(numbering, key, value);
+  }
+  return value;
 }
 
-void write_label(Generator *self, Label label)
+/* write the call to an assertion `key`, unless the current block already passed it */
+static void write_assert(Generator *self, const char *key)
 {
-  fprintf(self->file, "l%lu:\n", label);
+  Value value;
+  if (!numbering_find(&self->pure, key, &value)) {
+    write_inst(self, "%s", key);
+    numbering_insert(&self->pure, key, value_constant(0));
+  }
+}
+
+static const char *format_load(Generator *self, const Ptr *ptr)
+{
+  unsigned long width = type_width(ptr->type);
+  if (ptr->is_temporal) {
+    return format_key(self, "load i%lu, ptr %%.t%lu", width, ptr->ptr.temporal);
+  } else {
+    const char *prefix = def_kind(ptr->ptr.def) == DEF_VAR ? "@" : "%";
+    return format_key(self, "load i%lu, ptr %s%s", width, prefix, string_data(def_name(ptr->ptr.def)));
+  }
 }
 
-void write_expr(Generator *self, Temp result, const AnyMpplExpr *expr);
+/* after a store or a call, nothing loaded before can be trusted */
+static void forget_memory(Generator *self)
+{
+  numbering_clear(&self->memory);
+}
 
 Ptr write_expr_ptr(Generator *self, const AnyMpplExpr *expr)
 {
@@ -162,16 +424,18 @@ Ptr write_expr_ptr(Generator *self, const AnyMpplExpr *expr)
       const ArrayType *def_type = (const ArrayType *) ctx_type_of(self->ctx, def_syntax(def), NULL);
       unsigned long    length   = array_type_length(def_type);
 
-      Temp index_temporal = self->temp++;
-      Temp ptr_temporal   = self->temp++;
+      Value index = write_expr(self, index_syntax);
+      Value ptr;
 
-      write_expr(self, index_temporal, index_syntax);
-      write_inst(self, "call void @.assert.range(i16 %%.t%lu, i16 %lu)", index_temporal, length);
-      write_inst(self, "%%.t%lu = getelementptr inbounds [%lu x i%lu], ptr @%s, i32 0, i16 %%.t%lu",
-        ptr_temporal, length, type_width(ref.type), string_data(raw_name_token->string), index_temporal);
+      if (!index.is_constant || index.constant < 0 || index.constant >= (long) length) {
+        write_assert(self, format_key(self, "call void @.assert.range(i16 %s, i16 %lu)", index.text, length));
+      }
+      ptr = write_numbered(self, &self->pure,
+        format_key(self, "getelementptr inbounds [%lu x i%lu], ptr @%s, i32 0, i16 %s",
+          length, type_width(ref.type), string_data(raw_name_token->string), index.text));
 
       ref.is_temporal  = 1;
-      ref.ptr.temporal = ptr_temporal;
+      ref.ptr.temporal = ptr.temp;
 
       mppl_unref(name_token);
       mppl_unref(index_syntax);
@@ -182,12 +446,11 @@ Ptr write_expr_ptr(Generator *self, const AnyMpplExpr *expr)
       unreachable();
     }
   } else {
-    Temp temporal    = self->temp++;
+    Value value      = write_expr(self, expr);
     ref.is_temporal  = 1;
     ref.ptr.temporal = self->temp++;
-    write_expr(self, temporal, expr);
     write_inst(self, "%%.t%lu = alloca i%lu", ref.ptr.temporal, type_width(ref.type));
-    write_inst(self, "store i%lu %%.t%lu, ptr %%.t%lu", type_width(ref.type), temporal, ref.ptr.temporal);
+    write_inst(self, "store i%lu %s, ptr %%.t%lu", type_width(ref.type), value.text, ref.ptr.temporal);
   }
   return ref;
 }
@@ -202,131 +465,137 @@ void write_ptr(Generator *self, const Ptr *ptr)
   }
 }
 
-void write_arithmetic_expr(
-  Generator *self, Temp result, const char *inst,
+Value write_arithmetic_expr(
+  Generator *self, const char *inst,
   const AnyMpplExpr *lhs_syntax, const AnyMpplExpr *rhs_syntax, int check_division_by_zero)
 {
-  Temp lhs_temporal = self->temp++;
-  Temp rhs_temporal = self->temp++;
+  Value lhs = write_expr(self, lhs_syntax);
+  Value rhs = write_expr(self, rhs_syntax);
 
-  write_expr(self, lhs_temporal, lhs_syntax);
-  write_expr(self, rhs_temporal, rhs_syntax);
-  if (check_division_by_zero) {
-    write_inst(self, "call void @.assert.division(i16 %%.t%lu)", rhs_temporal);
+  if (check_division_by_zero && (!rhs.is_constant || !rhs.constant)) {
+    write_assert(self, format_key(self, "call void @.assert.division(i16 %s)", rhs.text));
   }
-  write_inst(self, "%%.t%lu = %s i16 %%.t%lu, %%.t%lu", result, inst, lhs_temporal, rhs_temporal);
+  return write_numbered(self, &self->pure, format_key(self, "%s i16 %s, %s", inst, lhs.text, rhs.text));
 }
 
-void write_arithmetic_expr_with_overflow(
-  Generator *self, Temp result, const char *inst,
+Value write_arithmetic_expr_with_overflow(
+  Generator *self, const char *inst,
   const AnyMpplExpr *lhs_syntax, const AnyMpplExpr *rhs_syntax)
 {
-  Temp result_temporal = self->temp++;
-  Temp lhs_temporal    = self->temp++;
-  Temp rhs_temporal    = self->temp++;
-
-  write_expr(self, lhs_temporal, lhs_syntax);
-  write_expr(self, rhs_temporal, rhs_syntax);
-  write_inst(self, "%%.t%lu = call {i16, i1} @llvm.%s.with.overflow.i16(i16 %%.t%lu, i16 %%.t%lu)", result_temporal, inst, lhs_temporal, rhs_temporal);
-  write_inst(self, "%%.t%lu = call i16 @.assert.overflow({i16, i1} %%.t%lu)", result, result_temporal);
+  Value lhs  = write_expr(self, lhs_syntax);
+  Value rhs  = write_expr(self, rhs_syntax);
+  Value pair = write_numbered(self, &self->pure,
+    format_key(self, "call {i16, i1} @llvm.%s.with.overflow.i16(i16 %s, i16 %s)", inst, lhs.text, rhs.text));
+
+  return write_numbered(self, &self->pure, format_key(self, "call i16 @.assert.overflow({i16, i1} %s)", pair.text));
 }
 
-void write_relational_expr(Generator *self, Temp result, const char *inst, const AnyMpplExpr *lhs_syntax, const AnyMpplExpr *rhs_syntax)
+Value write_relational_expr(Generator *self, const char *inst, const AnyMpplExpr *lhs_syntax, const AnyMpplExpr *rhs_syntax)
 {
   const Type   *type          = ctx_type_of(self->ctx, (const SyntaxTree *) rhs_syntax, NULL);
   unsigned long operand_width = type_width(type);
+  char          predicate[4];
 
-  Temp lhs_temporal = self->temp++;
-  Temp rhs_temporal = self->temp++;
+  Value lhs = write_expr(self, lhs_syntax);
+  Value rhs = write_expr(self, rhs_syntax);
 
-  write_expr(self, lhs_temporal, lhs_syntax);
-  write_expr(self, rhs_temporal, rhs_syntax);
-  write_inst(self, "%%.t%lu = icmp %s i%lu %%.t%lu, %%.t%lu", result, inst, operand_width, lhs_temporal, rhs_temporal);
+  /* `true` is greater than `false` and characters run from 0 to 255, as in the folded
+     constants, so only integers are compared signed */
+  strcpy(predicate, inst);
+  if (type_kind(type) != TYPE_INTEGER && predicate[0] == 's') {
+    predicate[0] = 'u';
+  }
+  return write_numbered(self, &self->pure,
+    format_key(self, "icmp %s i%lu %s, %s", predicate, operand_width, lhs.text, rhs.text));
 }
 
-void write_logical_expr(Generator *self, Temp result, int jumpon, const AnyMpplExpr *lhs_syntax, const AnyMpplExpr *rhs_syntax)
+Value write_logical_expr(Generator *self, int jumpon, const AnyMpplExpr *lhs_syntax, const AnyMpplExpr *rhs_syntax)
 {
   Label then_label = self->block++;
   Label next_label = self->block++;
 
-  Temp temporal     = self->temp++;
-  Temp lhs_temporal = self->temp++;
-  Temp rhs_temporal = self->temp++;
+  Temp  temporal = self->temp++;
+  Temp  result   = self->temp++;
+  Value lhs, rhs;
 
   write_inst(self, "%%.t%lu = alloca i1", temporal);
-  write_expr(self, lhs_temporal, lhs_syntax);
-  write_inst(self, "store i1 %%.t%lu, ptr %%.t%lu", lhs_temporal, temporal);
+  lhs = write_expr(self, lhs_syntax);
+  write_inst(self, "store i1 %s, ptr %%.t%lu", lhs.text, temporal);
   if (jumpon) {
-    write_inst(self, "br i1 %%.t%lu, label %%l%lu, label %%l%lu", lhs_temporal, next_label, then_label);
+    write_branch(self, lhs, next_label, then_label);
   } else {
-    write_inst(self, "br i1 %%.t%lu, label %%l%lu, label %%l%lu", lhs_temporal, then_label, next_label);
+    write_branch(self, lhs, then_label, next_label);
   }
-  write(self, "\n");
 
   write_label(self, then_label);
-  write_expr(self, rhs_temporal, rhs_syntax);
-  write_inst(self, "store i1 %%.t%lu, ptr %%.t%lu", rhs_temporal, temporal);
-  write_inst(self, "br label %%l%lu", next_label);
-  write(self, "\n");
+  rhs = write_expr(self, rhs_syntax);
+  write_inst(self, "store i1 %s, ptr %%.t%lu", rhs.text, temporal);
+  write_jump(self, next_label);
 
   write_label(self, next_label);
   write_inst(self, "%%.t%lu = load i1, ptr %%.t%lu", result, temporal);
+  return value_temp(result);
 }
 
-void write_binary_expr(Generator *self, Temp result, const MpplBinaryExpr *expr)
+Value write_binary_expr(Generator *self, const MpplBinaryExpr *expr)
 {
-  AnyMpplExpr *lhs_syntax = mppl_binary_expr__lhs(expr);
-  AnyMpplExpr *rhs_syntax = mppl_binary_expr__rhs(expr);
-  MpplToken   *op_token   = mppl_binary_expr__op_token(expr);
-
-  if (lhs_syntax) {
+  AnyMpplExpr *lhs_syntax     = mppl_binary_expr__lhs(expr);
+  AnyMpplExpr *rhs_syntax     = mppl_binary_expr__rhs(expr);
+  MpplToken   *op_token       = mppl_binary_expr__op_token(expr);
+  AnyMpplExpr *operand_syntax = mppl_binary_expr__identity_operand(expr, self->ctx);
+  Value        result;
+
+  if (operand_syntax) {
+    result = write_expr(self, operand_syntax);
+    mppl_unref(operand_syntax);
+  } else if (lhs_syntax) {
     switch (syntax_tree_kind((SyntaxTree *) op_token)) {
     case SYNTAX_PLUS_TOKEN:
-      write_arithmetic_expr_with_overflow(self, result, "sadd", lhs_syntax, rhs_syntax);
+      result = write_arithmetic_expr_with_overflow(self, "sadd", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_MINUS_TOKEN:
-      write_arithmetic_expr_with_overflow(self, result, "ssub", lhs_syntax, rhs_syntax);
+      result = write_arithmetic_expr_with_overflow(self, "ssub", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_STAR_TOKEN:
-      write_arithmetic_expr_with_overflow(self, result, "smul", lhs_syntax, rhs_syntax);
+      result = write_arithmetic_expr_with_overflow(self, "smul", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_DIV_KW:
-      write_arithmetic_expr(self, result, "sdiv", lhs_syntax, rhs_syntax, 1);
+      result = write_arithmetic_expr(self, "sdiv", lhs_syntax, rhs_syntax, 1);
       break;
 
     case SYNTAX_EQUAL_TOKEN:
-      write_relational_expr(self, result, "eq", lhs_syntax, rhs_syntax);
+      result = write_relational_expr(self, "eq", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_NOTEQ_TOKEN:
-      write_relational_expr(self, result, "ne", lhs_syntax, rhs_syntax);
+      result = write_relational_expr(self, "ne", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_LESS_TOKEN:
-      write_relational_expr(self, result, "slt", lhs_syntax, rhs_syntax);
+      result = write_relational_expr(self, "slt", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_LESSEQ_TOKEN:
-      write_relational_expr(self, result, "sle", lhs_syntax, rhs_syntax);
+      result = write_relational_expr(self, "sle", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_GREATER_TOKEN:
-      write_relational_expr(self, result, "sgt", lhs_syntax, rhs_syntax);
+      result = write_relational_expr(self, "sgt", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_GREATEREQ_TOKEN:
-      write_relational_expr(self, result, "sge", lhs_syntax, rhs_syntax);
+      result = write_relational_expr(self, "sge", lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_AND_KW:
-      write_logical_expr(self, result, 0, lhs_syntax, rhs_syntax);
+      result = write_logical_expr(self, 0, lhs_syntax, rhs_syntax);
       break;
 
     case SYNTAX_OR_KW:
-      write_logical_expr(self, result, 1, lhs_syntax, rhs_syntax);
+      result = write_logical_expr(self, 1, lhs_syntax, rhs_syntax);
       break;
 
     default:
@@ -335,13 +604,12 @@ void write_binary_expr(Generator *self, Temp result, const MpplBinaryExpr *expr)
   } else {
     switch (syntax_tree_kind((SyntaxTree *) op_token)) {
     case SYNTAX_PLUS_TOKEN:
-      write_expr(self, result, rhs_syntax);
+      result = write_expr(self, rhs_syntax);
       break;
 
     case SYNTAX_MINUS_TOKEN: {
-      Temp rhs_temporal = self->temp++;
-      write_expr(self, rhs_temporal, rhs_syntax);
-      write_inst(self, "%%.t%lu = sub i16 0, %%.t%lu", result, rhs_temporal);
+      Value rhs = write_expr(self, rhs_syntax);
+      result    = write_numbered(self, &self->pure, format_key(self, "sub i16 0, %s", rhs.text));
       break;
     }
 
@@ -353,58 +621,59 @@ void write_binary_expr(Generator *self, Temp result, const MpplBinaryExpr *expr)
   mppl_unref(op_token);
   mppl_unref(lhs_syntax);
   mppl_unref(rhs_syntax);
+  return result;
 }
 
-void write_not_expr(Generator *self, Temp result, const MpplNotExpr *expr)
+Value write_not_expr(Generator *self, const MpplNotExpr *expr)
 {
-  AnyMpplExpr *operand_syntax   = mppl_not_expr__expr(expr);
-  Temp         operand_temporal = self->temp++;
-
-  write_expr(self, operand_temporal, operand_syntax);
-  write_inst(self, "%%.t%lu = xor i1 %%.t%lu, 1", result, operand_temporal);
+  AnyMpplExpr *operand_syntax = mppl_not_expr__expr(expr);
+  Value        operand        = write_expr(self, operand_syntax);
+  Value        result         = write_numbered(self, &self->pure, format_key(self, "xor i1 %s, 1", operand.text));
 
   mppl_unref(operand_syntax);
+  return result;
 }
 
-void write_paren_expr(Generator *self, Temp result, const MpplParenExpr *expr)
+Value write_paren_expr(Generator *self, const MpplParenExpr *expr)
 {
   AnyMpplExpr *operand_syntax = mppl_paren_expr__expr(expr);
-  write_expr(self, result, operand_syntax);
+  Value        result         = write_expr(self, operand_syntax);
   mppl_unref(operand_syntax);
+  return result;
 }
 
-void write_cast_expr(Generator *self, Temp result, const MpplCastExpr *expr)
+Value write_cast_expr(Generator *self, const MpplCastExpr *expr)
 {
   AnyMpplExpr *operand_syntax = mppl_cast_expr__expr(expr);
   const Type  *expr_type      = ctx_type_of(self->ctx, (const SyntaxTree *) expr, NULL);
   const Type  *operand_type   = ctx_type_of(self->ctx, (const SyntaxTree *) operand_syntax, NULL);
+  Value        result;
 
   if (expr_type == operand_type) {
-    write_expr(self, result, operand_syntax);
+    result = write_expr(self, operand_syntax);
   } else {
-    Temp operand_temporal = self->temp++;
-    write_expr(self, operand_temporal, operand_syntax);
+    Value       operand = write_expr(self, operand_syntax);
+    const char *key;
 
     switch (type_kind(expr_type)) {
     case TYPE_BOOLEAN: {
-      write_inst(self, "%%.t%lu = icmp ne i%lu %%.t%lu, 0", result, type_width(operand_type), operand_temporal);
+      key = format_key(self, "icmp ne i%lu %s, 0", type_width(operand_type), operand.text);
       break;
     }
 
     case TYPE_INTEGER: {
-      unsigned long operand_width = type_width(operand_type);
-      write_inst(self, "%%.t%lu = zext i%lu %%.t%lu to i16", result, operand_width, operand_temporal);
+      key = format_key(self, "zext i%lu %s to i16", type_width(operand_type), operand.text);
       break;
     }
 
     case TYPE_CHAR: {
       switch (type_kind(operand_type)) {
       case TYPE_BOOLEAN:
-        write_inst(self, "%%.t%lu = zext i1 %%.t%lu to i8", result, operand_temporal);
+        key = format_key(self, "zext i1 %s to i8", operand.text);
         break;
 
       case TYPE_INTEGER:
-        write_inst(self, "%%.t%lu = trunc i16 %%.t%lu to i8", result, operand_temporal);
+        key = format_key(self, "trunc i16 %s to i8", operand.text);
         break;
 
       default:
@@ -416,79 +685,43 @@ void write_cast_expr(Generator *self, Temp result, const MpplCastExpr *expr)
     default:
       unreachable();
     }
+    result = write_numbered(self, &self->pure, key);
   }
 
   mppl_unref(operand_syntax);
+  return result;
 }
 
-void write_var_expr(Generator *self, Temp result, const AnyMpplVar *var)
+Value write_var_expr(Generator *self, const AnyMpplVar *var)
 {
   Ptr ptr = write_expr_ptr(self, (AnyMpplExpr *) var);
-  write(self, "  %%.t%lu = load i%lu, ptr ", result, type_width(ptr.type));
-  write_ptr(self, &ptr);
-  write(self, "\n");
+  return write_numbered(self, &self->memory, format_load(self, &ptr));
 }
 
-Label write_lit_expr(Generator *self, Temp result, const AnyMpplLit *lit)
+/* the checker folds every literal in an expression, so constants are written
+   into the instructions reading them instead of being materialized */
+Value write_expr(Generator *self, const AnyMpplExpr *expr)
 {
-  switch (mppl_lit__kind(lit)) {
-  case MPPL_LIT_NUMBER: {
-    const MpplNumberLit *number_lit_syntax = (const MpplNumberLit *) lit;
-
-    long value = mppl_lit_number__to_long(number_lit_syntax);
-    write_inst(self, "%%.t%lu = add i16 0, %ld", result, value);
-    break;
-  }
-
-  case MPPL_LIT_STRING: {
-    const MpplStringLit *string_lit_syntax = (const MpplStringLit *) lit;
-
-    char *value = mppl_lit_string__to_string(string_lit_syntax);
-    write_inst(self, "%%.t%lu = add i8 0, %d", result, (int) value[0]);
-    free(value);
-    break;
-  }
-
-  case MPPL_LIT_BOOLEAN: {
-    const MpplBooleanLit *boolean_lit_syntax = (const MpplBooleanLit *) lit;
-
-    int value = mppl_lit_boolean__to_int(boolean_lit_syntax);
-    write_inst(self, "%%.t%lu = add i1 0, %d", result, value);
-    break;
-  }
-
-  default:
-    unreachable();
+  long value;
+  if (ctx_folded(self->ctx, (const SyntaxTree *) expr, &value)) {
+    return value_constant(value);
   }
-  return LABEL_NULL;
-}
 
-void write_expr(Generator *self, Temp result, const AnyMpplExpr *expr)
-{
   switch (mppl_expr__kind(expr)) {
   case MPPL_EXPR_BINARY:
-    write_binary_expr(self, result, (const MpplBinaryExpr *) expr);
-    break;
+    return write_binary_expr(self, (const MpplBinaryExpr *) expr);
 
   case MPPL_EXPR_NOT:
-    write_not_expr(self, result, (const MpplNotExpr *) expr);
-    break;
+    return write_not_expr(self, (const MpplNotExpr *) expr);
 
   case MPPL_EXPR_PAREN:
-    write_paren_expr(self, result, (const MpplParenExpr *) expr);
-    break;
+    return write_paren_expr(self, (const MpplParenExpr *) expr);
 
   case MPPL_EXPR_CAST:
-    write_cast_expr(self, result, (const MpplCastExpr *) expr);
-    break;
+    return write_cast_expr(self, (const MpplCastExpr *) expr);
 
   case MPPL_EXPR_VAR:
-    write_var_expr(self, result, (const AnyMpplVar *) expr);
-    break;
-
-  case MPPL_EXPR_LIT:
-    write_lit_expr(self, result, (const AnyMpplLit *) expr);
-    break;
+    return write_var_expr(self, (const AnyMpplVar *) expr);
 
   default:
     unreachable();
@@ -501,16 +734,19 @@ Label write_assign_stmt(Generator *self, const MpplAssignStmt *syntax)
 {
   AnyMpplVar   *lhs_syntax = mppl_assign_stmt__lhs(syntax);
   AnyMpplExpr  *rhs_syntax = mppl_assign_stmt__rhs(syntax);
-  Temp          value      = self->temp++;
   const Type   *lhs_type   = ctx_type_of(self->ctx, (const SyntaxTree *) lhs_syntax, NULL);
   unsigned long width      = type_width(lhs_type);
 
-  Ptr ref = write_expr_ptr(self, (AnyMpplExpr *) lhs_syntax);
-  write_expr(self, value, rhs_syntax);
-  write(self, "  store i%lu %%.t%lu, ptr ", width, value);
+  Ptr   ref   = write_expr_ptr(self, (AnyMpplExpr *) lhs_syntax);
+  Value value = write_expr(self, rhs_syntax);
+  write(self, "  store i%lu %s, ptr ", width, value.text);
   write_ptr(self, &ref);
   write(self, "\n");
 
+  /* the variable now holds `value`, so reading it back needs no load */
+  forget_memory(self);
+  numbering_insert(&self->memory, format_load(self, &ref), value);
+
   mppl_unref(lhs_syntax);
   mppl_unref(rhs_syntax);
   return LABEL_NULL;
@@ -522,31 +758,27 @@ Label write_if_stmt(Generator *self, const MpplIfStmt *syntax, Label sink)
   AnyMpplStmt *then_syntax = mppl_if_stmt__then_stmt(syntax);
   AnyMpplStmt *else_syntax = mppl_if_stmt__else_stmt(syntax);
 
-  Temp  cond_temporal = self->temp++;
-  Label next_label    = sink ? sink : self->block++;
+  Value cond       = write_expr(self, cond_syntax);
+  Label next_label = sink ? sink : self->block++;
   Label label;
-  write_expr(self, cond_temporal, cond_syntax);
 
   if (else_syntax) {
     Label then_label = self->block++;
     Label else_label = self->block++;
 
-    write_inst(self, "br i1 %%.t%lu, label %%l%lu, label %%l%lu", cond_temporal, then_label, else_label);
-    write(self, "\n");
+    write_branch(self, cond, then_label, else_label);
 
     write_label(self, then_label);
     label = write_stmt(self, then_syntax, then_label, next_label);
     if (label != LABEL_RETURN && label != LABEL_BREAK) {
-      write_inst(self, "br label %%l%lu", next_label);
+      write_jump(self, next_label);
     }
-    write(self, "\n");
 
     write_label(self, else_label);
     label = write_stmt(self, else_syntax, else_label, next_label);
   } else {
     Label then_label = self->block++;
-    write_inst(self, "br i1 %%.t%lu, label %%l%lu, label %%l%lu", cond_temporal, then_label, next_label);
-    write(self, "\n");
+    write_branch(self, cond, then_label, next_label);
 
     write_label(self, then_label);
     label = write_stmt(self, then_syntax, then_label, next_label);
@@ -554,9 +786,8 @@ Label write_if_stmt(Generator *self, const MpplIfStmt *syntax, Label sink)
 
   if (!sink) {
     if (label != LABEL_RETURN && label != LABEL_BREAK) {
-      write_inst(self, "br label %%l%lu", next_label);
+      write_jump(self, next_label);
     }
-    write(self, "\n");
 
     write_label(self, next_label);
   }
@@ -576,28 +807,24 @@ Label write_while_stmt(Generator *self, const MpplWhileStmt *syntax, Label sourc
   Label body_label = self->block++;
   Label next_label = sink ? sink : self->block++;
   Label label;
-
-  Temp cond_temporal = self->temp++;
+  Value cond;
 
   self->break_label = next_label;
 
   if (!source) {
-    write_inst(self, "br label %%l%lu", cond_label);
-    write(self, "\n");
+    write_jump(self, cond_label);
 
     write_label(self, cond_label);
   }
 
-  write_expr(self, cond_temporal, cond_syntax);
-  write_inst(self, "br i1 %%.t%lu, label %%l%lu, label %%l%lu", cond_temporal, body_label, next_label);
-  write(self, "\n");
+  cond = write_expr(self, cond_syntax);
+  write_branch(self, cond, body_label, next_label);
 
   write_label(self, body_label);
   label = write_stmt(self, stmt_syntax, body_label, cond_label);
   if (label != LABEL_RETURN && label != LABEL_BREAK) {
-    write_inst(self, "br label %%l%lu", cond_label);
+    write_jump(self, cond_label);
   }
-  write(self, "\n");
 
   if (!sink) {
     write_label(self, next_label);
@@ -663,6 +890,7 @@ Label write_call_stmt(Generator *self, const MpplCallStmt *syntax)
     mppl_unref(expr_syntax);
   }
   write(self, ")\n");
+  forget_memory(self);
 
   mppl_unref(name_token);
   mppl_unref(param_list_syntax);
@@ -705,6 +933,7 @@ Label write_input_stmt(Generator *self, const MpplInputStmt *syntax)
       default:
         unreachable();
       }
+      forget_memory(self);
 
       mppl_unref(var_syntax);
     }
@@ -726,7 +955,7 @@ Label write_output_stmt(Generator *self, const MpplOutputStmt *syntax)
   MpplToken    *write_token     = mppl_output_stmt__write_token(syntax);
   MpplOutList  *out_list_syntax = mppl_output_stmt__output_list(syntax);
 
-  Array *values = array_new(sizeof(Temp));
+  Array *values = array_new(sizeof(Value));
   Str    format = str();
 
   if (out_list_syntax) {
@@ -739,15 +968,14 @@ Label write_output_stmt(Generator *self, const MpplOutputStmt *syntax)
         const MpplStringLit *string_lit_syntax = (MpplStringLit *) expr_syntax;
 
         char *value  = mppl_lit_string__to_string(string_lit_syntax);
-        Temp  ignore = -1ul;
+        Value ignore = value_constant(0);
         str_push(&format, value);
         array_push(values, &ignore);
         free(value);
       } else {
         MpplNumberLit *number_lit_syntax = mppl_out_value__width(out_value_syntax);
 
-        Temp value = self->temp++;
-        write_expr(self, value, expr_syntax);
+        Value value = write_expr(self, expr_syntax);
         array_push(values, &value);
 
         str_push(&format, "%");
@@ -796,8 +1024,8 @@ Label write_output_stmt(Generator *self, const MpplOutputStmt *syntax)
       const Type   *type             = ctx_type_of(self->ctx, (const SyntaxTree *) expr_syntax, NULL);
 
       if (type_kind(type) != TYPE_STRING) {
-        Temp value = *(Temp *) array_at(values, i);
-        write(self, ", i%lu %%.t%lu", type_width(type), value);
+        const Value *value = array_at(values, i);
+        write(self, ", i%lu %s", type_width(type), value->text);
       }
 
       mppl_unref(expr_syntax);
@@ -825,14 +1053,14 @@ Label write_stmt(Generator *self, const AnyMpplStmt *stmt, Label source, Label s
     return write_while_stmt(self, (const MpplWhileStmt *) stmt, source, sink);
 
   case MPPL_STMT_BREAK:
-    write_inst(self, "br label %%l%lu", self->break_label);
+    write_jump(self, self->break_label);
     return LABEL_BREAK;
 
   case MPPL_STMT_CALL:
     return write_call_stmt(self, (const MpplCallStmt *) stmt);
 
   case MPPL_STMT_RETURN:
-    write_inst(self, "ret void");
+    write_return(self);
     return LABEL_RETURN;
 
   case MPPL_STMT_INPUT:
@@ -849,6 +1077,192 @@ Label write_stmt(Generator *self, const AnyMpplStmt *stmt, Label source, Label s
   }
 }
 
+/* start collecting the blocks of a function, which returns with `ret` */
+static void open_body(Generator *self, const char *ret)
+{
+  self->output      = self->emitter;
+  self->emitter     = emitter_new_sink(&push_chars, self->body);
+  self->first_label = self->block;
+  self->ret         = ret;
+  array_clear(self->body);
+  array_clear(self->blocks);
+  push_block(self, LABEL_NULL, 0);
+}
+
+static long block_index(const Generator *self, const long *blocks_of, Label label)
+{
+  return label >= self->first_label && label < self->block ? blocks_of[label - self->first_label] : -1;
+}
+
+/* the label reached from `label` once blocks that only jump on are skipped */
+static Label thread_label(const Generator *self, const long *blocks_of, Label label)
+{
+  unsigned long steps;
+  for (steps = 0; steps < array_count(self->blocks); ++steps) {
+    long         index = block_index(self, blocks_of, label);
+    const Block *block;
+    if (index <= 0) {
+      break;
+    }
+    block = array_at(self->blocks, index);
+    if (block->begin != block->end || block->term != TERM_JUMP) {
+      break;
+    }
+    label = block->next[0];
+  }
+  return label;
+}
+
+static unsigned long block_successors(const Block *block)
+{
+  switch (block->term) {
+  case TERM_JUMP:
+    return 1;
+
+  case TERM_BRANCH:
+    return 2;
+
+  default:
+    return 0;
+  }
+}
+
+/* write out the blocks collected since `open_body`. jumps to blocks that only jump on
+   are threaded, blocks no longer reached are dropped, and each block is followed by the
+   earliest successor whose other predecessors are already placed, merging the two when
+   one only jumps to the other */
+static void close_body(Generator *self)
+{
+  unsigned long  count     = array_count(self->blocks);
+  long          *blocks_of = xmalloc(sizeof(long) * (self->block - self->first_label + 1));
+  long          *order     = xmalloc(sizeof(long) * (count + 1));
+  unsigned long *waiting   = xmalloc(sizeof(unsigned long) * (count + 1));
+  unsigned long  placed    = 0;
+  unsigned long  cursor    = 0;
+  long           current   = 0;
+  const char    *text;
+  unsigned long  i, j;
+
+  emitter_free(self->emitter);
+  self->emitter = self->output;
+  text          = array_data(self->body);
+
+  for (i = 0; i < self->block - self->first_label; ++i) {
+    blocks_of[i] = -1;
+  }
+  for (i = 0; i < count; ++i) {
+    const Block *block = array_at(self->blocks, i);
+    if (block->label) {
+      blocks_of[block->label - self->first_label] = i;
+    }
+  }
+
+  for (i = 0; i < count; ++i) {
+    Block *block = array_at(self->blocks, i);
+    for (j = 0; j < block_successors(block); ++j) {
+      block->next[j] = thread_label(self, blocks_of, block->next[j]);
+    }
+    if (block->term == TERM_BRANCH && block->next[0] == block->next[1]) {
+      block->term = TERM_JUMP;
+    }
+  }
+  for (i = 0; i < count; ++i) {
+    Block *block = array_at(self->blocks, i);
+    long   index = block->term == TERM_JUMP ? block_index(self, blocks_of, block->next[0]) : -1;
+    if (index > 0) {
+      const Block *target = array_at(self->blocks, index);
+      if (target->begin == target->end && target->term == TERM_RETURN) {
+        block->term = TERM_RETURN;
+      }
+    }
+  }
+
+  /* find the blocks still reached from the entry, using `order` as the stack */
+  ((Block *) array_at(self->blocks, 0))->reachable = 1;
+  order[placed++]                                  = 0;
+  while (placed > 0) {
+    Block *block = array_at(self->blocks, order[--placed]);
+    for (j = 0; j < block_successors(block); ++j) {
+      long index = block_index(self, blocks_of, block->next[j]);
+      if (index >= 0) {
+        Block *target = array_at(self->blocks, index);
+        if (!target->reachable) {
+          target->reachable = 1;
+          order[placed++]   = index;
+        }
+        ++target->preds;
+      }
+    }
+  }
+
+  for (i = 0; i < count; ++i) {
+    waiting[i] = ((Block *) array_at(self->blocks, i))->preds;
+  }
+  while (current >= 0) {
+    Block *block    = array_at(self->blocks, current);
+    block->placed   = 1;
+    order[placed++] = current;
+
+    current = -1;
+    for (j = 0; j < block_successors(block); ++j) {
+      long index = block_index(self, blocks_of, block->next[j]);
+      if (index >= 0) {
+        --waiting[index];
+      }
+    }
+    for (j = 0; j < block_successors(block); ++j) {
+      long index = block_index(self, blocks_of, block->next[j]);
+      if (index >= 0 && !((Block *) array_at(self->blocks, index))->placed && waiting[index] == 0
+        && (current < 0 || index < current)) {
+        current = index;
+      }
+    }
+    while (current < 0 && cursor < count) {
+      const Block *next = array_at(self->blocks, cursor);
+      if (next->reachable && !next->placed) {
+        current = cursor;
+      }
+      ++cursor;
+    }
+  }
+
+  for (i = 0; i < placed; ++i) {
+    const Block *block  = array_at(self->blocks, order[i]);
+    const Block *next   = i + 1 < placed ? array_at(self->blocks, order[i + 1]) : NULL;
+    const Block *before = i > 0 ? array_at(self->blocks, order[i - 1]) : NULL;
+
+    if (before && !(before->term == TERM_JUMP && before->next[0] == block->label && block->preds == 1)) {
+      write(self, "\nl%lu:\n", block->label);
+    }
+    if (block->end > block->begin) {
+      emitter_write(self->emitter, text + block->begin, block->end - block->begin);
+    }
+
+    switch (block->term) {
+    case TERM_JUMP:
+      if (!next || next->label != block->next[0] || next->preds != 1) {
+        write_inst(self, "br label %%l%lu", block->next[0]);
+      }
+      break;
+
+    case TERM_BRANCH:
+      write_inst(self, "br i1 %%.t%lu, label %%l%lu, label %%l%lu", block->cond, block->next[0], block->next[1]);
+      break;
+
+    case TERM_RETURN:
+      write_inst(self, "%s", self->ret);
+      break;
+
+    default:
+      unreachable();
+    }
+  }
+
+  free(blocks_of);
+  free(order);
+  free(waiting);
+}
+
 void visit_var_decl(const MpplAstWalker *self, const MpplVarDecl *syntax, void *generator)
 {
   unsigned long i;
@@ -913,6 +1327,7 @@ void visit_proc_decl(const MpplAstWalker *self, const MpplProcDecl *syntax, void
   }
   write(gen, " {\n");
 
+  open_body(gen, "ret void");
   if (var_decl_part_syntax) {
     for (i = 0; i < mppl_var_decl_part__var_decl_count(var_decl_part_syntax); ++i) {
       MpplVarDecl *var_decl = mppl_var_decl_part__var_decl(var_decl_part_syntax, i);
@@ -937,8 +1352,9 @@ void visit_proc_decl(const MpplAstWalker *self, const MpplProcDecl *syntax, void
   }
   label = write_stmt(gen, (AnyMpplStmt *) stmt_syntax, LABEL_NULL, LABEL_NULL);
   if (label != LABEL_RETURN) {
-    write_inst(gen, "ret void");
+    write_return(gen);
   }
+  close_body(gen);
   write(gen, "}\n");
 
   mppl_unref(name_token);
@@ -977,10 +1393,12 @@ void visit_program(const MpplAstWalker *self, const MpplProgram *syntax, void *g
   }
 
   write(gen, "define i32 @main() {\n");
+  open_body(gen, "ret i32 0");
   label = write_stmt(gen, (const AnyMpplStmt *) stmt_syntax, LABEL_NULL, LABEL_NULL);
   if (label != LABEL_RETURN) {
-    write_inst(gen, "ret i32 0");
+    write_return(gen);
   }
+  close_body(gen);
   write(gen, "}\n");
 
   write(gen, "\n");
@@ -1051,18 +1469,24 @@ int mpplc_codegen_llvm_ir(const Source *source, const MpplProgram *syntax, Ctx *
   MpplAstWalker walker;
 
   Generator self;
-  self.ctx   = ctx;
-  self.temp  = 1;
-  self.block = 1;
-  self.strs  = array_new(sizeof(Str));
+  self.ctx         = ctx;
+  self.temp        = 1;
+  self.block       = 1;
+  self.strs        = array_new(sizeof(Str));
+  self.body        = array_new(sizeof(char));
+  self.blocks      = array_new(sizeof(Block));
+  self.key         = array_new(sizeof(char));
+  self.key_emitter = emitter_new_sink(&push_chars, self.key);
+  numbering_init(&self.pure);
+  numbering_init(&self.memory);
   {
     char *output_filename = xmalloc(sizeof(char) * (source->file_name_length + 1));
     sprintf(output_filename, "%.*s.ll", (int) source->file_name_length - 4, source->file_name);
-    self.file = fopen(output_filename, "w");
+    self.emitter = emitter_new_file(output_filename);
     free(output_filename);
   }
 
-  if (!self.file) {
+  if (!self.emitter) {
     fprintf(stderr, "error: failed to open output file\n");
     return 0;
   }
@@ -1078,6 +1502,15 @@ int mpplc_codegen_llvm_ir(const Source *source, const MpplProgram *syntax, Ctx *
   }
 
   array_free(self.strs);
-  fclose(self.file);
+  array_free(self.body);
+  array_free(self.blocks);
+  numbering_deinit(&self.pure);
+  numbering_deinit(&self.memory);
+  emitter_free(self.key_emitter);
+  array_free(self.key);
+  if (!emitter_free(self.emitter)) {
+    fprintf(stderr, "error: failed to write output file\n");
+    return 0;
+  }
   return 1;
 }
@@ -48,7 +48,17 @@ int mpplc_resolve(const Source *source, const MpplProgram *syntax, Ctx *ctx);
 
 int mpplc_check(const Source *source, const MpplProgram *syntax, Ctx *ctx);
 
-int mpplc_codegen_casl2(const Source *source, const MpplProgram *syntax, Ctx *ctx);
+int mpplc_check_parallel(const Source *source, const MpplProgram *syntax, Ctx *ctx, unsigned long thread_count);
+
+int mpplc_resolve_and_check(const Source *source, const MpplProgram *syntax, Ctx *ctx);
+
+typedef struct Casl2Option Casl2Option;
+
+struct Casl2Option {
+  int peephole;
+};
+
+int mpplc_codegen_casl2(const Source *source, const MpplProgram *syntax, Ctx *ctx, const Casl2Option *option);
 
 int mpplc_codegen_llvm_ir(const Source *source, const MpplProgram *syntax, Ctx *ctx);
 
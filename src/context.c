@@ -14,6 +14,7 @@
    limitations under the License.
 */
 
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,15 +23,19 @@
 #include "array.h"
 #include "context.h"
 #include "context_fwd.h"
+#include "interner.h"
 #include "map.h"
+#include "mutex.h"
 #include "string.h"
+#include "string_builder.h"
 #include "syntax_tree.h"
 #include "utility.h"
 
-struct String {
-  const char   *data;
-  unsigned long length;
-};
+#define TYPE_NONE          0
+#define TYPE_STD_END       5
+#define TYPE_SEGMENT_SIZE  64
+#define TYPE_SEGMENT_COUNT 32
+#define CONST_NONE         LONG_MIN
 
 struct TypeList {
   const Type  **types;
@@ -39,16 +44,19 @@ struct TypeList {
 
 struct Type {
   TypeKind kind;
+  TypeId   id;
 };
 
 struct ArrayType {
   TypeKind      kind;
+  TypeId        id;
   const Type   *base;
   unsigned long length;
 };
 
 struct ProcType {
   TypeKind        kind;
+  TypeId          id;
   const TypeList *params;
 };
 
@@ -58,213 +66,251 @@ struct Def {
   const SyntaxTree *syntax;
 };
 
-struct Ctx {
-  Map   *strings;
-  Map   *type_lists;
-  Map   *types;
-  Array *defs;
-  Map   *resolved;
-  Map   *syntax_type;
+struct Call {
+  const Def        *caller;
+  const Def        *callee;
+  const SyntaxTree *syntax;
 };
 
-static const TypeList CTX_TYPE_LIST_EMPTY = { NULL, 0 };
+typedef struct ArrayTypeKey ArrayTypeKey;
 
-static const Type CTX_TYPE_BOOLEAN = { TYPE_BOOLEAN };
-static const Type CTX_TYPE_CHAR    = { TYPE_CHAR };
-static const Type CTX_TYPE_INTEGER = { TYPE_INTEGER };
-static const Type CTX_TYPE_STRING  = { TYPE_STRING };
+struct ArrayTypeKey {
+  TypeId        base;
+  unsigned long length;
+};
 
-static unsigned long string_hash(const void *value)
+static unsigned long array_type_key_hash(ArrayTypeKey key)
 {
-  const String *x = value;
-  return fnv1a(FNV1A_INIT, x->data, x->length);
+  return hash_bytes(hash_bytes(HASH_INIT, &key.base, sizeof(key.base)), &key.length, sizeof(key.length));
 }
 
-static int string_equal(const void *left, const void *right)
+static int array_type_key_equal(ArrayTypeKey left, ArrayTypeKey right)
 {
-  const String *l = left;
-  const String *r = right;
-  return l->length == r->length && memcmp(l->data, r->data, l->length) == 0;
+  return left.base == right.base && left.length == right.length;
 }
 
-static unsigned long type_list_hash_core(unsigned long hash, const TypeList *list);
-static unsigned long type_hash_core(unsigned long hash, const Type *type);
+/* element types are canonical, so lists are equal exactly when their element pointers are */
+static unsigned long type_list_hash(const TypeList *list)
+{
+  return hash_bytes(HASH_INIT, list->types, sizeof(Type *) * list->length);
+}
 
-static unsigned long type_list_hash_core(unsigned long hash, const TypeList *list)
+static int type_list_equal(const TypeList *left, const TypeList *right)
 {
-  unsigned long i;
-  for (i = 0; i < list->length; i++) {
-    hash = type_hash_core(hash, list->types[i]);
-  }
-  return hash;
+  return left->length == right->length && !memcmp(left->types, right->types, sizeof(Type *) * left->length);
 }
 
-static unsigned long type_hash_core(unsigned long hash, const Type *type)
+static unsigned long type_list_ptr_hash(const TypeList *list)
 {
-  hash = fnv1a(hash, &type->kind, sizeof(type->kind));
-  switch (type->kind) {
-  case TYPE_ARRAY: {
-    const ArrayType *array = (const ArrayType *) type;
-    hash                   = type_hash_core(hash, array->base);
-    hash                   = fnv1a(hash, &array->length, sizeof(array->length));
-    return hash;
-  }
-  case TYPE_PROC: {
-    const ProcType *proc = (const ProcType *) type;
-    hash                 = type_list_hash_core(hash, proc->params);
-    return hash;
-  }
-  default:
-    return hash;
-  }
+  return hash_pointer(list);
+}
+
+static int type_list_ptr_equal(const TypeList *left, const TypeList *right)
+{
+  return left == right;
 }
 
-static unsigned long type_list_hash(const void *value)
+DEFINE_ARRAY(DefArray, def_array, const Def *)
+DEFINE_ARRAY(TypeIdArray, type_id_array, TypeId)
+DEFINE_ARRAY(TypeListArray, type_list_array, TypeList *)
+DEFINE_ARRAY(CallArray, call_array, Call)
+DEFINE_ARRAY(ConstArray, const_array, long)
+DEFINE_MAP(ArrayTypeMap, array_type_map, ArrayTypeKey, TypeId, array_type_key_hash, array_type_key_equal)
+DEFINE_MAP(ProcTypeMap, proc_type_map, const TypeList *, TypeId, type_list_ptr_hash, type_list_ptr_equal)
+DEFINE_MAP(TypeListMap, type_list_map, const TypeList *, const TypeList *, type_list_hash, type_list_equal)
+
+/* every canonical type has a `TypeId` indexing `type_segments`, where segment `s`
+   holds TYPE_SEGMENT_SIZE << s types. segments never move once allocated, so
+   types can be looked up while others are interned under `types_lock` */
+struct Ctx {
+  Interner     *interner;
+  int           owns_interner;
+  Mutex         types_lock;
+  const Type  **type_segments[TYPE_SEGMENT_COUNT];
+  unsigned long type_count;
+  ArrayTypeMap  array_types;
+  ProcTypeMap   proc_types;
+  TypeListMap   type_lists;
+  TypeListArray owned_type_lists;
+  Array        *defs;
+  DefArray      resolved;
+  TypeIdArray   syntax_type;
+  ConstArray    syntax_const;
+  CallArray     calls;
+};
+
+static const TypeList CTX_TYPE_LIST_EMPTY = { NULL, 0 };
+
+static const Type CTX_TYPE_BOOLEAN = { TYPE_BOOLEAN, 1 };
+static const Type CTX_TYPE_CHAR    = { TYPE_CHAR, 2 };
+static const Type CTX_TYPE_INTEGER = { TYPE_INTEGER, 3 };
+static const Type CTX_TYPE_STRING  = { TYPE_STRING, 4 };
+
+static unsigned long type_segment_size(unsigned long segment)
 {
-  return type_list_hash_core(FNV1A_INIT, value);
+  return (unsigned long) TYPE_SEGMENT_SIZE << segment;
 }
 
-static int type_list_equal(const void *left, const void *right)
+static unsigned long type_segment(TypeId id, unsigned long *offset)
 {
-  const TypeList *l = left;
-  const TypeList *r = right;
+  unsigned long segment = 0;
+  *offset               = id;
+  while (*offset >= type_segment_size(segment)) {
+    *offset -= type_segment_size(segment);
+    ++segment;
+  }
+  return segment;
+}
 
-  if (l->length != r->length) {
-    return 0;
-  } else if (l->length == 0) {
-    return 1;
+static const Type *ctx_type_at(const Ctx *ctx, TypeId id)
+{
+  if (id) {
+    unsigned long offset;
+    unsigned long segment = type_segment(id, &offset);
+    return ctx->type_segments[segment][offset];
   } else {
-    return !memcmp(l->types, r->types, sizeof(Type *) * l->length);
+    return NULL;
   }
 }
 
-static unsigned long type_hash(const void *value)
+static void ctx_add_type(Ctx *ctx, const Type *type)
 {
-  return type_hash_core(FNV1A_INIT, value);
+  unsigned long offset;
+  unsigned long segment = type_segment(ctx->type_count++, &offset);
+  if (!ctx->type_segments[segment]) {
+    ctx->type_segments[segment] = xmalloc(sizeof(Type *) * type_segment_size(segment));
+  }
+  ctx->type_segments[segment][offset] = type;
 }
 
-static int type_equal(const void *left, const void *right)
+static void ctx_register_builtins(Ctx *ctx)
 {
-  const Type *l = left;
-  const Type *r = right;
-  if (l->kind != r->kind) {
-    return 0;
+  ctx->type_count = 0;
+  ctx_add_type(ctx, NULL);
+  ctx_add_type(ctx, &CTX_TYPE_BOOLEAN);
+  ctx_add_type(ctx, &CTX_TYPE_CHAR);
+  ctx_add_type(ctx, &CTX_TYPE_INTEGER);
+  ctx_add_type(ctx, &CTX_TYPE_STRING);
+}
+
+static void ctx_free_types(Ctx *ctx)
+{
+  unsigned long i;
+  for (i = TYPE_STD_END; i < ctx->type_count; ++i) {
+    free((Type *) ctx_type_at(ctx, i));
   }
-  switch (l->kind) {
-  case TYPE_ARRAY: {
-    const ArrayType *larray = (const ArrayType *) l;
-    const ArrayType *rarray = (const ArrayType *) r;
-    return larray->base == rarray->base && larray->length == rarray->length;
+  for (i = 0; i < type_list_array_count(&ctx->owned_type_lists); ++i) {
+    TypeList *list = *type_list_array_at(&ctx->owned_type_lists, i);
+    free(list->types);
+    free(list);
   }
-  case TYPE_PROC: {
-    const ProcType *lproc = (const ProcType *) l;
-    const ProcType *rproc = (const ProcType *) r;
-    return type_list_equal(lproc->params, rproc->params);
+}
+
+static void ctx_free_defs(Ctx *ctx)
+{
+  unsigned long i;
+  for (i = 0; i < array_count(ctx->defs); i++) {
+    Def *def = *(Def **) array_at(ctx->defs, i);
+    syntax_tree_unref(def->syntax);
+    free(def);
   }
-  default:
-    return 1;
+}
+
+static void ctx_free_calls(Ctx *ctx)
+{
+  unsigned long i;
+  for (i = 0; i < call_array_count(&ctx->calls); i++) {
+    syntax_tree_unref(call_array_at(&ctx->calls, i)->syntax);
   }
 }
 
 Ctx *ctx_new(void)
 {
-  Ctx *ctx         = xmalloc(sizeof(Ctx));
-  ctx->strings     = map_new(&string_hash, &string_equal);
-  ctx->type_lists  = map_new(&type_list_hash, &type_list_equal);
-  ctx->types       = map_new(&type_hash, &type_equal);
-  ctx->defs        = array_new(sizeof(Def *));
-  ctx->resolved    = map_new(NULL, NULL);
-  ctx->syntax_type = map_new(NULL, NULL);
-
-  {
-    MapIndex index;
-
-    map_entry(ctx->type_lists, (void *) &CTX_TYPE_LIST_EMPTY, &index);
-    map_update(ctx->type_lists, &index, (void *) &CTX_TYPE_LIST_EMPTY, NULL);
+  Ctx *ctx           = ctx_new_with_interner(interner_new());
+  ctx->owns_interner = 1;
+  return ctx;
+}
 
-    map_entry(ctx->types, (void *) &CTX_TYPE_BOOLEAN, &index);
-    map_update(ctx->types, &index, (void *) &CTX_TYPE_BOOLEAN, NULL);
+Ctx *ctx_new_with_interner(Interner *interner)
+{
+  Ctx *ctx           = xmalloc(sizeof(Ctx));
+  ctx->interner      = interner;
+  ctx->owns_interner = 0;
+  ctx->defs          = array_new(sizeof(Def *));
+  memset(ctx->type_segments, 0, sizeof(ctx->type_segments));
+  mutex_init(&ctx->types_lock);
+  array_type_map_init(&ctx->array_types);
+  proc_type_map_init(&ctx->proc_types);
+  type_list_map_init(&ctx->type_lists);
+  type_list_array_init(&ctx->owned_type_lists);
+  def_array_init(&ctx->resolved);
+  type_id_array_init(&ctx->syntax_type);
+  const_array_init(&ctx->syntax_const);
+  call_array_init(&ctx->calls);
+  ctx_register_builtins(ctx);
+  return ctx;
+}
 
-    map_entry(ctx->types, (void *) &CTX_TYPE_CHAR, &index);
-    map_update(ctx->types, &index, (void *) &CTX_TYPE_CHAR, NULL);
+void ctx_reset(Ctx *ctx)
+{
+  ctx_free_defs(ctx);
+  array_clear(ctx->defs);
+  def_array_clear(&ctx->resolved);
+  type_id_array_clear(&ctx->syntax_type);
+  const_array_clear(&ctx->syntax_const);
+  ctx_free_calls(ctx);
+  call_array_clear(&ctx->calls);
 
-    map_entry(ctx->types, (void *) &CTX_TYPE_INTEGER, &index);
-    map_update(ctx->types, &index, (void *) &CTX_TYPE_INTEGER, NULL);
+  ctx_free_types(ctx);
+  array_type_map_clear(&ctx->array_types);
+  proc_type_map_clear(&ctx->proc_types);
+  type_list_map_clear(&ctx->type_lists);
+  type_list_array_clear(&ctx->owned_type_lists);
+  ctx_register_builtins(ctx);
 
-    map_entry(ctx->types, (void *) &CTX_TYPE_STRING, &index);
-    map_update(ctx->types, &index, (void *) &CTX_TYPE_STRING, NULL);
+  if (ctx->owns_interner) {
+    interner_reset(ctx->interner);
   }
-
-  return ctx;
 }
 
 void ctx_free(Ctx *ctx)
 {
   if (ctx) {
     unsigned long i;
-    MapIndex      index;
-
-    for (map_iterator(ctx->strings, &index); map_next(ctx->strings, &index);) {
-      if (map_value(ctx->strings, &index)) {
-        String *string = map_key(ctx->strings, &index);
-        free((void *) string->data);
-        free(string);
-      }
+    if (ctx->owns_interner) {
+      interner_free(ctx->interner);
     }
-    map_free(ctx->strings);
 
-    for (map_iterator(ctx->type_lists, &index); map_next(ctx->type_lists, &index);) {
-      if (map_value(ctx->type_lists, &index)) {
-        TypeList *list = map_key(ctx->type_lists, &index);
-        free(list->types);
-        free(list);
-      }
+    ctx_free_types(ctx);
+    for (i = 0; i < TYPE_SEGMENT_COUNT; ++i) {
+      free(ctx->type_segments[i]);
     }
-    map_free(ctx->type_lists);
+    array_type_map_deinit(&ctx->array_types);
+    proc_type_map_deinit(&ctx->proc_types);
+    type_list_map_deinit(&ctx->type_lists);
+    type_list_array_deinit(&ctx->owned_type_lists);
+    mutex_deinit(&ctx->types_lock);
 
-    for (map_iterator(ctx->types, &index); map_next(ctx->types, &index);) {
-      if (map_value(ctx->types, &index)) {
-        Type *type = map_key(ctx->types, &index);
-        free(type);
-      }
-    }
-    map_free(ctx->types);
-
-    for (i = 0; i < array_count(ctx->defs); i++) {
-      Def *def = *(Def **) array_at(ctx->defs, i);
-      syntax_tree_unref(def->syntax);
-      free(def);
-    }
+    ctx_free_defs(ctx);
     array_free(ctx->defs);
 
-    map_free(ctx->resolved);
-    map_free(ctx->syntax_type);
+    def_array_deinit(&ctx->resolved);
+    type_id_array_deinit(&ctx->syntax_type);
+    const_array_deinit(&ctx->syntax_const);
+    ctx_free_calls(ctx);
+    call_array_deinit(&ctx->calls);
     free(ctx);
   }
 }
 
 const String *ctx_string(Ctx *ctx, const char *data, unsigned long length)
 {
-  MapIndex index;
-
-  String string;
-  string.data   = data;
-  string.length = length;
-
-  if (map_entry(ctx->strings, &string, &index)) {
-    return map_key(ctx->strings, &index);
-  } else {
-    String *instance = xmalloc(sizeof(String));
-    char   *ndata    = xmalloc(length + 1);
-
-    memcpy(ndata, data, length);
-    ndata[length] = '\0';
+  return interner_intern(ctx->interner, data, length);
+}
 
-    instance->length = length;
-    instance->data   = ndata;
-    map_update(ctx->strings, &index, instance, instance);
-    return instance;
-  }
+void ctx_stats(const Ctx *ctx, CtxStats *stats)
+{
+  interner_stats(ctx->interner, &stats->string_count, &stats->string_bytes, &stats->string_reserved);
 }
 
 const Type *ctx_type(TypeKind kind)
@@ -285,37 +331,48 @@ const Type *ctx_type(TypeKind kind)
 
 const Type *ctx_array_type(Ctx *ctx, const Type *base, unsigned long length)
 {
-  MapIndex index;
-
-  ArrayType type;
-  type.kind   = TYPE_ARRAY;
-  type.base   = base;
-  type.length = length;
+  ArrayTypeMapIndex index;
+  ArrayTypeKey      key;
+  const Type       *result;
+  key.base   = base->id;
+  key.length = length;
 
-  if (map_entry(ctx->types, &type, &index)) {
-    return map_key(ctx->types, &index);
+  mutex_lock(&ctx->types_lock);
+  if (array_type_map_entry(&ctx->array_types, key, &index)) {
+    result = ctx_type_at(ctx, array_type_map_value(&ctx->array_types, &index));
   } else {
-    ArrayType *instance = dup(&type, sizeof(ArrayType), 1);
-    map_update(ctx->types, &index, instance, instance);
-    return (Type *) instance;
+    ArrayType *instance = xmalloc(sizeof(ArrayType));
+    instance->kind      = TYPE_ARRAY;
+    instance->id        = ctx->type_count;
+    instance->base      = base;
+    instance->length    = length;
+    ctx_add_type(ctx, (Type *) instance);
+    array_type_map_update(&ctx->array_types, &index, key, instance->id);
+    result = (Type *) instance;
   }
+  mutex_unlock(&ctx->types_lock);
+  return result;
 }
 
 const Type *ctx_proc_type(Ctx *ctx, const TypeList *params)
 {
-  MapIndex index;
-
-  ProcType type;
-  type.kind   = TYPE_PROC;
-  type.params = params;
+  ProcTypeMapIndex index;
+  const Type      *result;
 
-  if (map_entry(ctx->types, &type, &index)) {
-    return map_key(ctx->types, &index);
+  mutex_lock(&ctx->types_lock);
+  if (proc_type_map_entry(&ctx->proc_types, params, &index)) {
+    result = ctx_type_at(ctx, proc_type_map_value(&ctx->proc_types, &index));
   } else {
-    ProcType *instance = dup(&type, sizeof(ProcType), 1);
-    map_update(ctx->types, &index, instance, instance);
-    return (Type *) instance;
+    ProcType *instance = xmalloc(sizeof(ProcType));
+    instance->kind     = TYPE_PROC;
+    instance->id       = ctx->type_count;
+    instance->params   = params;
+    ctx_add_type(ctx, (Type *) instance);
+    proc_type_map_update(&ctx->proc_types, &index, params, instance->id);
+    result = (Type *) instance;
   }
+  mutex_unlock(&ctx->types_lock);
+  return result;
 }
 
 const TypeList *ctx_type_list(Ctx *ctx, const Type **types, unsigned long length)
@@ -329,20 +386,25 @@ const TypeList *ctx_take_type_list(Ctx *ctx, const Type **types, unsigned long l
   if (length == 0) {
     return &CTX_TYPE_LIST_EMPTY;
   } else {
-    MapIndex index;
+    TypeListMapIndex index;
+    const TypeList  *result;
 
     TypeList list;
     list.types  = types;
     list.length = length;
 
-    if (map_entry(ctx->type_lists, &list, &index)) {
+    mutex_lock(&ctx->types_lock);
+    if (type_list_map_entry(&ctx->type_lists, &list, &index)) {
       free(types);
-      return map_key(ctx->type_lists, &index);
+      result = type_list_map_value(&ctx->type_lists, &index);
     } else {
       TypeList *instance = dup(&list, sizeof(TypeList), 1);
-      map_update(ctx->type_lists, &index, instance, instance);
-      return instance;
+      type_list_map_update(&ctx->type_lists, &index, instance, instance);
+      type_list_array_push(&ctx->owned_type_lists, instance);
+      result = instance;
     }
+    mutex_unlock(&ctx->types_lock);
+    return result;
   }
 }
 
@@ -358,54 +420,86 @@ const Def *ctx_define(Ctx *ctx, DefKind kind, const String *name, const SyntaxTr
 
 const Def *ctx_resolve(Ctx *ctx, const SyntaxTree *syntax, const Def *def)
 {
-  MapIndex index;
-
-  const RawSyntaxNode *node = syntax_tree_raw(syntax);
+  unsigned long id = syntax_tree_raw(syntax)->id;
   if (def) {
-    if (map_entry(ctx->resolved, (void *) node, &index)) {
+    const Def **slot;
+    def_array_fill(&ctx->resolved, id + 1, NULL);
+    slot = def_array_at(&ctx->resolved, id);
+    if (*slot) {
       unreachable();
     } else {
-      map_update(ctx->resolved, &index, (void *) node, (void *) def);
+      *slot = def;
       return def;
     }
   } else {
-    if (map_entry(ctx->resolved, (void *) node, &index)) {
-      return map_value(ctx->resolved, &index);
-    } else {
-      return NULL;
-    }
+    return id < def_array_count(&ctx->resolved) ? *def_array_at(&ctx->resolved, id) : NULL;
   }
 }
 
-const Type *ctx_type_of(const Ctx *ctx, const SyntaxTree *syntax, const Type *type)
+/* covers every id below `id_end` in the side tables up front, so that recording
+   an entry afterwards never moves them */
+void ctx_reserve(Ctx *ctx, unsigned long id_end)
 {
-  MapIndex index;
+  def_array_fill(&ctx->resolved, id_end, NULL);
+  type_id_array_fill(&ctx->syntax_type, id_end, TYPE_NONE);
+  const_array_fill(&ctx->syntax_const, id_end, CONST_NONE);
+}
 
-  const RawSyntaxNode *node = syntax_tree_raw(syntax);
+const Type *ctx_type_of(Ctx *ctx, const SyntaxTree *syntax, const Type *type)
+{
+  unsigned long id = syntax_tree_raw(syntax)->id;
   if (type) {
-    if (map_entry(ctx->syntax_type, (void *) node, &index)) {
+    TypeId *slot;
+    type_id_array_fill(&ctx->syntax_type, id + 1, TYPE_NONE);
+    slot = type_id_array_at(&ctx->syntax_type, id);
+    if (*slot) {
       unreachable();
     } else {
-      map_update(ctx->syntax_type, &index, (void *) node, (void *) type);
+      *slot = type->id;
       return type;
     }
   } else {
-    if (map_entry(ctx->syntax_type, (void *) node, &index)) {
-      return map_value(ctx->syntax_type, &index);
-    } else {
-      return NULL;
-    }
+    return id < type_id_array_count(&ctx->syntax_type) ? ctx_type_at(ctx, *type_id_array_at(&ctx->syntax_type, id)) : NULL;
+  }
+}
+
+/* records the value the checker computed for a constant expression. booleans are 0 or 1
+   and characters are their codes */
+void ctx_fold(Ctx *ctx, const SyntaxTree *syntax, long value)
+{
+  unsigned long id = syntax_tree_raw(syntax)->id;
+  const_array_fill(&ctx->syntax_const, id + 1, CONST_NONE);
+  *const_array_at(&ctx->syntax_const, id) = value;
+}
+
+int ctx_folded(const Ctx *ctx, const SyntaxTree *syntax, long *value)
+{
+  unsigned long id = syntax_tree_raw(syntax)->id;
+  if (id < const_array_count(&ctx->syntax_const) && *const_array_at(&ctx->syntax_const, id) != CONST_NONE) {
+    *value = *const_array_at(&ctx->syntax_const, id);
+    return 1;
+  } else {
+    return 0;
   }
 }
 
-const char *string_data(const String *string)
+void ctx_call(Ctx *ctx, const Def *caller, const Def *callee, const SyntaxTree *syntax)
 {
-  return string->data;
+  Call call;
+  call.caller = caller;
+  call.callee = callee;
+  call.syntax = syntax_tree_ref(syntax);
+  call_array_push(&ctx->calls, call);
 }
 
-unsigned long string_length(const String *string)
+unsigned long ctx_call_count(const Ctx *ctx)
 {
-  return string->length;
+  return call_array_count(&ctx->calls);
+}
+
+const Call *ctx_call_at(const Ctx *ctx, unsigned long index)
+{
+  return call_array_at(&ctx->calls, index);
 }
 
 const Type *type_list_at(const TypeList *list, unsigned long index)
@@ -428,35 +522,39 @@ int type_is_std(const Type *type)
   return type->kind == TYPE_BOOLEAN || type->kind == TYPE_CHAR || type->kind == TYPE_INTEGER;
 }
 
-static unsigned long type_to_string_core(FILE *stream, const Type *type)
+static void type_to_string_core(StringBuilder *builder, const Type *type)
 {
   switch (type->kind) {
   case TYPE_BOOLEAN:
-    return fprintf(stream, "boolean");
+    string_builder_printf(builder, "boolean");
+    break;
   case TYPE_CHAR:
-    return fprintf(stream, "char");
+    string_builder_printf(builder, "char");
+    break;
   case TYPE_INTEGER:
-    return fprintf(stream, "integer");
+    string_builder_printf(builder, "integer");
+    break;
   case TYPE_STRING:
-    return fprintf(stream, "string");
+    string_builder_printf(builder, "string");
+    break;
   case TYPE_ARRAY: {
     const ArrayType *array = (const ArrayType *) type;
-    unsigned long    count = fprintf(stream, "array[%lu] of", array->length);
-    count += type_to_string_core(stream, array->base);
-    return count;
+    string_builder_printf(builder, "array[%lu] of", array->length);
+    type_to_string_core(builder, array->base);
+    break;
   }
   case TYPE_PROC: {
-    const ProcType *proc  = (const ProcType *) type;
-    unsigned long   count = fprintf(stream, "procedure(");
+    const ProcType *proc = (const ProcType *) type;
     unsigned long   i;
+    string_builder_printf(builder, "procedure(");
     for (i = 0; i < proc->params->length; i++) {
       if (i > 0) {
-        count += fprintf(stream, ", ");
+        string_builder_printf(builder, ", ");
       }
-      count += type_to_string_core(stream, proc->params->types[i]);
+      type_to_string_core(builder, proc->params->types[i]);
     }
-    count += fprintf(stream, ")");
-    return count;
+    string_builder_printf(builder, ")");
+    break;
   }
   default:
     unreachable();
@@ -465,14 +563,9 @@ static unsigned long type_to_string_core(FILE *stream, const Type *type)
 
 char *type_to_string(const Type *type)
 {
-  FILE         *stream = tmpfile();
-  unsigned long length = type_to_string_core(stream, type);
-  char         *result = xmalloc(length + 1);
-  fseek(stream, 0, SEEK_SET);
-  fread(result, 1, length, stream);
-  result[length] = '\0';
-  fclose(stream);
-  return result;
+  StringBuilder *builder = string_builder_new();
+  type_to_string_core(builder, type);
+  return string_builder_steal(builder);
 }
 
 const Type *array_type_base(const ArrayType *type)
@@ -504,3 +597,18 @@ const SyntaxTree *def_syntax(const Def *def)
 {
   return def->syntax;
 }
+
+const Def *call_caller(const Call *call)
+{
+  return call->caller;
+}
+
+const Def *call_callee(const Call *call)
+{
+  return call->callee;
+}
+
+const SyntaxTree *call_syntax(const Call *call)
+{
+  return call->syntax;
+}
@@ -18,10 +18,21 @@
 #define CONTEXT_H
 
 #include "context_fwd.h"
+#include "interner.h"
 #include "syntax_tree.h"
 
+typedef struct CtxStats CtxStats;
+
+struct CtxStats {
+  unsigned long string_count;
+  unsigned long string_bytes;
+  unsigned long string_reserved;
+};
+
 Ctx            *ctx_new(void);
+Ctx            *ctx_new_with_interner(Interner *interner);
 void            ctx_free(Ctx *ctx);
+void            ctx_reset(Ctx *ctx);
 const String   *ctx_string(Ctx *ctx, const char *data, unsigned long length);
 const Type     *ctx_array_type(Ctx *ctx, const Type *base, unsigned long length);
 const Type     *ctx_proc_type(Ctx *ctx, const TypeList *params);
@@ -30,7 +41,14 @@ const TypeList *ctx_type_list(Ctx *ctx, const Type **types, unsigned long length
 const TypeList *ctx_take_type_list(Ctx *ctx, const Type **types, unsigned long length);
 const Def      *ctx_define(Ctx *ctx, DefKind kind, const String *name, const SyntaxTree *syntax);
 const Def      *ctx_resolve(Ctx *ctx, const SyntaxTree *syntax, const Def *def);
-const Type     *ctx_type_of(const Ctx *ctx, const SyntaxTree *syntax, const Type *type);
+const Type     *ctx_type_of(Ctx *ctx, const SyntaxTree *syntax, const Type *type);
+void            ctx_reserve(Ctx *ctx, unsigned long id_end);
+void            ctx_fold(Ctx *ctx, const SyntaxTree *syntax, long value);
+int             ctx_folded(const Ctx *ctx, const SyntaxTree *syntax, long *value);
+void            ctx_call(Ctx *ctx, const Def *caller, const Def *callee, const SyntaxTree *syntax);
+unsigned long   ctx_call_count(const Ctx *ctx);
+const Call     *ctx_call_at(const Ctx *ctx, unsigned long index);
+void            ctx_stats(const Ctx *ctx, CtxStats *stats);
 
 const char   *string_data(const String *string);
 unsigned long string_length(const String *string);
@@ -51,4 +69,8 @@ DefKind           def_kind(const Def *def);
 const String     *def_name(const Def *def);
 const SyntaxTree *def_syntax(const Def *def);
 
+const Def        *call_caller(const Call *call);
+const Def        *call_callee(const Call *call);
+const SyntaxTree *call_syntax(const Call *call);
+
 #endif
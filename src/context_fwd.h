@@ -34,12 +34,16 @@ typedef enum {
   DEF_LOCAL
 } DefKind;
 
+/* index of a canonical type in its `Ctx`, where 0 stands for no type */
+typedef unsigned int TypeId;
+
 typedef struct String    String;
 typedef struct TypeList  TypeList;
 typedef struct Type      Type;
 typedef struct ArrayType ArrayType;
 typedef struct ProcType  ProcType;
 typedef struct Def       Def;
+typedef struct Call      Call;
 typedef struct Ctx       Ctx;
 
 #endif
@@ -0,0 +1,270 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emitter.h"
+#include "utility.h"
+
+#define EMITTER_BUFFER_SIZE 65536
+
+struct Emitter {
+  EmitterSink  *sink;
+  void         *data;
+  FILE         *stream;
+  int           owns_stream;
+  int           ok;
+  unsigned long length;
+  char          buffer[EMITTER_BUFFER_SIZE];
+};
+
+static int stream_sink(void *data, const char *bytes, unsigned long length)
+{
+  return fwrite(bytes, 1, length, data) == length;
+}
+
+Emitter *emitter_new_sink(EmitterSink *sink, void *data)
+{
+  Emitter *emitter     = xmalloc(sizeof(Emitter));
+  emitter->sink        = sink;
+  emitter->data        = data;
+  emitter->stream      = NULL;
+  emitter->owns_stream = 0;
+  emitter->ok          = 1;
+  emitter->length      = 0;
+  return emitter;
+}
+
+Emitter *emitter_new_stream(FILE *stream)
+{
+  Emitter *emitter = emitter_new_sink(&stream_sink, stream);
+  emitter->stream  = stream;
+  return emitter;
+}
+
+Emitter *emitter_new_file(const char *filename)
+{
+  FILE *file = fopen(filename, "w");
+  if (file) {
+    Emitter *emitter = emitter_new_stream(file);
+    /* chunks are already large, so let each one go straight to the file */
+    setvbuf(file, NULL, _IONBF, 0);
+    emitter->owns_stream = 1;
+    return emitter;
+  } else {
+    return NULL;
+  }
+}
+
+int emitter_free(Emitter *emitter)
+{
+  int ok = 1;
+  if (emitter) {
+    emitter_flush(emitter);
+    if (emitter->owns_stream && fclose(emitter->stream)) {
+      emitter->ok = 0;
+    }
+    ok = emitter->ok;
+    free(emitter);
+  }
+  return ok;
+}
+
+void emitter_flush(Emitter *emitter)
+{
+  if (emitter->length) {
+    if (emitter->ok && !emitter->sink(emitter->data, emitter->buffer, emitter->length)) {
+      emitter->ok = 0;
+    }
+    emitter->length = 0;
+  }
+  if (emitter->stream && fflush(emitter->stream)) {
+    emitter->ok = 0;
+  }
+}
+
+void emitter_write(Emitter *emitter, const char *data, unsigned long length)
+{
+  if (length > EMITTER_BUFFER_SIZE - emitter->length) {
+    emitter_flush(emitter);
+    if (length >= EMITTER_BUFFER_SIZE) {
+      if (emitter->ok && !emitter->sink(emitter->data, data, length)) {
+        emitter->ok = 0;
+      }
+      return;
+    }
+  }
+  memcpy(emitter->buffer + emitter->length, data, length);
+  emitter->length += length;
+}
+
+void emitter_puts(Emitter *emitter, const char *string)
+{
+  emitter_write(emitter, string, strlen(string));
+}
+
+void emitter_putc(Emitter *emitter, int c)
+{
+  if (emitter->length == EMITTER_BUFFER_SIZE) {
+    emitter_flush(emitter);
+  }
+  emitter->buffer[emitter->length++] = (char) c;
+}
+
+void emitter_pad(Emitter *emitter, unsigned long count)
+{
+  while (count--) {
+    emitter_putc(emitter, ' ');
+  }
+}
+
+void emitter_ulong(Emitter *emitter, unsigned long value)
+{
+  char buf[21];
+  emitter_write(emitter, buf, format_ulong(buf, value));
+}
+
+void emitter_long(Emitter *emitter, long value)
+{
+  if (value < 0) {
+    emitter_putc(emitter, '-');
+    emitter_ulong(emitter, 0ul - (unsigned long) value);
+  } else {
+    emitter_ulong(emitter, value);
+  }
+}
+
+void emitter_printf(Emitter *emitter, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  emitter_vprintf(emitter, format, args);
+  va_end(args);
+}
+
+void emitter_vprintf(Emitter *emitter, const char *format, va_list args)
+{
+  while (*format) {
+    const char   *start     = format;
+    int           left      = 0;
+    int           is_long   = 0;
+    unsigned long width     = 0;
+    long          precision = -1;
+    char          digits[22];
+    const char   *string = digits;
+    unsigned long length;
+
+    while (*format && *format != '%') {
+      ++format;
+    }
+    emitter_write(emitter, start, format - start);
+    if (!*format) {
+      break;
+    }
+
+    ++format;
+    if (*format == '-') {
+      left = 1;
+      ++format;
+    }
+    while (is_number(*format)) {
+      width = width * 10 + (*format++ - '0');
+    }
+    if (*format == '.') {
+      ++format;
+      if (*format == '*') {
+        precision = va_arg(args, int);
+        ++format;
+      } else {
+        precision = 0;
+        while (is_number(*format)) {
+          precision = precision * 10 + (*format++ - '0');
+        }
+      }
+    }
+    if (*format == 'l') {
+      is_long = 1;
+      ++format;
+    }
+
+    switch (*format++) {
+    case '%':
+      string = "%";
+      length = 1;
+      break;
+
+    case 'c':
+      digits[0] = (char) va_arg(args, int);
+      length    = 1;
+      break;
+
+    case 's':
+      string = va_arg(args, const char *);
+      length = 0;
+      while ((precision < 0 || length < (unsigned long) precision) && string[length]) {
+        ++length;
+      }
+      break;
+
+    case 'd': {
+      long value = is_long ? va_arg(args, long) : va_arg(args, int);
+      if (value < 0) {
+        digits[0] = '-';
+        length    = 1 + format_ulong(digits + 1, 0ul - (unsigned long) value);
+      } else {
+        length = format_ulong(digits, value);
+      }
+      break;
+    }
+
+    case 'u':
+      length = format_ulong(digits, is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int));
+      break;
+
+    default:
+      unreachable();
+    }
+
+    if (!left && width > length) {
+      emitter_pad(emitter, width - length);
+    }
+    emitter_write(emitter, string, length);
+    if (left && width > length) {
+      emitter_pad(emitter, width - length);
+    }
+  }
+}
+
+unsigned long format_ulong(char *buf, unsigned long value)
+{
+  char          digits[20];
+  unsigned long count = 0;
+  unsigned long i;
+
+  do {
+    digits[count++] = (char) ('0' + value % 10);
+    value /= 10;
+  } while (value);
+
+  for (i = 0; i < count; ++i) {
+    buf[i] = digits[count - 1 - i];
+  }
+  buf[count] = '\0';
+  return count;
+}
@@ -0,0 +1,48 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+typedef struct Emitter Emitter;
+
+/* receives each flushed chunk of output and returns zero on failure */
+typedef int EmitterSink(void *data, const char *bytes, unsigned long length);
+
+Emitter *emitter_new_file(const char *filename);
+Emitter *emitter_new_stream(FILE *stream);
+Emitter *emitter_new_sink(EmitterSink *sink, void *data);
+int      emitter_free(Emitter *emitter);
+void     emitter_flush(Emitter *emitter);
+void     emitter_write(Emitter *emitter, const char *data, unsigned long length);
+void     emitter_puts(Emitter *emitter, const char *string);
+void     emitter_putc(Emitter *emitter, int c);
+void     emitter_pad(Emitter *emitter, unsigned long count);
+void     emitter_ulong(Emitter *emitter, unsigned long value);
+void     emitter_long(Emitter *emitter, long value);
+/* `emitter_printf` understands `%%`, `%c`, `%s`, `%d` and `%u`,
+   with an optional `-` flag, field width, precision and `l` modifier */
+void     emitter_printf(Emitter *emitter, const char *format, ...);
+void     emitter_vprintf(Emitter *emitter, const char *format, va_list args);
+
+/* writes the decimal digits of `value` and a terminating null to `buf`,
+   which must hold at least 21 characters, and returns the digit count */
+unsigned long format_ulong(char *buf, unsigned long value);
+
+#endif
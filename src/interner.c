@@ -0,0 +1,201 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "array.h"
+#include "context.h"
+#include "interner.h"
+#include "map.h"
+#include "mutex.h"
+#include "syntax_kind.h"
+#include "utility.h"
+
+#if defined(MPPLC_THREAD_SAFE) && defined(MPPLC_INTERNER_SHARDS)
+#define INTERNER_SHARDS MPPLC_INTERNER_SHARDS
+#else
+#define INTERNER_SHARDS 1
+#endif
+
+typedef struct InternerShard InternerShard;
+
+struct String {
+  const char   *data;
+  unsigned long length;
+};
+
+static unsigned long string_hash(const String *string)
+{
+  return hash_bytes(HASH_INIT, string->data, string->length);
+}
+
+static int string_equal(const String *left, const String *right)
+{
+  return left->length == right->length && memcmp(left->data, right->data, left->length) == 0;
+}
+
+DEFINE_MAP(StringMap, string_map, const String *, const String *, string_hash, string_equal)
+
+struct InternerShard {
+  Mutex     lock;
+  StringMap strings;
+  Arena    *headers;
+  Arena    *bytes;
+  ArenaMark headers_mark;
+  ArenaMark bytes_mark;
+};
+
+struct Interner {
+  InternerShard shards[INTERNER_SHARDS];
+  Array        *keywords;
+};
+
+static InternerShard *interner_shard(Interner *interner, unsigned long hash)
+{
+  return interner->shards + (hash >> 16) % INTERNER_SHARDS;
+}
+
+static void interner_insert(Interner *interner, const String *string)
+{
+  unsigned long  hash  = string_hash(string);
+  InternerShard *shard = interner_shard(interner, hash);
+  StringMapIndex index;
+  string_map_entry_hashed(&shard->strings, string, hash, &index);
+  string_map_update(&shard->strings, &index, string, string);
+}
+
+Interner *interner_new(void)
+{
+  Interner     *interner = xmalloc(sizeof(Interner));
+  unsigned long i;
+  SyntaxKind    kind;
+
+  for (i = 0; i < INTERNER_SHARDS; ++i) {
+    InternerShard *shard = interner->shards + i;
+    mutex_init(&shard->lock);
+    string_map_init(&shard->strings);
+    shard->headers = arena_new(sizeof(String) * 256);
+    shard->bytes   = arena_new(1ul << 12);
+  }
+
+  interner->keywords = array_new(sizeof(String *));
+  for (kind = SYNTAX_BAD_TOKEN; kind <= SYNTAX_EOF_TOKEN; ++kind) {
+    const char *keyword = syntax_kind_to_keyword(kind);
+    if (keyword) {
+      const String *string = interner_intern(interner, keyword, strlen(keyword));
+      array_push(interner->keywords, &string);
+    }
+  }
+
+  for (i = 0; i < INTERNER_SHARDS; ++i) {
+    InternerShard *shard = interner->shards + i;
+    arena_mark(shard->headers, &shard->headers_mark);
+    arena_mark(shard->bytes, &shard->bytes_mark);
+  }
+  return interner;
+}
+
+void interner_free(Interner *interner)
+{
+  if (interner) {
+    unsigned long i;
+    for (i = 0; i < INTERNER_SHARDS; ++i) {
+      InternerShard *shard = interner->shards + i;
+      mutex_deinit(&shard->lock);
+      string_map_deinit(&shard->strings);
+      arena_free(shard->headers);
+      arena_free(shard->bytes);
+    }
+    array_free(interner->keywords);
+    free(interner);
+  }
+}
+
+void interner_reset(Interner *interner)
+{
+  unsigned long i;
+  for (i = 0; i < INTERNER_SHARDS; ++i) {
+    InternerShard *shard = interner->shards + i;
+    string_map_clear(&shard->strings);
+    arena_rewind(shard->headers, &shard->headers_mark);
+    arena_rewind(shard->bytes, &shard->bytes_mark);
+  }
+  for (i = 0; i < array_count(interner->keywords); ++i) {
+    const String *string = *(const String **) array_at(interner->keywords, i);
+    interner_insert(interner, string);
+  }
+}
+
+const String *interner_intern(Interner *interner, const char *data, unsigned long length)
+{
+  InternerShard *shard;
+  const String  *instance;
+  StringMapIndex index;
+  unsigned long  hash;
+
+  String string;
+  string.data   = data;
+  string.length = length;
+
+  hash  = string_hash(&string);
+  shard = interner_shard(interner, hash);
+  mutex_lock(&shard->lock);
+  if (string_map_entry_hashed(&shard->strings, &string, hash, &index)) {
+    instance = string_map_key(&shard->strings, &index);
+  } else {
+    char   *ndata  = arena_alloc(shard->bytes, length + 1, 1);
+    String *header = arena_alloc(shard->headers, sizeof(String), sizeof(void *));
+    memcpy(ndata, data, length);
+    ndata[length] = '\0';
+
+    header->length = length;
+    header->data   = ndata;
+    instance       = header;
+    string_map_update(&shard->strings, &index, instance, instance);
+  }
+  mutex_unlock(&shard->lock);
+  return instance;
+}
+
+void interner_stats(Interner *interner, unsigned long *count, unsigned long *bytes, unsigned long *reserved)
+{
+  unsigned long i;
+
+  *count    = 0;
+  *bytes    = 0;
+  *reserved = 0;
+  for (i = 0; i < INTERNER_SHARDS; ++i) {
+    InternerShard *shard = interner->shards + i;
+    mutex_lock(&shard->lock);
+    *count += string_map_count(&shard->strings);
+    *bytes += arena_used(shard->bytes);
+    *reserved += arena_reserved(shard->headers) + arena_reserved(shard->bytes);
+    mutex_unlock(&shard->lock);
+  }
+}
+
+const char *string_data(const String *string)
+{
+  return string->data;
+}
+
+unsigned long string_length(const String *string)
+{
+  return string->length;
+}
@@ -0,0 +1,30 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include "context_fwd.h"
+
+typedef struct Interner Interner;
+
+Interner     *interner_new(void);
+void          interner_free(Interner *interner);
+void          interner_reset(Interner *interner);
+const String *interner_intern(Interner *interner, const char *data, unsigned long length);
+void          interner_stats(Interner *interner, unsigned long *count, unsigned long *bytes, unsigned long *reserved);
+
+#endif
@@ -33,15 +33,20 @@ int pretty_print = 0;
 int syntax_only  = 0;
 int emit_llvm    = 0;
 int emit_casl2   = 0;
+int print_stats  = 0;
+int fused_sema   = 0;
+int peephole     = 1;
+
+unsigned long jobs = 1;
 
 static int run_compiler(void)
 {
   unsigned long i;
   int           result = EXIT_SUCCESS;
+  Ctx          *ctx    = ctx_new();
 
   for (i = 0; i < array_count(filenames); ++i) {
     const char  *filename = *(const char **) array_at(filenames, i);
-    Ctx         *ctx      = ctx_new();
     Source      *source   = source_new(filename, strlen(filename));
     MpplProgram *syntax   = NULL;
 
@@ -60,10 +65,12 @@ static int run_compiler(void)
         mpplc_pretty_print(syntax, NULL);
       }
 
-      if (mpplc_resolve(source, syntax, ctx) && mpplc_check(source, syntax, ctx)) {
+      if (fused_sema ? mpplc_resolve_and_check(source, syntax, ctx) : mpplc_resolve(source, syntax, ctx) && mpplc_check_parallel(source, syntax, ctx, jobs)) {
         if (!syntax_only) {
           if (emit_casl2) {
-            mpplc_codegen_casl2(source, syntax, ctx);
+            Casl2Option option;
+            option.peephole = peephole;
+            mpplc_codegen_casl2(source, syntax, ctx, &option);
           }
 
           if (emit_llvm) {
@@ -73,10 +80,18 @@ static int run_compiler(void)
       }
     }
 
+    if (print_stats) {
+      CtxStats stats;
+      ctx_stats(ctx, &stats);
+      fprintf(stderr, "%s: interned %lu strings, %lu bytes (%lu bytes reserved)\n",
+        filename, stats.string_count, stats.string_bytes, stats.string_reserved);
+    }
+
     mppl_unref(syntax);
     source_free(source);
-    ctx_free(ctx);
+    ctx_reset(ctx);
   }
+  ctx_free(ctx);
   return result;
 }
 
@@ -90,6 +105,10 @@ static void print_help(void)
     "    --syntax-only   Check syntax only\n"
     "    --emit-llvm     Emit LLVM IR\n"
     "    --emit-casl2    Emit CASL2\n"
+    "    --stats         Print interner statistics\n"
+    "    --fused-sema    Resolve names and check types in a single walk\n"
+    "    --jobs N        Check procedures on N threads\n"
+    "    --no-peephole   Emit CASL2 without the peephole optimizer\n"
     "    --help          Print this help message\n",
     program);
   fflush(stdout);
@@ -126,6 +145,14 @@ static void init(int argc, const char **argv)
         emit_llvm = 1;
       } else if (strcmp(argv[i], "--emit-casl2") == 0) {
         emit_casl2 = 1;
+      } else if (strcmp(argv[i], "--stats") == 0) {
+        print_stats = 1;
+      } else if (strcmp(argv[i], "--fused-sema") == 0) {
+        fused_sema = 1;
+      } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+        jobs = strtoul(argv[++i], NULL, 10);
+      } else if (strcmp(argv[i], "--no-peephole") == 0) {
+        peephole = 0;
       } else if (strcmp(argv[i], "--help") == 0) {
         print_help();
         stop   = 1;
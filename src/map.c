@@ -25,6 +25,7 @@
 
 struct MapBucket {
   unsigned long hop;
+  unsigned long hash;
   void         *key;
   void         *value;
 };
@@ -39,7 +40,7 @@ struct Map {
 
 static unsigned long map_default_hasher(const void *value)
 {
-  return fnv1a(FNV1A_INIT, &value, sizeof(value));
+  return hash_pointer(value);
 }
 
 static int map_default_comparator(const void *left, const void *right)
@@ -77,10 +78,11 @@ unsigned long map_count(Map *map)
   return map->count;
 }
 
-static void map_index_init(MapIndex *index, Map *map, void *key)
+static void map_index_init(MapIndex *index, Map *map, unsigned long hash)
 {
-  index->_bucket = map->buckets + (map->hasher(key) & map->mask);
+  index->_bucket = map->buckets + (hash & map->mask);
   index->_slot   = NULL;
+  index->_hash   = hash;
 }
 
 void map_reserve(Map *map, unsigned long capacity)
@@ -88,7 +90,7 @@ void map_reserve(Map *map, unsigned long capacity)
   unsigned long i;
   unsigned long new_mask = capacity - 1;
 
-  for (i = 1; i < sizeof(new_mask); i <<= 1) {
+  for (i = 1; i < sizeof(new_mask) * CHAR_BIT; i <<= 1) {
     new_mask |= new_mask >> i;
   }
 
@@ -102,6 +104,7 @@ void map_reserve(Map *map, unsigned long capacity)
     map->buckets = xmalloc(sizeof(MapBucket) * (new_mask + NEIGHBORHOOD));
     for (i = 0; i < new_mask + NEIGHBORHOOD; ++i) {
       map->buckets[i].hop   = 0;
+      map->buckets[i].hash  = 0;
       map->buckets[i].key   = NULL;
       map->buckets[i].value = NULL;
     }
@@ -111,7 +114,7 @@ void map_reserve(Map *map, unsigned long capacity)
         hop = (hop >> 1) | old_buckets[i].hop;
         if (hop & 1) {
           MapIndex index;
-          map_index_init(&index, map, old_buckets[i].key);
+          map_index_init(&index, map, old_buckets[i].hash);
           map_update(map, &index, old_buckets[i].key, old_buckets[i].value);
         }
       }
@@ -123,9 +126,10 @@ void map_reserve(Map *map, unsigned long capacity)
 int map_entry(Map *map, void *key, MapIndex *index)
 {
   unsigned long i;
-  map_index_init(index, map, key);
+  map_index_init(index, map, map->hasher(key));
   for (i = 0; i < NEIGHBORHOOD; ++i) {
-    if (index->_bucket->hop & (1ul << i) && map->comparator(key, index->_bucket[i].key)) {
+    if (index->_bucket->hop & (1ul << i) && index->_bucket[i].hash == index->_hash
+      && map->comparator(key, index->_bucket[i].key)) {
       index->_slot = index->_bucket + i;
       break;
     }
@@ -184,51 +188,58 @@ void *map_value(Map *map, MapIndex *index)
 
 void map_update(Map *map, MapIndex *index, void *key, void *value)
 {
-  MapBucket *empty = index->_slot;
+  MapBucket    *empty = NULL;
+  unsigned long hop   = 0;
+  long          limit = (long) (map->mask + NEIGHBORHOOD) - (index->_bucket - map->buckets);
+  long          i;
 
-  if (!empty) {
-    long i = index->_bucket - map->buckets < NEIGHBORHOOD
-      ? -(index->_bucket - map->buckets)
-      : -NEIGHBORHOOD + 1;
+  if (index->_slot) {
+    index->_slot->key   = key;
+    index->_slot->value = value;
+    return;
+  }
 
-    unsigned long hop = 0;
-    for (; i < NEIGHBORHOOD * 8; ++i) {
-      hop = (hop >> 1) | index->_bucket[i].hop;
-      if (i >= 0 && !(hop & 1)) {
-        empty = index->_bucket + i;
-        break;
-      }
+  i = index->_bucket - map->buckets < NEIGHBORHOOD
+    ? -(index->_bucket - map->buckets)
+    : -NEIGHBORHOOD + 1;
+  for (; i < NEIGHBORHOOD * 8 && i < limit; ++i) {
+    hop = (hop >> 1) | index->_bucket[i].hop;
+    if (i >= 0 && !(hop & 1)) {
+      empty = index->_bucket + i;
+      break;
     }
+  }
 
-    if (empty) {
-      while (empty - index->_bucket >= NEIGHBORHOOD) {
-        MapBucket *bucket = empty - NEIGHBORHOOD + 2;
-        for (; bucket < empty; ++bucket) {
-          if (bucket->hop & ((1ul << (empty - bucket + 1)) - 1)) {
-            MapBucket *next = bucket;
-            for (; next < empty; ++next) {
-              if (bucket->hop & (1ul << (next - bucket))) {
-                break;
-              }
+  if (empty) {
+    while (empty - index->_bucket >= NEIGHBORHOOD) {
+      MapBucket *bucket = empty - NEIGHBORHOOD + 2;
+      for (; bucket < empty; ++bucket) {
+        if (bucket->hop & ((1ul << (empty - bucket + 1)) - 1)) {
+          MapBucket *next = bucket;
+          for (; next < empty; ++next) {
+            if (bucket->hop & (1ul << (next - bucket))) {
+              break;
             }
-
-            bucket->hop &= ~(1ul << (next - bucket));
-            bucket->hop |= 1ul << (empty - bucket);
-            empty->key   = next->key;
-            empty->value = next->value;
-            empty        = next;
-            break;
           }
-        }
-        if (bucket == empty) {
-          empty = NULL;
+
+          bucket->hop &= ~(1ul << (next - bucket));
+          bucket->hop |= 1ul << (empty - bucket);
+          empty->hash  = next->hash;
+          empty->key   = next->key;
+          empty->value = next->value;
+          empty        = next;
           break;
         }
       }
+      if (bucket == empty) {
+        empty = NULL;
+        break;
+      }
     }
   }
 
   if (empty) {
+    empty->hash  = index->_hash;
     empty->key   = key;
     empty->value = value;
     index->_bucket->hop |= 1ul << (empty - index->_bucket);
@@ -236,7 +247,7 @@ void map_update(Map *map, MapIndex *index, void *key, void *value)
     ++map->count;
   } else {
     map_reserve(map, (map->mask + 1) << 1);
-    map_index_init(index, map, key);
+    map_index_init(index, map, index->_hash);
     map_update(map, index, key, value);
   }
 }
@@ -249,3 +260,15 @@ void map_erase(Map *map, MapIndex *index)
     --map->count;
   }
 }
+
+void map_clear(Map *map)
+{
+  unsigned long i;
+  for (i = 0; i < map->mask + NEIGHBORHOOD; ++i) {
+    map->buckets[i].hop   = 0;
+    map->buckets[i].hash  = 0;
+    map->buckets[i].key   = NULL;
+    map->buckets[i].value = NULL;
+  }
+  map->count = 0;
+}
@@ -17,6 +17,10 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stdlib.h>
+
+#include "utility.h"
+
 typedef unsigned long    MapHasher(const void *);
 typedef int              MapComparator(const void *, const void *);
 typedef struct MapBucket MapBucket;
@@ -24,8 +28,9 @@ typedef struct MapIndex  MapIndex;
 typedef struct Map       Map;
 
 struct MapIndex {
-  MapBucket *_bucket;
-  MapBucket *_slot;
+  MapBucket    *_bucket;
+  MapBucket    *_slot;
+  unsigned long _hash;
 };
 
 Map          *map_new(MapHasher *hasher, MapComparator *comparator);
@@ -40,5 +45,135 @@ void         *map_key(Map *map, MapIndex *index);
 void         *map_value(Map *map, MapIndex *index);
 void          map_update(Map *map, MapIndex *index, void *key, void *value);
 void          map_erase(Map *map, MapIndex *index);
+void          map_clear(Map *map);
+
+#define MAP_SMALL_CAPACITY 16
+
+/* typed open-addressing map for hot paths; `hash` and `equal` take keys by value
+   and a hash of zero is remapped since it marks an empty slot. the table starts
+   out as MAP_SMALL_CAPACITY slots inline, a power of two, and only moves to the
+   heap when it grows, so an initialized map must not be moved */
+#define DEFINE_MAP(Name, prefix, Key, Value, hash, equal)                                                       \
+  typedef struct Name##Slot  Name##Slot;                                                                        \
+  typedef struct Name##Index Name##Index;                                                                       \
+  typedef struct Name        Name;                                                                              \
+                                                                                                                \
+  struct Name##Slot {                                                                                           \
+    unsigned long hash;                                                                                         \
+    Key           key;                                                                                          \
+    Value         value;                                                                                        \
+  };                                                                                                            \
+                                                                                                                \
+  struct Name##Index {                                                                                          \
+    unsigned long slot;                                                                                         \
+    unsigned long hash;                                                                                         \
+  };                                                                                                            \
+                                                                                                                \
+  struct Name {                                                                                                 \
+    Name##Slot   *slots;                                                                                        \
+    unsigned long count;                                                                                        \
+    unsigned long mask;                                                                                         \
+    Name##Slot    small[MAP_SMALL_CAPACITY];                                                                    \
+  };                                                                                                            \
+                                                                                                                \
+  static INLINE void prefix##_clear(Name *map)                                                                  \
+  {                                                                                                             \
+    unsigned long i;                                                                                            \
+    for (i = 0; i <= map->mask; ++i) {                                                                          \
+      map->slots[i].hash = 0;                                                                                   \
+    }                                                                                                           \
+    map->count = 0;                                                                                             \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE void prefix##_init(Name *map)                                                                   \
+  {                                                                                                             \
+    map->slots = map->small;                                                                                    \
+    map->mask  = MAP_SMALL_CAPACITY - 1;                                                                        \
+    prefix##_clear(map);                                                                                        \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE void prefix##_deinit(Name *map)                                                                 \
+  {                                                                                                             \
+    if (map->slots != map->small) {                                                                             \
+      free(map->slots);                                                                                         \
+    }                                                                                                           \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE unsigned long prefix##_count(const Name *map)                                                   \
+  {                                                                                                             \
+    return map->count;                                                                                          \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE int prefix##_entry_hashed(const Name *map, Key key, unsigned long key_hash, Name##Index *index) \
+  {                                                                                                             \
+    index->hash = key_hash ? key_hash : 1;                                                                      \
+    index->slot = index->hash & map->mask;                                                                      \
+    while (map->slots[index->slot].hash) {                                                                      \
+      if (map->slots[index->slot].hash == index->hash && equal(map->slots[index->slot].key, key)) {             \
+        return 1;                                                                                               \
+      }                                                                                                         \
+      index->slot = (index->slot + 1) & map->mask;                                                              \
+    }                                                                                                           \
+    return 0;                                                                                                   \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE int prefix##_entry(const Name *map, Key key, Name##Index *index)                                \
+  {                                                                                                             \
+    return prefix##_entry_hashed(map, key, hash(key), index);                                                   \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE Key prefix##_key(const Name *map, const Name##Index *index)                                     \
+  {                                                                                                             \
+    return map->slots[index->slot].key;                                                                         \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE Value prefix##_value(const Name *map, const Name##Index *index)                                 \
+  {                                                                                                             \
+    return map->slots[index->slot].value;                                                                       \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE unsigned long prefix##_probe(const Name *map, unsigned long key_hash)                           \
+  {                                                                                                             \
+    unsigned long slot = key_hash & map->mask;                                                                  \
+    while (map->slots[slot].hash) {                                                                             \
+      slot = (slot + 1) & map->mask;                                                                            \
+    }                                                                                                           \
+    return slot;                                                                                                \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE void prefix##_grow(Name *map)                                                                   \
+  {                                                                                                             \
+    Name##Slot   *slots = map->slots;                                                                           \
+    unsigned long mask  = map->mask;                                                                            \
+    unsigned long i;                                                                                            \
+                                                                                                                \
+    map->mask  = mask * 2 + 1;                                                                                  \
+    map->slots = xmalloc(sizeof(Name##Slot) * (map->mask + 1));                                                 \
+    for (i = 0; i <= map->mask; ++i) {                                                                          \
+      map->slots[i].hash = 0;                                                                                   \
+    }                                                                                                           \
+    for (i = 0; i <= mask; ++i) {                                                                               \
+      if (slots[i].hash) {                                                                                      \
+        map->slots[prefix##_probe(map, slots[i].hash)] = slots[i];                                              \
+      }                                                                                                         \
+    }                                                                                                           \
+    if (slots != map->small) {                                                                                  \
+      free(slots);                                                                                              \
+    }                                                                                                           \
+  }                                                                                                             \
+                                                                                                                \
+  static INLINE void prefix##_update(Name *map, Name##Index *index, Key key, Value value)                       \
+  {                                                                                                             \
+    if (!map->slots[index->slot].hash) {                                                                        \
+      if ((map->count + 1) * 4 > (map->mask + 1) * 3) {                                                         \
+        prefix##_grow(map);                                                                                     \
+        index->slot = prefix##_probe(map, index->hash);                                                         \
+      }                                                                                                         \
+      map->slots[index->slot].hash = index->hash;                                                               \
+      ++map->count;                                                                                             \
+    }                                                                                                           \
+    map->slots[index->slot].key   = key;                                                                        \
+    map->slots[index->slot].value = value;                                                                      \
+  }
 
 #endif
@@ -0,0 +1,307 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "utility.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAP_SSE2
+#endif
+
+#define GROUP_WIDTH 16
+
+#define CTRL_EMPTY   ((signed char) -128)
+#define CTRL_DELETED ((signed char) -2)
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((signed char) ((hash) & 0x7F))
+
+struct MapBucket {
+  unsigned long hash;
+  void         *key;
+  void         *value;
+};
+
+/* `ctrl` holds one byte per slot plus a copy of the first group so that a group can be loaded at any slot */
+struct Map {
+  unsigned long  count;
+  unsigned long  mask;
+  unsigned long  growth_left;
+  signed char   *ctrl;
+  MapBucket     *slots;
+  MapHasher     *hasher;
+  MapComparator *comparator;
+};
+
+static unsigned long map_default_hasher(const void *value)
+{
+  return hash_pointer(value);
+}
+
+static int map_default_comparator(const void *left, const void *right)
+{
+  return left == right;
+}
+
+static unsigned long group_match(const signed char *group, signed char ctrl)
+{
+#ifdef MAP_SSE2
+  __m128i data = _mm_loadu_si128((const __m128i *) group);
+  return (unsigned long) _mm_movemask_epi8(_mm_cmpeq_epi8(data, _mm_set1_epi8(ctrl)));
+#else
+  unsigned long result = 0;
+  int           i;
+  for (i = 0; i < GROUP_WIDTH; ++i) {
+    if (group[i] == ctrl) {
+      result |= 1ul << i;
+    }
+  }
+  return result;
+#endif
+}
+
+static unsigned long group_match_empty_or_deleted(const signed char *group)
+{
+#ifdef MAP_SSE2
+  __m128i data = _mm_loadu_si128((const __m128i *) group);
+  return (unsigned long) _mm_movemask_epi8(_mm_cmplt_epi8(data, _mm_set1_epi8(-1)));
+#else
+  unsigned long result = 0;
+  int           i;
+  for (i = 0; i < GROUP_WIDTH; ++i) {
+    if (group[i] < -1) {
+      result |= 1ul << i;
+    }
+  }
+  return result;
+#endif
+}
+
+static int lowest_bit(unsigned long mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzl(mask);
+#else
+  int result = 0;
+  while (!(mask & 1ul)) {
+    mask >>= 1;
+    ++result;
+  }
+  return result;
+#endif
+}
+
+static unsigned long capacity_to_growth(unsigned long capacity)
+{
+  return capacity - capacity / 8;
+}
+
+static void map_set_ctrl(Map *map, unsigned long slot, signed char ctrl)
+{
+  map->ctrl[slot] = ctrl;
+  if (slot < GROUP_WIDTH) {
+    map->ctrl[map->mask + 1 + slot] = ctrl;
+  }
+}
+
+static unsigned long map_find_insert_slot(Map *map, unsigned long hash)
+{
+  unsigned long pos    = H1(hash) & map->mask;
+  unsigned long stride = 0;
+  while (1) {
+    unsigned long mask = group_match_empty_or_deleted(map->ctrl + pos);
+    if (mask) {
+      return (pos + lowest_bit(mask)) & map->mask;
+    }
+    stride += GROUP_WIDTH;
+    pos = (pos + stride) & map->mask;
+  }
+}
+
+static void map_rehash(Map *map, unsigned long capacity)
+{
+  signed char  *old_ctrl  = map->ctrl;
+  MapBucket    *old_slots = map->slots;
+  unsigned long old_size  = old_ctrl ? map->mask + 1 : 0;
+  unsigned long i;
+
+  map->mask  = capacity - 1;
+  map->ctrl  = xmalloc(capacity + GROUP_WIDTH);
+  map->slots = xmalloc(sizeof(MapBucket) * capacity);
+  memset(map->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+  map->growth_left = capacity_to_growth(capacity) - map->count;
+
+  for (i = 0; i < old_size; ++i) {
+    if (old_ctrl[i] >= 0) {
+      unsigned long slot = map_find_insert_slot(map, old_slots[i].hash);
+      map_set_ctrl(map, slot, H2(old_slots[i].hash));
+      map->slots[slot] = old_slots[i];
+    }
+  }
+  free(old_ctrl);
+  free(old_slots);
+}
+
+Map *map_new(MapHasher *hasher, MapComparator *comparator)
+{
+  return map_new_with_capacity(1l << 4, hasher, comparator);
+}
+
+Map *map_new_with_capacity(unsigned long capacity, MapHasher *hasher, MapComparator *comparator)
+{
+  Map *map         = xmalloc(sizeof(Map));
+  map->count       = 0;
+  map->mask        = 0;
+  map->growth_left = 0;
+  map->ctrl        = NULL;
+  map->slots       = NULL;
+  map->hasher      = hasher ? hasher : &map_default_hasher;
+  map->comparator  = comparator ? comparator : &map_default_comparator;
+  map_reserve(map, capacity);
+  return map;
+}
+
+void map_free(Map *map)
+{
+  if (map) {
+    free(map->ctrl);
+    free(map->slots);
+    free(map);
+  }
+}
+
+unsigned long map_count(Map *map)
+{
+  return map->count;
+}
+
+void map_reserve(Map *map, unsigned long capacity)
+{
+  unsigned long size = GROUP_WIDTH;
+  while (capacity_to_growth(size) < capacity) {
+    size <<= 1;
+  }
+  if (!map->ctrl || size > map->mask + 1) {
+    map_rehash(map, size);
+  }
+}
+
+int map_entry(Map *map, void *key, MapIndex *index)
+{
+  unsigned long hash   = map->hasher(key);
+  unsigned long pos    = H1(hash) & map->mask;
+  unsigned long stride = 0;
+
+  index->_hash   = hash;
+  index->_bucket = NULL;
+  index->_slot   = NULL;
+  while (1) {
+    const signed char *group = map->ctrl + pos;
+    unsigned long      match = group_match(group, H2(hash));
+    while (match) {
+      int        bit  = lowest_bit(match);
+      MapBucket *slot = map->slots + ((pos + bit) & map->mask);
+      if (slot->hash == hash && map->comparator(key, slot->key)) {
+        index->_slot = slot;
+        return 1;
+      }
+      match &= match - 1;
+    }
+    if (group_match(group, CTRL_EMPTY)) {
+      return 0;
+    }
+    stride += GROUP_WIDTH;
+    pos = (pos + stride) & map->mask;
+  }
+}
+
+void map_iterator(Map *map, MapIndex *index)
+{
+  index->_bucket = NULL;
+  index->_slot   = NULL;
+  (void) map;
+}
+
+int map_next(Map *map, MapIndex *index)
+{
+  unsigned long i    = index->_slot ? (unsigned long) (index->_slot - map->slots) + 1 : 0;
+  unsigned long size = map->mask + 1;
+
+  for (; i < size; ++i) {
+    if (map->ctrl[i] >= 0) {
+      index->_slot = map->slots + i;
+      return 1;
+    }
+  }
+  index->_slot = NULL;
+  return 0;
+}
+
+void *map_key(Map *map, MapIndex *index)
+{
+  (void) map;
+  return index->_slot ? index->_slot->key : NULL;
+}
+
+void *map_value(Map *map, MapIndex *index)
+{
+  (void) map;
+  return index->_slot ? index->_slot->value : NULL;
+}
+
+void map_update(Map *map, MapIndex *index, void *key, void *value)
+{
+  if (index->_slot) {
+    index->_slot->key   = key;
+    index->_slot->value = value;
+  } else {
+    unsigned long slot = map_find_insert_slot(map, index->_hash);
+    if (map->growth_left == 0 && map->ctrl[slot] == CTRL_EMPTY) {
+      map_rehash(map, map->count * 2 >= capacity_to_growth(map->mask + 1) ? (map->mask + 1) << 1 : map->mask + 1);
+      slot = map_find_insert_slot(map, index->_hash);
+    }
+    if (map->ctrl[slot] == CTRL_EMPTY) {
+      --map->growth_left;
+    }
+    map_set_ctrl(map, slot, H2(index->_hash));
+    map->slots[slot].hash  = index->_hash;
+    map->slots[slot].key   = key;
+    map->slots[slot].value = value;
+    index->_slot           = map->slots + slot;
+    ++map->count;
+  }
+}
+
+void map_erase(Map *map, MapIndex *index)
+{
+  if (index->_slot) {
+    map_set_ctrl(map, index->_slot - map->slots, CTRL_DELETED);
+    index->_slot = NULL;
+    --map->count;
+  }
+}
+
+void map_clear(Map *map)
+{
+  memset(map->ctrl, CTRL_EMPTY, map->mask + 1 + GROUP_WIDTH);
+  map->growth_left = capacity_to_growth(map->mask + 1);
+  map->count       = 0;
+}
@@ -96,6 +96,60 @@ int mppl_lit_boolean__to_int(const MpplBooleanLit *syntax)
   return token->kind == SYNTAX_TRUE_KW;
 }
 
+static int mppl_expr__folds_to(const AnyMpplExpr *syntax, const Ctx *ctx, long value)
+{
+  long folded;
+  return ctx_folded(ctx, (const SyntaxTree *) syntax, &folded) && folded == value;
+}
+
+AnyMpplExpr *mppl_binary_expr__identity_operand(const MpplBinaryExpr *syntax, const Ctx *ctx)
+{
+  AnyMpplExpr *lhs    = mppl_binary_expr__lhs(syntax);
+  AnyMpplExpr *rhs    = mppl_binary_expr__rhs(syntax);
+  MpplToken   *op     = mppl_binary_expr__op_token(syntax);
+  AnyMpplExpr *result = NULL;
+  long         left   = -1;
+  long         right  = -1;
+
+  switch (syntax_tree_kind((const SyntaxTree *) op)) {
+  case SYNTAX_PLUS_TOKEN:
+  case SYNTAX_OR_KW:
+    left = right = 0;
+    break;
+
+  case SYNTAX_MINUS_TOKEN:
+    right = 0;
+    break;
+
+  case SYNTAX_STAR_TOKEN:
+  case SYNTAX_AND_KW:
+    left = right = 1;
+    break;
+
+  case SYNTAX_DIV_KW:
+    right = 1;
+    break;
+
+  default:
+    break;
+  }
+
+  if (lhs) {
+    if (left >= 0 && mppl_expr__folds_to(lhs, ctx, left)) {
+      result = rhs;
+      rhs    = NULL;
+    } else if (right >= 0 && mppl_expr__folds_to(rhs, ctx, right)) {
+      result = lhs;
+      lhs    = NULL;
+    }
+  }
+
+  mppl_unref(lhs);
+  mppl_unref(rhs);
+  mppl_unref(op);
+  return result;
+}
+
 /* visit ast node */
 
 void mppl_ast_walker__setup(MpplAstWalker *walker)
@@ -74,6 +74,10 @@ char *mppl_lit_string__to_string(const MpplStringLit *syntax);
 
 int mppl_lit_boolean__to_int(const MpplBooleanLit *syntax);
 
+/* the operand `syntax` reduces to when the checker folded the other one to the identity
+   of the operator, as in `x + 0`, `1 * x` or `true and x`, or NULL otherwise */
+AnyMpplExpr *mppl_binary_expr__identity_operand(const MpplBinaryExpr *syntax, const Ctx *ctx);
+
 void mppl_ast_walker__setup(MpplAstWalker *walker);
 void mppl_ast_walker__travel(MpplAstWalker *walker, const MpplProgram *syntax, void *data);
 
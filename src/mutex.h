@@ -0,0 +1,57 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#ifdef MPPLC_THREAD_SAFE
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+typedef CRITICAL_SECTION Mutex;
+
+#define mutex_init(mutex)   InitializeCriticalSection(mutex)
+#define mutex_deinit(mutex) DeleteCriticalSection(mutex)
+#define mutex_lock(mutex)   EnterCriticalSection(mutex)
+#define mutex_unlock(mutex) LeaveCriticalSection(mutex)
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_mutex_t Mutex;
+
+#define mutex_init(mutex)   pthread_mutex_init((mutex), NULL)
+#define mutex_deinit(mutex) pthread_mutex_destroy(mutex)
+#define mutex_lock(mutex)   pthread_mutex_lock(mutex)
+#define mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+
+#endif
+
+#else
+
+typedef int Mutex;
+
+#define mutex_init(mutex)   ((void) (mutex))
+#define mutex_deinit(mutex) ((void) (mutex))
+#define mutex_lock(mutex)   ((void) (mutex))
+#define mutex_unlock(mutex) ((void) (mutex))
+
+#endif
+
+#endif
@@ -22,6 +22,7 @@
 #include "array.h"
 #include "canvas.h"
 #include "report.h"
+#include "string_builder.h"
 #include "terminal.h"
 #include "utility.h"
 
@@ -87,14 +88,9 @@ struct Report {
 
 char *vformat(const char *format, va_list args)
 {
-  FILE         *file   = tmpfile();
-  unsigned long length = vfprintf(file, format, args);
-  char         *text   = xmalloc(sizeof(char) * (length + 1));
-  rewind(file);
-  fread(text, sizeof(char), length, file);
-  text[length] = '\0';
-  fclose(file);
-  return text;
+  StringBuilder *builder = string_builder_new();
+  string_builder_vprintf(builder, format, args);
+  return string_builder_steal(builder);
 }
 
 Report *report_new(ReportKind kind, unsigned long offset, const char *format, ...)
@@ -745,3 +741,8 @@ void report_emit(Report *report, const Source *source)
   canvas_free(canvas);
   report_free(report);
 }
+
+int report_is_error(const Report *report)
+{
+  return report->kind == REPORT_KIND_ERROR;
+}
@@ -38,5 +38,6 @@ void    report_annotation_with_args(Report *report, unsigned long start, unsigne
 void    report_note(Report *report, const char *format, ...);
 void    report_note_with_args(Report *report, const char *format, va_list args);
 void    report_emit(Report *report, const Source *source);
+int     report_is_error(const Report *report);
 
 #endif
@@ -15,6 +15,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "array.h"
@@ -25,25 +26,92 @@
 #include "mppl_syntax.h"
 #include "mppl_syntax_ext.h"
 #include "report.h"
+#include "resolver.h"
 #include "source.h"
 #include "string.h"
+#include "string_builder.h"
 #include "syntax_kind.h"
 #include "syntax_tree.h"
 #include "utility.h"
 
-typedef struct Scope    Scope;
-typedef struct Resolver Resolver;
+#define NO_INDEX ((unsigned long) -1)
+
+typedef struct Binding   Binding;
+typedef struct Scope     Scope;
+typedef struct CallFrame CallFrame;
+typedef struct CallGraph CallGraph;
+
+struct Binding {
+  const String *name;
+  const Def    *def;
+  unsigned long depth;
+  unsigned long shadowed;
+};
 
 struct Scope {
-  Map              *defs;
-  Scope            *parent;
   const SyntaxTree *syntax;
+  unsigned long     bindings;
+  const Def        *caller;
+};
+
+struct CallFrame {
+  unsigned long node;
+  unsigned long edge;
+};
+
+static unsigned long name_hash(const String *name)
+{
+  return hash_pointer(name);
+}
+
+static int name_equal(const String *left, const String *right)
+{
+  return left == right;
+}
+
+static unsigned long def_hash(const Def *def)
+{
+  return hash_pointer(def);
+}
+
+static int def_equal(const Def *left, const Def *right)
+{
+  return left == right;
+}
+
+DEFINE_ARRAY(BindingArray, binding_array, Binding)
+DEFINE_ARRAY(ScopeArray, scope_array, Scope)
+DEFINE_ARRAY(IndexArray, index_array, unsigned long)
+DEFINE_ARRAY(CallFrameArray, call_frame_array, CallFrame)
+DEFINE_MAP(BindingMap, binding_map, const String *, unsigned long, name_hash, name_equal)
+DEFINE_MAP(NodeMap, node_map, const Def *, unsigned long, def_hash, def_equal)
+
+/* procedures are nodes and the calls recorded in `Ctx` since `first` are edges.
+   the edges leaving node `v` are `edges[offsets[v]]` up to `edges[offsets[v + 1]]` */
+struct CallGraph {
+  const Ctx    *ctx;
+  unsigned long first;
+  NodeMap       nodes;
+  IndexArray    source;
+  IndexArray    target;
+  IndexArray    offsets;
+  IndexArray    edges;
+  IndexArray    component;
+  IndexArray    component_size;
 };
 
+/* every name maps to its innermost binding, which links to the one it shadows.
+   `bindings` doubles as the undo log that `pop_scope` unwinds */
 struct Resolver {
-  Scope *scope;
-  Ctx   *ctx;
-  Array *errors;
+  BindingMap    table;
+  BindingArray  bindings;
+  ScopeArray    scopes;
+  const Def    *caller;
+  IndexArray    call_sites;
+  MpplAstWalker walker;
+  unsigned long first_call;
+  Ctx          *ctx;
+  Array        *errors;
 };
 
 static void error_def_conflict(Resolver *resolver, const String *name, const SyntaxTree *previous, const SyntaxTree *conflict)
@@ -78,47 +146,44 @@ static void error_proc_res_failure(Resolver *resolver, const String *name, const
   array_push(resolver->errors, &report);
 }
 
-static void push_scope(Resolver *resolver, const SyntaxTree *syntax)
+static const Def *try_define(Resolver *resolver, DefKind kind, const SyntaxTree *item_syntax, const SyntaxTree *name_syntax)
 {
-  Scope *scope    = xmalloc(sizeof(Scope));
-  scope->defs     = map_new(NULL, NULL);
-  scope->parent   = resolver->scope;
-  scope->syntax   = syntax;
-  resolver->scope = scope;
-}
-
-static void pop_scope(Resolver *resolver)
-{
-  Scope *scope    = resolver->scope;
-  resolver->scope = scope->parent;
-  map_free(scope->defs);
-  free(scope);
-}
-
-static void try_define(Resolver *resolver, DefKind kind, const SyntaxTree *item_syntax, const SyntaxTree *name_syntax)
-{
-  MapIndex              index;
+  BindingMapIndex       index;
+  unsigned long         innermost  = NO_INDEX;
+  unsigned long         depth      = scope_array_count(&resolver->scopes);
   const RawSyntaxToken *name_token = (const RawSyntaxToken *) syntax_tree_raw(name_syntax);
 
-  if (resolver->scope && map_entry(resolver->scope->defs, (void *) name_token->string, &index)) {
-    const Def *previous = map_value(resolver->scope->defs, &index);
+  if (depth && binding_map_entry(&resolver->table, name_token->string, &index)) {
+    innermost = binding_map_value(&resolver->table, &index);
+  }
+
+  if (innermost != NO_INDEX && binding_array_at(&resolver->bindings, innermost)->depth == depth) {
+    const Def *previous = binding_array_at(&resolver->bindings, innermost)->def;
     error_def_conflict(resolver, def_name(previous), def_syntax(previous), item_syntax);
+    return NULL;
   } else {
     const Def *def = ctx_define(resolver->ctx, kind, name_token->string, item_syntax);
     ctx_resolve(resolver->ctx, name_syntax, def);
-    if (resolver->scope) {
-      map_update(resolver->scope->defs, &index, (void *) name_token->string, (void *) def);
+    if (depth) {
+      Binding binding;
+      binding.name     = name_token->string;
+      binding.def      = def;
+      binding.depth    = depth;
+      binding.shadowed = innermost;
+      binding_map_update(&resolver->table, &index, name_token->string, binding_array_count(&resolver->bindings));
+      binding_array_push(&resolver->bindings, binding);
     }
+    return def;
   }
 }
 
 static const Def *get_def(Resolver *resolver, const String *name)
 {
-  Scope *scope;
-  for (scope = resolver->scope; scope; scope = scope->parent) {
-    MapIndex index;
-    if (map_entry(scope->defs, (void *) name, &index)) {
-      return map_value(scope->defs, &index);
+  BindingMapIndex index;
+  if (binding_map_entry(&resolver->table, name, &index)) {
+    unsigned long innermost = binding_map_value(&resolver->table, &index);
+    if (innermost != NO_INDEX) {
+      return binding_array_at(&resolver->bindings, innermost)->def;
     }
   }
   return NULL;
@@ -128,7 +193,7 @@ static const Def *try_resolve(Resolver *resolver, const SyntaxTree *syntax, int
 {
   const RawSyntaxToken *node = (const RawSyntaxToken *) syntax_tree_raw(syntax);
   const Def            *def  = get_def(resolver, node->string);
-  if (resolver->scope && def) {
+  if (scope_array_count(&resolver->scopes) && def) {
     ctx_resolve(resolver->ctx, syntax, def);
     return def;
   } else {
@@ -141,50 +206,75 @@ static const Def *try_resolve(Resolver *resolver, const SyntaxTree *syntax, int
   }
 }
 
-static void error_call_stmt_recursion(Resolver *resolver, const Def *proc, const SyntaxTree *name_syntax)
+static void enter_scope(Resolver *resolver, DefKind kind, const SyntaxTree *syntax, const SyntaxTree *name_syntax)
+{
+  Scope scope;
+  scope.syntax     = syntax;
+  scope.caller     = resolver->caller;
+  resolver->caller = try_define(resolver, kind, syntax, name_syntax);
+  scope.bindings   = binding_array_count(&resolver->bindings);
+  scope_array_push(&resolver->scopes, scope);
+}
+
+static void leave_scope(Resolver *resolver)
+{
+  Scope *scope = scope_array_back(&resolver->scopes);
+  while (binding_array_count(&resolver->bindings) > scope->bindings) {
+    Binding        *binding = binding_array_back(&resolver->bindings);
+    BindingMapIndex index;
+    binding_map_entry(&resolver->table, binding->name, &index);
+    binding_map_update(&resolver->table, &index, binding->name, binding->shadowed);
+    binding_array_pop(&resolver->bindings);
+  }
+  resolver->caller = scope->caller;
+  scope_array_pop(&resolver->scopes);
+}
+
+static void error_call_stmt_recursion(Array *errors, const Call *call, const char *cycle)
 {
-  unsigned long offset = syntax_tree_offset(name_syntax);
-  unsigned long length = syntax_tree_text_length(name_syntax);
+  unsigned long offset = syntax_tree_offset(call_syntax(call));
+  unsigned long length = syntax_tree_text_length(call_syntax(call));
 
   Report *report = report_new(REPORT_KIND_ERROR, offset, "recursion is prohibited");
-  report_annotation(report, offset, offset + length, "recursive call to `%s`", string_data(def_name(proc)));
-  array_push(resolver->errors, &report);
+  if (cycle) {
+    report_annotation(report, offset, offset + length, "recursive call to `%s` through %s", string_data(def_name(call_callee(call))), cycle);
+  } else {
+    report_annotation(report, offset, offset + length, "recursive call to `%s`", string_data(def_name(call_callee(call))));
+  }
+  array_push(errors, &report);
 }
 
-static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax, void *resolver)
+void resolver_enter_program(Resolver *resolver, const MpplProgram *syntax)
 {
   MpplToken *name_syntax = mppl_program__name(syntax);
-  try_define(resolver, DEF_PROGRAM, (const SyntaxTree *) syntax, (SyntaxTree *) name_syntax);
+  enter_scope(resolver, DEF_PROGRAM, (const SyntaxTree *) syntax, (SyntaxTree *) name_syntax);
   mppl_unref(name_syntax);
-  push_scope(resolver, (const SyntaxTree *) syntax);
-  mppl_ast__walk_program(walker, syntax, resolver);
-  pop_scope(resolver);
 }
 
-static void visit_proc_decl(const MpplAstWalker *walker, const MpplProcDecl *syntax, void *resolver)
+void resolver_enter_proc_decl(Resolver *resolver, const MpplProcDecl *syntax)
 {
   MpplToken *name_syntax = mppl_proc_decl__name(syntax);
-  try_define(resolver, DEF_PROC, (const SyntaxTree *) syntax, (SyntaxTree *) name_syntax);
+  enter_scope(resolver, DEF_PROC, (const SyntaxTree *) syntax, (SyntaxTree *) name_syntax);
   mppl_unref(name_syntax);
-  push_scope(resolver, (const SyntaxTree *) syntax);
-  mppl_ast__walk_proc_decl(walker, syntax, resolver);
-  pop_scope(resolver);
 }
 
-static void visit_var_decl(const MpplAstWalker *walker, const MpplVarDecl *syntax, void *resolver)
+void resolver_leave(Resolver *resolver)
+{
+  leave_scope(resolver);
+}
+
+void resolver_define_vars(Resolver *resolver, const MpplVarDecl *syntax)
 {
   unsigned long i;
-  Resolver *r = resolver;
-  DefKind kind = syntax_tree_kind(r->scope->syntax) == SYNTAX_PROGRAM ? DEF_VAR : DEF_LOCAL;
+  DefKind kind = syntax_tree_kind(scope_array_back(&resolver->scopes)->syntax) == SYNTAX_PROGRAM ? DEF_VAR : DEF_LOCAL;
   for (i = 0; i < mppl_var_decl__name_count(syntax); ++i) {
     MpplToken *name_syntax = mppl_var_decl__name(syntax, i);
     try_define(resolver, kind, (const SyntaxTree *) syntax, (SyntaxTree *) name_syntax);
     mppl_unref(name_syntax);
   }
-  (void) walker;
 }
 
-static void visit_fml_param_sec(const MpplAstWalker *walker, const MpplFmlParamSec *syntax, void *resolver)
+void resolver_define_params(Resolver *resolver, const MpplFmlParamSec *syntax)
 {
   unsigned long i;
   for (i = 0; i < mppl_fml_param_sec__name_count(syntax); ++i) {
@@ -192,13 +282,58 @@ static void visit_fml_param_sec(const MpplAstWalker *walker, const MpplFmlParamS
     try_define(resolver, DEF_PARAM, (const SyntaxTree *) syntax, name_syntax);
     mppl_unref(name_syntax);
   }
+}
+
+const Def *resolver_resolve_var(Resolver *resolver, const MpplToken *name_syntax)
+{
+  return try_resolve(resolver, (const SyntaxTree *) name_syntax, 0);
+}
+
+const Def *resolver_resolve_proc(Resolver *resolver, const MpplToken *name_syntax)
+{
+  const Def *proc = try_resolve(resolver, (const SyntaxTree *) name_syntax, 1);
+  if (proc && resolver->caller && def_kind(proc) == DEF_PROC) {
+    ctx_call(resolver->ctx, resolver->caller, proc, (const SyntaxTree *) name_syntax);
+    index_array_push(&resolver->call_sites, array_count(resolver->errors));
+  }
+  return proc;
+}
+
+void resolver_walk_act_param_list(Resolver *resolver, const MpplActParamList *syntax)
+{
+  mppl_ast__walk_act_param_list(&resolver->walker, syntax, resolver);
+}
+
+static void visit_program(const MpplAstWalker *walker, const MpplProgram *syntax, void *resolver)
+{
+  resolver_enter_program(resolver, syntax);
+  mppl_ast__walk_program(walker, syntax, resolver);
+  resolver_leave(resolver);
+}
+
+static void visit_proc_decl(const MpplAstWalker *walker, const MpplProcDecl *syntax, void *resolver)
+{
+  resolver_enter_proc_decl(resolver, syntax);
+  mppl_ast__walk_proc_decl(walker, syntax, resolver);
+  resolver_leave(resolver);
+}
+
+static void visit_var_decl(const MpplAstWalker *walker, const MpplVarDecl *syntax, void *resolver)
+{
+  resolver_define_vars(resolver, syntax);
+  (void) walker;
+}
+
+static void visit_fml_param_sec(const MpplAstWalker *walker, const MpplFmlParamSec *syntax, void *resolver)
+{
+  resolver_define_params(resolver, syntax);
   (void) walker;
 }
 
 static void visit_entire_var(const MpplAstWalker *walker, const MpplEntireVar *syntax, void *resolver)
 {
   MpplToken *name_syntax = mppl_entire_var__name(syntax);
-  try_resolve(resolver, (const SyntaxTree *) name_syntax, 0);
+  resolver_resolve_var(resolver, name_syntax);
   mppl_unref(name_syntax);
   (void) walker;
 }
@@ -206,7 +341,7 @@ static void visit_entire_var(const MpplAstWalker *walker, const MpplEntireVar *s
 static void visit_indexed_var(const MpplAstWalker *walker, const MpplIndexedVar *syntax, void *resolver)
 {
   MpplToken *name_syntax = mppl_indexed_var__name(syntax);
-  try_resolve(resolver, (const SyntaxTree *) name_syntax, 0);
+  resolver_resolve_var(resolver, name_syntax);
   mppl_unref(name_syntax);
   mppl_ast__walk_indexed_var(walker, syntax, resolver);
 }
@@ -214,46 +349,303 @@ static void visit_indexed_var(const MpplAstWalker *walker, const MpplIndexedVar
 static void visit_call_stmt(const MpplAstWalker *walker, const MpplCallStmt *syntax, void *resolver)
 {
   MpplToken *name_syntax = mppl_call_stmt__name(syntax);
-  const Def *proc        = try_resolve(resolver, (const SyntaxTree *) name_syntax, 1);
-  if (proc) {
-    const SyntaxTree *node;
-    for (node = (const SyntaxTree *) syntax; node; node = syntax_tree_parent(node)) {
-      if (syntax_tree_kind(node) == SYNTAX_PROC_DECL && syntax_tree_raw(node) == syntax_tree_raw(def_syntax(proc))) {
-        error_call_stmt_recursion(resolver, proc, (const SyntaxTree *) name_syntax);
+  resolver_resolve_proc(resolver, name_syntax);
+  mppl_unref(name_syntax);
+  mppl_ast__walk_call_stmt(walker, syntax, resolver);
+}
+
+static unsigned long call_graph_node(CallGraph *graph, const Def *def)
+{
+  NodeMapIndex index;
+  if (!node_map_entry(&graph->nodes, def, &index)) {
+    node_map_update(&graph->nodes, &index, def, node_map_count(&graph->nodes));
+  }
+  return node_map_value(&graph->nodes, &index);
+}
+
+static void call_graph_components(CallGraph *graph)
+{
+  unsigned long  node_count = node_map_count(&graph->nodes);
+  unsigned long  counter    = 0;
+  unsigned long  root;
+  unsigned long *order;
+  unsigned long *low;
+  unsigned long *component;
+  unsigned long *offsets = index_array_data(&graph->offsets);
+  unsigned long *edges   = index_array_data(&graph->edges);
+  unsigned long *target  = index_array_data(&graph->target);
+  IndexArray     order_array;
+  IndexArray     low_array;
+  IndexArray     stack;
+  CallFrameArray frames;
+
+  index_array_init(&order_array);
+  index_array_init(&low_array);
+  index_array_init(&stack);
+  call_frame_array_init(&frames);
+  index_array_fill(&order_array, node_count, NO_INDEX);
+  index_array_fill(&low_array, node_count, NO_INDEX);
+  index_array_fill(&graph->component, node_count, NO_INDEX);
+  order     = index_array_data(&order_array);
+  low       = index_array_data(&low_array);
+  component = index_array_data(&graph->component);
+
+  /* tarjan's algorithm with an explicit stack; a visited node is on the
+     component stack exactly when it has no component yet */
+  for (root = 0; root < node_count; ++root) {
+    unsigned long node = root;
+    if (order[root] != NO_INDEX) {
+      continue;
+    }
+
+    while (1) {
+      if (order[node] == NO_INDEX) {
+        CallFrame frame;
+        frame.node  = node;
+        frame.edge  = offsets[node];
+        order[node] = counter;
+        low[node]   = counter;
+        ++counter;
+        index_array_push(&stack, node);
+        call_frame_array_push(&frames, frame);
+      }
+
+      {
+        CallFrame *top = call_frame_array_back(&frames);
+        node           = top->node;
+        if (top->edge < offsets[node + 1]) {
+          unsigned long next = target[edges[top->edge++]];
+          if (order[next] == NO_INDEX) {
+            node = next;
+          } else if (component[next] == NO_INDEX && order[next] < low[node]) {
+            low[node] = order[next];
+          }
+          continue;
+        }
+      }
+
+      call_frame_array_pop(&frames);
+      if (low[node] == order[node]) {
+        unsigned long id   = index_array_count(&graph->component_size);
+        unsigned long size = 0;
+        unsigned long member;
+        do {
+          member = *index_array_back(&stack);
+          index_array_pop(&stack);
+          component[member] = id;
+          ++size;
+        } while (member != node);
+        index_array_push(&graph->component_size, size);
+      }
+
+      if (!call_frame_array_count(&frames)) {
         break;
+      } else {
+        unsigned long parent = call_frame_array_back(&frames)->node;
+        if (low[node] < low[parent]) {
+          low[parent] = low[node];
+        }
+        node = parent;
       }
     }
   }
-  mppl_unref(name_syntax);
-  mppl_ast__walk_call_stmt(walker, syntax, resolver);
+
+  index_array_deinit(&order_array);
+  index_array_deinit(&low_array);
+  index_array_deinit(&stack);
+  call_frame_array_deinit(&frames);
 }
 
-int mpplc_resolve(const Source *source, const MpplProgram *syntax, Ctx *ctx)
+static void call_graph_init(CallGraph *graph, const Ctx *ctx, unsigned long first)
 {
-  MpplAstWalker walker;
-  Resolver      resolver;
-  int           result = 1;
-  resolver.scope       = NULL;
-  resolver.ctx         = ctx;
-  resolver.errors      = array_new(sizeof(Report *));
-
-  mppl_ast_walker__setup(&walker);
-  walker.visit_program       = &visit_program;
-  walker.visit_proc_decl     = &visit_proc_decl;
-  walker.visit_var_decl      = &visit_var_decl;
-  walker.visit_fml_param_sec = &visit_fml_param_sec;
-  walker.visit_entire_var    = &visit_entire_var;
-  walker.visit_indexed_var   = &visit_indexed_var;
-  walker.visit_call_stmt     = &visit_call_stmt;
-  mppl_ast_walker__travel(&walker, syntax, &resolver);
-
-  if (array_count(resolver.errors)) {
+  unsigned long i;
+  unsigned long count = ctx_call_count(ctx) - first;
+  IndexArray    cursor;
+
+  index_array_init(&cursor);
+  graph->ctx   = ctx;
+  graph->first = first;
+  node_map_init(&graph->nodes);
+  index_array_init(&graph->source);
+  index_array_init(&graph->target);
+  index_array_init(&graph->offsets);
+  index_array_init(&graph->edges);
+  index_array_init(&graph->component);
+  index_array_init(&graph->component_size);
+
+  for (i = 0; i < count; ++i) {
+    const Call *call = ctx_call_at(ctx, first + i);
+    index_array_push(&graph->source, call_graph_node(graph, call_caller(call)));
+    index_array_push(&graph->target, call_graph_node(graph, call_callee(call)));
+  }
+
+  index_array_fill(&graph->offsets, node_map_count(&graph->nodes) + 1, 0);
+  for (i = 0; i < count; ++i) {
+    ++*index_array_at(&graph->offsets, *index_array_at(&graph->source, i) + 1);
+  }
+  for (i = 1; i < index_array_count(&graph->offsets); ++i) {
+    *index_array_at(&graph->offsets, i) += *index_array_at(&graph->offsets, i - 1);
+  }
+
+  index_array_fill(&graph->edges, count, 0);
+  index_array_fill(&cursor, index_array_count(&graph->offsets), 0);
+  memcpy(index_array_data(&cursor), index_array_data(&graph->offsets), sizeof(unsigned long) * index_array_count(&cursor));
+  for (i = 0; i < count; ++i) {
+    unsigned long *slot = index_array_at(&cursor, *index_array_at(&graph->source, i));
+    *index_array_at(&graph->edges, (*slot)++) = i;
+  }
+  index_array_deinit(&cursor);
+
+  call_graph_components(graph);
+}
+
+static void call_graph_deinit(CallGraph *graph)
+{
+  node_map_deinit(&graph->nodes);
+  index_array_deinit(&graph->source);
+  index_array_deinit(&graph->target);
+  index_array_deinit(&graph->offsets);
+  index_array_deinit(&graph->edges);
+  index_array_deinit(&graph->component);
+  index_array_deinit(&graph->component_size);
+}
+
+static int call_graph_is_recursive(const CallGraph *graph, unsigned long edge)
+{
+  unsigned long source    = *index_array_at(&graph->source, edge);
+  unsigned long target    = *index_array_at(&graph->target, edge);
+  unsigned long component = *index_array_at(&graph->component, source);
+  return component == *index_array_at(&graph->component, target)
+    && (source == target || *index_array_at(&graph->component_size, component) > 1);
+}
+
+/* writes the shortest cycle through `edge` as "`a` -> `b` -> `a`" */
+static void call_graph_cycle(const CallGraph *graph, unsigned long edge, StringBuilder *builder)
+{
+  unsigned long source = *index_array_at(&graph->source, edge);
+  unsigned long target = *index_array_at(&graph->target, edge);
+  unsigned long head;
+  IndexArray    via;
+  IndexArray    queue;
+  IndexArray    path;
+
+  index_array_init(&via);
+  index_array_init(&queue);
+  index_array_init(&path);
+  index_array_fill(&via, node_map_count(&graph->nodes), NO_INDEX);
+  index_array_push(&queue, target);
+  for (head = 0; head < index_array_count(&queue) && *index_array_at(&via, source) == NO_INDEX; ++head) {
+    unsigned long node = *index_array_at(&queue, head);
     unsigned long i;
-    for (i = 0; i < array_count(resolver.errors); ++i) {
-      report_emit(*(Report **) array_at(resolver.errors, i), source);
+    for (i = *index_array_at(&graph->offsets, node); i < *index_array_at(&graph->offsets, node + 1); ++i) {
+      unsigned long next = *index_array_at(&graph->edges, i);
+      unsigned long to   = *index_array_at(&graph->target, next);
+      if (to != target && *index_array_at(&via, to) == NO_INDEX) {
+        *index_array_at(&via, to) = next;
+        index_array_push(&queue, to);
+      }
+    }
+  }
+
+  for (head = source; head != target; head = *index_array_at(&graph->source, *index_array_at(&via, head))) {
+    index_array_push(&path, *index_array_at(&via, head));
+  }
+  index_array_push(&path, edge);
+
+  string_builder_printf(builder, "`%s`", string_data(def_name(call_caller(ctx_call_at(graph->ctx, graph->first + edge)))));
+  while (index_array_count(&path)) {
+    const Call *call = ctx_call_at(graph->ctx, graph->first + *index_array_back(&path));
+    string_builder_printf(builder, " -> `%s`", string_data(def_name(call_callee(call))));
+    index_array_pop(&path);
+  }
+
+  index_array_deinit(&via);
+  index_array_deinit(&queue);
+  index_array_deinit(&path);
+}
+
+static void check_recursion(Resolver *resolver, unsigned long first)
+{
+  CallGraph      graph;
+  StringBuilder *cycle  = string_builder_new();
+  Array         *errors = array_new(sizeof(Report *));
+  unsigned long  next   = 0;
+  unsigned long  i;
+
+  call_graph_init(&graph, resolver->ctx, first);
+  for (i = 0; i < index_array_count(&resolver->call_sites); ++i) {
+    if (call_graph_is_recursive(&graph, i)) {
+      unsigned long site = *index_array_at(&resolver->call_sites, i);
+      for (; next < site; ++next) {
+        array_push(errors, array_at(resolver->errors, next));
+      }
+
+      string_builder_clear(cycle);
+      if (*index_array_at(&graph.source, i) != *index_array_at(&graph.target, i)) {
+        call_graph_cycle(&graph, i, cycle);
+      }
+      error_call_stmt_recursion(errors, ctx_call_at(resolver->ctx, first + i),
+        string_builder_length(cycle) ? string_builder_data(cycle) : NULL);
+    }
+  }
+  for (; next < array_count(resolver->errors); ++next) {
+    array_push(errors, array_at(resolver->errors, next));
+  }
+
+  array_free(resolver->errors);
+  resolver->errors = errors;
+  call_graph_deinit(&graph);
+  string_builder_free(cycle);
+}
+
+Resolver *resolver_new(Ctx *ctx)
+{
+  Resolver *resolver = xmalloc(sizeof(Resolver));
+  binding_map_init(&resolver->table);
+  binding_array_init(&resolver->bindings);
+  scope_array_init(&resolver->scopes);
+  index_array_init(&resolver->call_sites);
+  resolver->caller     = NULL;
+  resolver->first_call = ctx_call_count(ctx);
+  resolver->ctx        = ctx;
+  resolver->errors     = array_new(sizeof(Report *));
+
+  mppl_ast_walker__setup(&resolver->walker);
+  resolver->walker.visit_program       = &visit_program;
+  resolver->walker.visit_proc_decl     = &visit_proc_decl;
+  resolver->walker.visit_var_decl      = &visit_var_decl;
+  resolver->walker.visit_fml_param_sec = &visit_fml_param_sec;
+  resolver->walker.visit_entire_var    = &visit_entire_var;
+  resolver->walker.visit_indexed_var   = &visit_indexed_var;
+  resolver->walker.visit_call_stmt     = &visit_call_stmt;
+  return resolver;
+}
+
+/* checks the call graph, emits the errors and frees `resolver` */
+int resolver_finish(Resolver *resolver, const Source *source)
+{
+  int result = 1;
+  check_recursion(resolver, resolver->first_call);
+
+  if (array_count(resolver->errors)) {
+    unsigned long i;
+    for (i = 0; i < array_count(resolver->errors); ++i) {
+      report_emit(*(Report **) array_at(resolver->errors, i), source);
     }
     result = 0;
   }
-  array_free(resolver.errors);
+  array_free(resolver->errors);
+  binding_map_deinit(&resolver->table);
+  binding_array_deinit(&resolver->bindings);
+  scope_array_deinit(&resolver->scopes);
+  index_array_deinit(&resolver->call_sites);
+  free(resolver);
   return result;
 }
+
+int mpplc_resolve(const Source *source, const MpplProgram *syntax, Ctx *ctx)
+{
+  Resolver *resolver = resolver_new(ctx);
+  mppl_ast_walker__travel(&resolver->walker, syntax, resolver);
+  return resolver_finish(resolver, source);
+}
@@ -0,0 +1,39 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "context_fwd.h"
+#include "mppl_syntax.h"
+#include "source.h"
+
+typedef struct Resolver Resolver;
+
+/* hooks for passes that resolve names while walking the tree themselves.
+   they must be called in the order `mpplc_resolve` would visit the nodes */
+Resolver  *resolver_new(Ctx *ctx);
+int        resolver_finish(Resolver *resolver, const Source *source);
+void       resolver_enter_program(Resolver *resolver, const MpplProgram *syntax);
+void       resolver_enter_proc_decl(Resolver *resolver, const MpplProcDecl *syntax);
+void       resolver_leave(Resolver *resolver);
+void       resolver_define_vars(Resolver *resolver, const MpplVarDecl *syntax);
+void       resolver_define_params(Resolver *resolver, const MpplFmlParamSec *syntax);
+const Def *resolver_resolve_var(Resolver *resolver, const MpplToken *name_syntax);
+const Def *resolver_resolve_proc(Resolver *resolver, const MpplToken *name_syntax);
+void       resolver_walk_act_param_list(Resolver *resolver, const MpplActParamList *syntax);
+
+#endif
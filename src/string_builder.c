@@ -0,0 +1,127 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* vsnprintf is not part of C90 */
+#define _XOPEN_SOURCE 500
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string_builder.h"
+#include "utility.h"
+
+#if defined(va_copy)
+#define string_builder_va_copy(dest, src) va_copy(dest, src)
+#elif defined(__va_copy)
+#define string_builder_va_copy(dest, src) __va_copy(dest, src)
+#else
+#define string_builder_va_copy(dest, src) ((dest) = (src))
+#endif
+
+struct StringBuilder {
+  char         *data;
+  unsigned long length;
+  unsigned long capacity;
+};
+
+static void string_builder_reserve(StringBuilder *builder, unsigned long length)
+{
+  if (length + 1 > builder->capacity) {
+    unsigned long capacity = builder->capacity;
+    while (length + 1 > capacity) {
+      capacity *= 2;
+    }
+    builder->data     = xrealloc(builder->data, capacity);
+    builder->capacity = capacity;
+  }
+}
+
+StringBuilder *string_builder_new(void)
+{
+  StringBuilder *builder = xmalloc(sizeof(StringBuilder));
+  builder->capacity      = 64;
+  builder->length        = 0;
+  builder->data          = xmalloc(builder->capacity);
+  builder->data[0]       = '\0';
+  return builder;
+}
+
+void string_builder_free(StringBuilder *builder)
+{
+  if (builder) {
+    free(builder->data);
+    free(builder);
+  }
+}
+
+void string_builder_clear(StringBuilder *builder)
+{
+  builder->length  = 0;
+  builder->data[0] = '\0';
+}
+
+void string_builder_append(StringBuilder *builder, const char *data, unsigned long length)
+{
+  string_builder_reserve(builder, builder->length + length);
+  memcpy(builder->data + builder->length, data, length);
+  builder->length += length;
+  builder->data[builder->length] = '\0';
+}
+
+void string_builder_printf(StringBuilder *builder, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  string_builder_vprintf(builder, format, args);
+  va_end(args);
+}
+
+void string_builder_vprintf(StringBuilder *builder, const char *format, va_list args)
+{
+  va_list copy;
+  int     length;
+
+  string_builder_va_copy(copy, args);
+  length = vsnprintf(builder->data + builder->length, builder->capacity - builder->length, format, copy);
+  va_end(copy);
+
+  if (length < 0) {
+    unreachable();
+  } else if (builder->length + length >= builder->capacity) {
+    string_builder_reserve(builder, builder->length + length);
+    vsnprintf(builder->data + builder->length, builder->capacity - builder->length, format, args);
+  }
+  builder->length += length;
+}
+
+const char *string_builder_data(const StringBuilder *builder)
+{
+  return builder->data;
+}
+
+unsigned long string_builder_length(const StringBuilder *builder)
+{
+  return builder->length;
+}
+
+char *string_builder_steal(StringBuilder *builder)
+{
+  char *result = builder->data;
+  free(builder);
+  return result;
+}
@@ -0,0 +1,34 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef STRING_BUILDER_H
+#define STRING_BUILDER_H
+
+#include <stdarg.h>
+
+typedef struct StringBuilder StringBuilder;
+
+StringBuilder *string_builder_new(void);
+void           string_builder_free(StringBuilder *builder);
+void           string_builder_clear(StringBuilder *builder);
+void           string_builder_append(StringBuilder *builder, const char *data, unsigned long length);
+void           string_builder_printf(StringBuilder *builder, const char *format, ...);
+void           string_builder_vprintf(StringBuilder *builder, const char *format, va_list args);
+const char    *string_builder_data(const StringBuilder *builder);
+unsigned long  string_builder_length(const StringBuilder *builder);
+char          *string_builder_steal(StringBuilder *builder);
+
+#endif
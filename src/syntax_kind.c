@@ -67,6 +67,17 @@ SyntaxKind syntax_kind_from_keyword(const char *string, unsigned long size)
   return SYNTAX_BAD_TOKEN;
 }
 
+const char *syntax_kind_to_keyword(SyntaxKind kind)
+{
+  unsigned long i;
+  for (i = 0; i < sizeof(KEYWORDS) / sizeof(Keyword); ++i) {
+    if (KEYWORDS[i].kind == kind) {
+      return KEYWORDS[i].keyword;
+    }
+  }
+  return NULL;
+}
+
 int syntax_kind_is_token(SyntaxKind kind)
 {
   return kind <= SYNTAX_EOF_TOKEN;
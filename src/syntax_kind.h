@@ -101,6 +101,7 @@ typedef enum {
 } SyntaxKind;
 
 SyntaxKind  syntax_kind_from_keyword(const char *string, unsigned long size);
+const char *syntax_kind_to_keyword(SyntaxKind kind);
 int         syntax_kind_is_token(SyntaxKind kind);
 int         syntax_kind_is_trivia(SyntaxKind kind);
 const char *syntax_kind_to_string(SyntaxKind kind);
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "array.h"
+#include "atomic.h"
 #include "context.h"
 #include "string.h"
 #include "syntax_kind.h"
@@ -32,11 +33,15 @@ struct SyntaxTree {
   unsigned long     ref;
 };
 
+DEFINE_ARRAY(OffsetArray, offset_array, unsigned long)
+DEFINE_ARRAY(NodeArray, node_array, RawSyntaxNode *)
+DEFINE_ARRAY(TriviaArray, trivia_array, RawSyntaxTrivia)
+
 struct SyntaxBuilder {
-  Array *parents;
-  Array *children;
-  Array *leading_trivia;
-  Array *trailing_trivia;
+  OffsetArray parents;
+  NodeArray   children;
+  TriviaArray leading_trivia;
+  TriviaArray trailing_trivia;
 };
 
 unsigned long raw_syntax_node_text_length(const RawSyntaxNode *node)
@@ -92,6 +97,25 @@ static void raw_syntax_node_print_impl(const RawSyntaxNode *node, unsigned long
   }
 }
 
+/* one past the largest id in the subtree of `node`, found along its rightmost path */
+unsigned long raw_syntax_node_id_end(const RawSyntaxNode *node)
+{
+  unsigned long end = node->id + 1;
+  while (!syntax_kind_is_token(node->kind)) {
+    const RawSyntaxTree *tree  = (const RawSyntaxTree *) node;
+    unsigned long        index = tree->children_count;
+    while (index > 0 && !tree->children[index - 1]) {
+      --index;
+    }
+    if (!index) {
+      break;
+    }
+    node = tree->children[index - 1];
+    end  = node->id + 1;
+  }
+  return end;
+}
+
 void raw_syntax_node_print(const RawSyntaxNode *node)
 {
   raw_syntax_node_print_impl(node, 0, 0);
@@ -131,7 +155,7 @@ const SyntaxTree *syntax_tree_ref(const SyntaxTree *tree)
 {
   SyntaxTree *mutable_tree = (SyntaxTree *) tree;
   if (tree) {
-    ++mutable_tree->ref;
+    atomic_increment(&mutable_tree->ref);
   }
   return tree;
 }
@@ -139,7 +163,7 @@ const SyntaxTree *syntax_tree_ref(const SyntaxTree *tree)
 void syntax_tree_unref(const SyntaxTree *tree)
 {
   SyntaxTree *mutable_tree = (SyntaxTree *) tree;
-  if (tree && --mutable_tree->ref == 0) {
+  if (tree && atomic_decrement(&mutable_tree->ref) == 0) {
     if (tree->parent) {
       syntax_tree_unref(tree->parent);
     } else {
@@ -230,28 +254,28 @@ void syntax_tree_visit(const SyntaxTree *tree, SyntaxTreeVisitor *visitor, void
 
 SyntaxBuilder *syntax_builder_new(void)
 {
-  SyntaxBuilder *builder   = xmalloc(sizeof(SyntaxBuilder));
-  builder->parents         = array_new(sizeof(unsigned long));
-  builder->children        = array_new(sizeof(RawSyntaxNode *));
-  builder->leading_trivia  = array_new(sizeof(RawSyntaxTrivia));
-  builder->trailing_trivia = array_new(sizeof(RawSyntaxTrivia));
+  SyntaxBuilder *builder = xmalloc(sizeof(SyntaxBuilder));
+  offset_array_init(&builder->parents);
+  node_array_init(&builder->children);
+  trivia_array_init(&builder->leading_trivia);
+  trivia_array_init(&builder->trailing_trivia);
   return builder;
 }
 
 void syntax_builder_free(SyntaxBuilder *builder)
 {
   if (builder) {
-    array_free(builder->parents);
-    array_free(builder->children);
-    array_free(builder->leading_trivia);
-    array_free(builder->trailing_trivia);
+    offset_array_deinit(&builder->parents);
+    node_array_deinit(&builder->children);
+    trivia_array_deinit(&builder->leading_trivia);
+    trivia_array_deinit(&builder->trailing_trivia);
     free(builder);
   }
 }
 
 unsigned long syntax_builder_checkpoint(SyntaxBuilder *builder)
 {
-  return array_count(builder->children);
+  return node_array_count(&builder->children);
 }
 
 void syntax_builder_start_tree(SyntaxBuilder *builder)
@@ -261,18 +285,19 @@ void syntax_builder_start_tree(SyntaxBuilder *builder)
 
 void syntax_builder_start_tree_at(SyntaxBuilder *builder, unsigned long checkpoint)
 {
-  array_push(builder->parents, &checkpoint);
+  offset_array_push(&builder->parents, checkpoint);
 }
 
 void syntax_builder_end_tree(SyntaxBuilder *builder, SyntaxKind kind)
 {
   unsigned long   i;
-  unsigned long   checkpoint = *(unsigned long *) array_back(builder->parents);
-  RawSyntaxNode **children   = (RawSyntaxNode **) array_at(builder->children, checkpoint);
-  unsigned long   count      = array_count(builder->children) - checkpoint;
+  unsigned long   checkpoint = *offset_array_back(&builder->parents);
+  RawSyntaxNode **children   = node_array_at(&builder->children, checkpoint);
+  unsigned long   count      = node_array_count(&builder->children) - checkpoint;
 
   RawSyntaxTree *tree = xmalloc(sizeof(RawSyntaxTree));
   tree->kind          = kind;
+  tree->id            = 0;
   tree->text_length   = 0;
   for (i = 0; i < count; ++i) {
     if (i > 0) {
@@ -284,15 +309,14 @@ void syntax_builder_end_tree(SyntaxBuilder *builder, SyntaxKind kind)
   tree->children_count = count;
   tree->children       = dup(children, sizeof(RawSyntaxNode *), count);
 
-  array_pop(builder->parents);
-  array_pop_count(builder->children, count);
-  array_push(builder->children, &tree);
+  offset_array_pop(&builder->parents);
+  node_array_pop_count(&builder->children, count);
+  node_array_push(&builder->children, (RawSyntaxNode *) tree);
 }
 
 void syntax_builder_null(SyntaxBuilder *builder)
 {
-  RawSyntaxNode *node = NULL;
-  array_push(builder->children, &node);
+  node_array_push(&builder->children, NULL);
 }
 
 void syntax_builder_trivia(SyntaxBuilder *builder, SyntaxKind kind, const String *text, int leading)
@@ -302,9 +326,9 @@ void syntax_builder_trivia(SyntaxBuilder *builder, SyntaxKind kind, const String
   trivia.string = text;
 
   if (leading) {
-    array_push(builder->leading_trivia, &trivia);
+    trivia_array_push(&builder->leading_trivia, trivia);
   } else {
-    array_push(builder->trailing_trivia, &trivia);
+    trivia_array_push(&builder->trailing_trivia, trivia);
   }
 }
 
@@ -312,22 +336,39 @@ void syntax_builder_token(SyntaxBuilder *builder, SyntaxKind kind, const String
 {
   RawSyntaxToken *token = xmalloc(sizeof(RawSyntaxToken));
   token->kind           = kind;
+  token->id             = 0;
   token->string         = text;
 
-  token->leading_trivia_count  = array_count(builder->leading_trivia);
-  token->leading_trivia        = dup(array_data(builder->leading_trivia), sizeof(RawSyntaxTrivia), token->leading_trivia_count);
-  token->trailing_trivia_count = array_count(builder->trailing_trivia);
-  token->trailing_trivia       = dup(array_data(builder->trailing_trivia), sizeof(RawSyntaxTrivia), token->trailing_trivia_count);
-  array_push(builder->children, &token);
+  token->leading_trivia_count  = trivia_array_count(&builder->leading_trivia);
+  token->leading_trivia        = dup(trivia_array_data(&builder->leading_trivia), sizeof(RawSyntaxTrivia), token->leading_trivia_count);
+  token->trailing_trivia_count = trivia_array_count(&builder->trailing_trivia);
+  token->trailing_trivia       = dup(trivia_array_data(&builder->trailing_trivia), sizeof(RawSyntaxTrivia), token->trailing_trivia_count);
+  node_array_push(&builder->children, (RawSyntaxNode *) token);
+
+  trivia_array_clear(&builder->leading_trivia);
+  trivia_array_clear(&builder->trailing_trivia);
+}
 
-  array_clear(builder->leading_trivia);
-  array_clear(builder->trailing_trivia);
+static unsigned long raw_syntax_node_number(RawSyntaxNode *node, unsigned long id)
+{
+  if (node) {
+    node->id = id++;
+    if (!syntax_kind_is_token(node->kind)) {
+      RawSyntaxTree *tree = (RawSyntaxTree *) node;
+      unsigned long  i;
+      for (i = 0; i < tree->children_count; ++i) {
+        id = raw_syntax_node_number(tree->children[i], id);
+      }
+    }
+  }
+  return id;
 }
 
 SyntaxTree *syntax_builder_build(SyntaxBuilder *builder)
 {
-  RawSyntaxNode **root = (RawSyntaxNode **) array_front(builder->children);
+  RawSyntaxNode **root = node_array_at(&builder->children, 0);
   SyntaxTree     *tree = syntax_tree_new(NULL, *root, raw_syntax_node_trivia_length(*root));
+  raw_syntax_node_number(*root, 0);
   syntax_builder_free(builder);
   return tree;
 }
@@ -37,6 +37,7 @@ struct RawSyntaxTrivia {
 
 struct RawSyntaxToken {
   SyntaxKind       kind;
+  unsigned long    id;
   const String    *string;
   unsigned long    leading_trivia_count;
   RawSyntaxTrivia *leading_trivia;
@@ -46,18 +47,21 @@ struct RawSyntaxToken {
 
 struct RawSyntaxTree {
   SyntaxKind      kind;
+  unsigned long   id;
   unsigned long   text_length;
   unsigned long   children_count;
   RawSyntaxNode **children;
 };
 
+/* `id` is the preorder index of the node, assigned by `syntax_builder_build` */
 struct RawSyntaxNode {
   SyntaxKind    kind;
-  unsigned long text_length;
+  unsigned long id;
 };
 
 unsigned long raw_syntax_node_text_length(const RawSyntaxNode *node);
 unsigned long raw_syntax_node_trivia_length(const RawSyntaxNode *node);
+unsigned long raw_syntax_node_id_end(const RawSyntaxNode *node);
 
 void raw_syntax_node_print(const RawSyntaxNode *node);
 void raw_syntax_node_free(RawSyntaxNode *node);
@@ -82,9 +82,9 @@ static void increment_token(Map *counts, SyntaxKind kind, const char *text, unsi
 static unsigned long counter_token_hash(const void *key)
 {
   const CounterToken *token = key;
-  unsigned long       hash  = FNV1A_INIT;
-  hash                      = fnv1a(hash, &token->kind, sizeof(SyntaxKind));
-  hash                      = fnv1a(hash, token->text, token->text_length);
+  unsigned long       hash  = HASH_INIT;
+  hash                      = hash_bytes(hash, &token->kind, sizeof(SyntaxKind));
+  hash                      = hash_bytes(hash, token->text, token->text_length);
   return hash;
 }
 
@@ -362,7 +362,7 @@ int mpplc_task4(int argc, const char **argv)
       fprintf(stderr, "Cannot open file: %s\n", argv[1]);
       status = EXIT_FAILURE;
     } else if (mpplc_parse(source, ctx, &syntax) && mpplc_resolve(source, syntax, ctx) && mpplc_check(source, syntax, ctx)) {
-      mpplc_codegen_casl2(source, syntax, ctx);
+      mpplc_codegen_casl2(source, syntax, ctx, NULL);
     }
     mppl_unref(syntax);
     source_free(source);
@@ -0,0 +1,122 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdlib.h>
+
+#include "thread.h"
+#include "utility.h"
+
+#ifdef MPPLC_THREAD_SAFE
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#endif
+
+struct Thread {
+  void (*func)(void *data);
+  void *data;
+  int   started;
+#ifdef MPPLC_THREAD_SAFE
+#if defined(_WIN32)
+  HANDLE handle;
+#else
+  pthread_t handle;
+#endif
+#endif
+};
+
+#ifdef MPPLC_THREAD_SAFE
+
+#if defined(_WIN32)
+
+static DWORD WINAPI thread_main(LPVOID thread)
+{
+  Thread *self = thread;
+  self->func(self->data);
+  return 0;
+}
+
+static int thread_start(Thread *thread)
+{
+  thread->handle = CreateThread(NULL, 0, &thread_main, thread, 0, NULL);
+  return thread->handle != NULL;
+}
+
+static void thread_wait(Thread *thread)
+{
+  WaitForSingleObject(thread->handle, INFINITE);
+  CloseHandle(thread->handle);
+}
+
+#else
+
+static void *thread_main(void *thread)
+{
+  Thread *self = thread;
+  self->func(self->data);
+  return NULL;
+}
+
+static int thread_start(Thread *thread)
+{
+  return pthread_create(&thread->handle, NULL, &thread_main, thread) == 0;
+}
+
+static void thread_wait(Thread *thread)
+{
+  pthread_join(thread->handle, NULL);
+}
+
+#endif
+
+#else
+
+static int thread_start(Thread *thread)
+{
+  (void) thread;
+  return 0;
+}
+
+static void thread_wait(Thread *thread)
+{
+  (void) thread;
+}
+
+#endif
+
+Thread *thread_spawn(void (*func)(void *data), void *data)
+{
+  Thread *thread  = xmalloc(sizeof(Thread));
+  thread->func    = func;
+  thread->data    = data;
+  thread->started = thread_start(thread);
+  if (!thread->started) {
+    func(data);
+  }
+  return thread;
+}
+
+void thread_join(Thread *thread)
+{
+  if (thread->started) {
+    thread_wait(thread);
+  }
+  free(thread);
+}
@@ -0,0 +1,27 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef THREAD_H
+#define THREAD_H
+
+typedef struct Thread Thread;
+
+/* without MPPLC_THREAD_SAFE, or when no thread can be created,
+   `thread_spawn` runs `func` to completion before returning */
+Thread *thread_spawn(void (*func)(void *data), void *data);
+void    thread_join(Thread *thread);
+
+#endif
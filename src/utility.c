@@ -30,6 +30,16 @@ void *xmalloc(unsigned long size)
   return result;
 }
 
+void *xrealloc(void *ptr, unsigned long size)
+{
+  void *result = realloc(ptr, size);
+  if (!result) {
+    fprintf(stderr, "Internal Error: Failed to allocate memory. Aborted.");
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
 void *dup(const void *ptr, unsigned long size, unsigned long count)
 {
   if (count == 0) {
@@ -53,6 +63,67 @@ unsigned long fnv1a(unsigned long hash, const void *ptr, unsigned long len)
   return 0xFFFFFFFFul & hash;
 }
 
+#if ULONG_MAX > 0xFFFFFFFFul
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ul
+#else
+#define HASH_MULTIPLIER 0x9E3779B9ul
+#endif
+
+/* the splitmix64 finalizer, or murmur3's fmix32 where unsigned long is 32 bits wide */
+static unsigned long hash_mix(unsigned long hash)
+{
+#if ULONG_MAX > 0xFFFFFFFFul
+  hash ^= hash >> 30;
+  hash *= 0xBF58476D1CE4E5B9ul;
+  hash ^= hash >> 27;
+  hash *= 0x94D049BB133111EBul;
+  hash ^= hash >> 31;
+#else
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6Bul;
+  hash ^= hash >> 13;
+  hash *= 0xC2B2AE35ul;
+  hash ^= hash >> 16;
+#endif
+  return hash;
+}
+
+static unsigned long load32(const unsigned char *data)
+{
+  return (unsigned long) data[0] | (unsigned long) data[1] << 8 | (unsigned long) data[2] << 16 | (unsigned long) data[3] << 24;
+}
+
+unsigned long hash_bytes(unsigned long hash, const void *ptr, unsigned long len)
+{
+  const unsigned char *data = ptr;
+  unsigned long        word;
+
+  /* spread the length so that it cannot cancel against the low bytes of a short key */
+  hash ^= len * HASH_MULTIPLIER;
+  if (len >= sizeof(word)) {
+    for (; len > sizeof(word); data += sizeof(word), len -= sizeof(word)) {
+      memcpy(&word, data, sizeof(word));
+      hash = hash_mix(hash ^ word);
+    }
+    /* the last word may overlap the previous one */
+    memcpy(&word, data + len - sizeof(word), sizeof(word));
+  } else if (len >= 4) {
+    word = load32(data) | load32(data + len - 4) << (ULONG_BIT / 2);
+  } else if (len > 0) {
+    word = (unsigned long) data[0] << 16 | (unsigned long) data[len / 2] << 8 | data[len - 1];
+  } else {
+    return hash;
+  }
+  return hash_mix(hash ^ word);
+}
+
+unsigned long hash_pointer(const void *ptr)
+{
+  unsigned long value = 0;
+  memcpy(&value, &ptr, sizeof(ptr) < sizeof(value) ? sizeof(ptr) : sizeof(value));
+  return hash_mix(value);
+}
+
 unsigned long popcount(void *data, unsigned long count)
 {
   static const unsigned char table[] = {
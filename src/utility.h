@@ -22,14 +22,28 @@
 #include <stdlib.h>
 
 void *xmalloc(unsigned long size);
+void *xrealloc(void *ptr, unsigned long size);
 void *dup(const void *ptr, unsigned long size, unsigned long count);
 
 #define FNV1A_INIT 0x811C9DC5ul
 
 unsigned long fnv1a(unsigned long hash, const void *ptr, unsigned long len);
 
+#define HASH_INIT 0x243F6A88ul
+
+unsigned long hash_bytes(unsigned long hash, const void *ptr, unsigned long len);
+unsigned long hash_pointer(const void *ptr);
+
 unsigned long popcount(void *data, unsigned long size);
 
+#if defined(__GNUC__) || defined(__clang__)
+#define INLINE __inline__
+#elif defined(_MSC_VER)
+#define INLINE __inline
+#else
+#define INLINE
+#endif
+
 #define ULONG_BIT (sizeof(unsigned long) * CHAR_BIT)
 
 #define BITSET(name, bits) unsigned long name[(bits + ULONG_BIT - 1) / ULONG_BIT]
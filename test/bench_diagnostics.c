@@ -0,0 +1,127 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "compiler.h"
+#include "context.h"
+#include "mppl_syntax.h"
+#include "source.h"
+#include "utility.h"
+
+/* renders PROCEDURES * ASSIGNMENTS type errors and reports the median cpu time */
+
+static const char *program_path = "bench_diagnostics.mpl";
+static const char *report_path  = "bench_diagnostics.err";
+
+static void write_program(unsigned long procedures, unsigned long assignments)
+{
+  unsigned long i, j;
+  FILE         *file = fopen(program_path, "w");
+
+  if (!file) {
+    fprintf(stderr, "Cannot open file: %s\n", program_path);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(file, "program diagnostics;\n");
+  fprintf(file, "var c : char;\n");
+  for (i = 0; i < procedures; ++i) {
+    fprintf(file, "procedure p%lu;\n", i);
+    fprintf(file, "var x : integer;\n");
+    fprintf(file, "begin\n");
+    for (j = 0; j < assignments; ++j) {
+      switch (j % 3) {
+      case 0:
+        fprintf(file, "  x := 'a';\n");
+        break;
+      case 1:
+        fprintf(file, "  x := true;\n");
+        break;
+      default:
+        fprintf(file, "  c := %lu;\n", j);
+        break;
+      }
+    }
+    fprintf(file, "  x := 0\n");
+    fprintf(file, "end;\n");
+  }
+  fprintf(file, "begin\n");
+  fprintf(file, "  c := 'a'\n");
+  fprintf(file, "end.\n");
+  fclose(file);
+}
+
+static double run(void)
+{
+  clock_t      start;
+  clock_t      end;
+  Ctx         *ctx    = ctx_new();
+  Source      *source = source_new(program_path, strlen(program_path));
+  MpplProgram *syntax = NULL;
+
+  start = clock();
+  if (mpplc_parse(source, ctx, &syntax)) {
+    if (mpplc_resolve(source, syntax, ctx)) {
+      mpplc_check(source, syntax, ctx);
+    }
+  }
+  end = clock();
+
+  mppl_unref(syntax);
+  source_free(source);
+  ctx_free(ctx);
+  return (double) (end - start) / CLOCKS_PER_SEC;
+}
+
+static int compare_double(const void *left, const void *right)
+{
+  double l = *(const double *) left;
+  double r = *(const double *) right;
+  return (l > r) - (l < r);
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned long procedures  = argc > 1 ? strtoul(argv[1], NULL, 10) : 500;
+  unsigned long assignments = argc > 2 ? strtoul(argv[2], NULL, 10) : 20;
+  unsigned long runs        = argc > 3 ? strtoul(argv[3], NULL, 10) : 5;
+  unsigned long i;
+  double       *times;
+
+  if (runs == 0) {
+    runs = 1;
+  }
+  times = xmalloc(sizeof(double) * runs);
+
+  write_program(procedures, assignments);
+  if (!freopen(report_path, "w", stderr)) {
+    free(times);
+    return EXIT_FAILURE;
+  }
+
+  for (i = 0; i < runs; ++i) {
+    times[i] = run();
+  }
+  qsort(times, runs, sizeof(double), &compare_double);
+
+  printf("%lu diagnostics, median of %lu runs: %.3f s\n", procedures * assignments, runs, times[runs / 2]);
+  free(times);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utility.h"
+
+/* compares fnv1a with hash_bytes on fixed-length keys and on identifiers
+   lexed from the files given on the command line, and fnv1a over pointer
+   bytes with hash_pointer */
+
+#define BUFFER_COUNT 64
+
+typedef struct Header Header;
+
+/* shaped like the interner's String headers */
+struct Header {
+  const char   *data;
+  unsigned long length;
+};
+
+static volatile unsigned long sink;
+
+static double elapsed_ns(clock_t start, unsigned long count)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / count;
+}
+
+static void bench_fixed(unsigned long repeat)
+{
+  static const unsigned long lengths[] = { 1, 2, 3, 4, 8, 16, 32 };
+
+  static char buffers[BUFFER_COUNT][32];
+
+  unsigned long i, j, k;
+
+  for (i = 0; i < BUFFER_COUNT; ++i) {
+    for (j = 0; j < 32; ++j) {
+      buffers[i][j] = (char) ('a' + (i * 7 + j * 3) % 26);
+    }
+  }
+
+  printf("fixed-length keys, %d rotating buffers (ns/key)\n", BUFFER_COUNT);
+  printf("  len       ");
+  for (k = 0; k < sizeof(lengths) / sizeof(*lengths); ++k) {
+    printf("%7lu", lengths[k]);
+  }
+  printf("\n  fnv1a     ");
+  for (k = 0; k < sizeof(lengths) / sizeof(*lengths); ++k) {
+    clock_t start = clock();
+    for (i = 0; i < repeat; ++i) {
+      for (j = 0; j < BUFFER_COUNT; ++j) {
+        sink ^= fnv1a(FNV1A_INIT, buffers[j], lengths[k]);
+      }
+    }
+    printf("%7.2f", elapsed_ns(start, repeat * BUFFER_COUNT));
+  }
+  printf("\n  hash_bytes");
+  for (k = 0; k < sizeof(lengths) / sizeof(*lengths); ++k) {
+    clock_t start = clock();
+    for (i = 0; i < repeat; ++i) {
+      for (j = 0; j < BUFFER_COUNT; ++j) {
+        sink ^= hash_bytes(HASH_INIT, buffers[j], lengths[k]);
+      }
+    }
+    printf("%7.2f", elapsed_ns(start, repeat * BUFFER_COUNT));
+  }
+  printf("\n");
+}
+
+static void bench_pointers(unsigned long repeat)
+{
+  unsigned long i, j;
+  clock_t       start;
+  Header       *headers = xmalloc(sizeof(Header) * BUFFER_COUNT);
+
+  printf("pointer keys at a %lu-byte stride (ns/key)\n", (unsigned long) sizeof(Header));
+  start = clock();
+  for (i = 0; i < repeat; ++i) {
+    for (j = 0; j < BUFFER_COUNT; ++j) {
+      const Header *header = headers + j;
+      sink ^= fnv1a(FNV1A_INIT, &header, sizeof(header));
+    }
+  }
+  printf("  fnv1a        %.2f\n", elapsed_ns(start, repeat * BUFFER_COUNT));
+  start = clock();
+  for (i = 0; i < repeat; ++i) {
+    for (j = 0; j < BUFFER_COUNT; ++j) {
+      sink ^= hash_pointer(headers + j);
+    }
+  }
+  printf("  hash_pointer %.2f\n", elapsed_ns(start, repeat * BUFFER_COUNT));
+  free(headers);
+}
+
+static void bench_identifiers(int argc, const char **argv, unsigned long repeat)
+{
+  char          *text    = NULL;
+  unsigned long  length  = 0;
+  unsigned long *offsets = NULL;
+  unsigned long *lengths = NULL;
+  unsigned long  count   = 0;
+  unsigned long  total   = 0;
+  unsigned long  i, j;
+  clock_t        start;
+  int            file;
+
+  for (file = 0; file < argc; ++file) {
+    FILE *stream = fopen(argv[file], "rb");
+    int   c;
+    if (!stream) {
+      fprintf(stderr, "Cannot open file: %s\n", argv[file]);
+      continue;
+    }
+    while ((c = fgetc(stream)) != EOF) {
+      if (length % 4096 == 0) {
+        text = xrealloc(text, length + 4096);
+      }
+      text[length++] = (char) c;
+    }
+    if (length % 4096 == 0) {
+      text = xrealloc(text, length + 4096);
+    }
+    text[length++] = '\n';
+    fclose(stream);
+  }
+
+  /* [A-Za-z][A-Za-z0-9]*, keywords included */
+  for (i = 0; i < length;) {
+    if (is_alphabet(text[i])) {
+      j = i;
+      while (j < length && (is_alphabet(text[j]) || is_number(text[j]))) {
+        ++j;
+      }
+      if (count % 1024 == 0) {
+        offsets = xrealloc(offsets, sizeof(unsigned long) * (count + 1024));
+        lengths = xrealloc(lengths, sizeof(unsigned long) * (count + 1024));
+      }
+      offsets[count] = i;
+      lengths[count] = j - i;
+      total += j - i;
+      ++count;
+      i = j;
+    } else {
+      ++i;
+    }
+  }
+
+  if (count) {
+    printf("%lu identifiers from %d files, mean length %.2f (ns/key)\n", count, argc, (double) total / count);
+    start = clock();
+    for (i = 0; i < repeat; ++i) {
+      for (j = 0; j < count; ++j) {
+        sink ^= fnv1a(FNV1A_INIT, text + offsets[j], lengths[j]);
+      }
+    }
+    printf("  fnv1a      %.2f\n", elapsed_ns(start, repeat * count));
+    start = clock();
+    for (i = 0; i < repeat; ++i) {
+      for (j = 0; j < count; ++j) {
+        sink ^= hash_bytes(HASH_INIT, text + offsets[j], lengths[j]);
+      }
+    }
+    printf("  hash_bytes %.2f\n", elapsed_ns(start, repeat * count));
+  }
+  free(text);
+  free(offsets);
+  free(lengths);
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned long repeat = 200000;
+
+  if (argc > 2 && strcmp(argv[1], "--repeat") == 0) {
+    repeat = strtoul(argv[2], NULL, 10);
+    argc -= 2;
+    argv += 2;
+  }
+
+  bench_fixed(repeat);
+  bench_pointers(repeat);
+  bench_identifiers(argc - 1, argv + 1, repeat / 40 + 1);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* clock_gettime is not part of C90 */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "interner.h"
+#include "thread.h"
+#include "utility.h"
+
+/* THREADS workers intern STRINGS identifiers ROUNDS times into one Interner;
+   half of the identifiers are shared by all workers and half are private */
+
+#ifndef MPPLC_INTERNER_SHARDS
+#define MPPLC_INTERNER_SHARDS 1
+#endif
+
+typedef struct Worker Worker;
+
+struct Worker {
+  Interner     *interner;
+  char        **names;
+  unsigned long count;
+  unsigned long rounds;
+};
+
+static double now(void)
+{
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0
+  struct timespec spec;
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+  return spec.tv_sec + spec.tv_nsec / 1e9;
+#else
+  return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void work(void *data)
+{
+  Worker       *worker = data;
+  unsigned long i, j;
+
+  for (i = 0; i < worker->rounds; ++i) {
+    for (j = 0; j < worker->count; ++j) {
+      const char *name = worker->names[j];
+      interner_intern(worker->interner, name, strlen(name));
+    }
+  }
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned long threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 4;
+  unsigned long strings = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+  unsigned long rounds  = argc > 3 ? strtoul(argv[3], NULL, 10) : 50;
+  unsigned long expected;
+  unsigned long count;
+  unsigned long bytes;
+  unsigned long reserved;
+  unsigned long i, j;
+  Interner     *interner;
+  Worker       *workers;
+  Thread      **handles;
+  double        start;
+  double        elapsed;
+
+  if (threads == 0) {
+    threads = 1;
+  }
+  interner = interner_new();
+  interner_stats(interner, &expected, &bytes, &reserved);
+  expected += (strings + 1) / 2 + threads * (strings / 2);
+  workers  = xmalloc(sizeof(Worker) * threads);
+  handles  = xmalloc(sizeof(Thread *) * threads);
+  for (i = 0; i < threads; ++i) {
+    workers[i].interner = interner;
+    workers[i].names    = xmalloc(sizeof(char *) * strings);
+    workers[i].count    = strings;
+    workers[i].rounds   = rounds;
+    for (j = 0; j < strings; ++j) {
+      workers[i].names[j] = xmalloc(32);
+      if (j % 2 == 0) {
+        sprintf(workers[i].names[j], "shared_%lu", j);
+      } else {
+        sprintf(workers[i].names[j], "t%lu_private_%lu", i, j);
+      }
+    }
+  }
+
+  start = now();
+  for (i = 0; i < threads; ++i) {
+    handles[i] = thread_spawn(&work, workers + i);
+  }
+  for (i = 0; i < threads; ++i) {
+    thread_join(handles[i]);
+  }
+  elapsed = now() - start;
+  interner_stats(interner, &count, &bytes, &reserved);
+
+  for (i = 0; i < threads; ++i) {
+    for (j = 0; j < strings; ++j) {
+      free(workers[i].names[j]);
+    }
+    free(workers[i].names);
+  }
+  free(handles);
+  free(workers);
+  interner_free(interner);
+
+  printf("%d shards, %lu threads, %lu lookups: %.3f s\n",
+    MPPLC_INTERNER_SHARDS, threads, threads * strings * rounds, elapsed);
+  if (count != expected) {
+    fprintf(stderr, "interned %lu strings, expected %lu\n", count, expected);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "map.h"
+#include "utility.h"
+
+/* times Map on the key shapes of the compiler's tables; built once for each
+   backend so that map.c and map_swiss.c can be compared run against run.
+
+   - pointer keys with the default hasher, as in the CASL2 `symbols` map and
+     the resolver scopes keyed by interned names. 8 and 48 entries are typical
+     scopes and 1000 a whole program; 7000 and 114000 sit just below the point
+     where the SwissTable grows (85% and 87% full), and 1000000 just above it
+   - pointer keys whose hashes differ only above bit 16, which packs them into
+     one hopscotch neighborhood
+   - string keys hashed and compared by content, as in the interner
+   - (element, length) keys, as in the array type table of Ctx
+   - scopes cleared and refilled with a handful of names, as in the resolver */
+
+#ifndef MAP_BACKEND
+#define MAP_BACKEND "map"
+#endif
+
+#define NAME_COUNT  20000
+#define TYPE_COUNT  5000
+#define SCOPE_NAMES 12
+
+typedef struct Header  Header;
+typedef struct TypeKey TypeKey;
+
+/* shaped like the interner's String headers */
+struct Header {
+  const char   *data;
+  unsigned long length;
+};
+
+/* shaped like ArrayTypeKey */
+struct TypeKey {
+  unsigned long element;
+  unsigned long length;
+};
+
+static volatile unsigned long sink;
+
+static double elapsed_ns(clock_t start, unsigned long count)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / count;
+}
+
+static unsigned long clustered_hash(const void *key)
+{
+  return (unsigned long) ((const Header *) key)->length << 16;
+}
+
+static unsigned long header_hash(const void *key)
+{
+  const Header *header = key;
+  return hash_bytes(HASH_INIT, header->data, header->length);
+}
+
+static int header_equal(const void *left, const void *right)
+{
+  const Header *l = left;
+  const Header *r = right;
+  return l->length == r->length && memcmp(l->data, r->data, l->length) == 0;
+}
+
+static unsigned long type_key_hash(const void *key)
+{
+  return hash_bytes(HASH_INIT, key, sizeof(TypeKey));
+}
+
+static int type_key_equal(const void *left, const void *right)
+{
+  const TypeKey *l = left;
+  const TypeKey *r = right;
+  return l->element == r->element && l->length == r->length;
+}
+
+/* insert `count` of `keys` into a new map `builds` times, then look up `lookups`
+   keys cycling through all of `keys`, of which the second half are missing */
+static void bench_lookups(const char *label, MapHasher *hasher, Header *keys, unsigned long count, unsigned long builds, unsigned long lookups)
+{
+  Map          *map = NULL;
+  MapIndex      index;
+  clock_t       start;
+  double        insert;
+  unsigned long i, j;
+
+  start = clock();
+  for (j = 0; j < builds; ++j) {
+    map_free(map);
+    map = map_new(hasher, NULL);
+    for (i = 0; i < count; ++i) {
+      map_entry(map, keys + i, &index);
+      map_update(map, &index, keys + i, keys + i);
+    }
+  }
+  insert = elapsed_ns(start, builds * count);
+
+  start = clock();
+  for (i = j = 0; i < lookups; ++i) {
+    sink ^= map_entry(map, keys + j, &index);
+    if (++j == count * 2) {
+      j = 0;
+    }
+  }
+  printf("  %-10s%9lu%10.1f%10.1f\n", label, count, insert, elapsed_ns(start, lookups));
+  map_free(map);
+}
+
+static void bench_pointers(unsigned long lookups)
+{
+  static const unsigned long counts[] = { 8, 48, 1000, 7000, 114000, 1000000 };
+
+  unsigned long max  = counts[sizeof(counts) / sizeof(*counts) - 1];
+  Header       *keys = xmalloc(sizeof(Header) * max * 2);
+  unsigned long i;
+
+  for (i = 0; i < max * 2; ++i) {
+    keys[i].data   = NULL;
+    keys[i].length = i;
+  }
+
+  printf("pointer keys, lookups with 50%% hits (ns/op)\n");
+  printf("  %-10s%9s%10s%10s\n", "", "n", "insert", "lookup");
+  for (i = 0; i < sizeof(counts) / sizeof(*counts); ++i) {
+    bench_lookups("default", NULL, keys, counts[i], lookups / 20 / counts[i] + 1, lookups);
+  }
+  /* hopscotch doubles its table for every few of these, so they are built once */
+  bench_lookups("clustered", &clustered_hash, keys, 48, 1, lookups);
+  bench_lookups("clustered", &clustered_hash, keys, 1000, 1, lookups);
+  free(keys);
+}
+
+/* intern `calls` names drawn from NAME_COUNT identifiers, inserting the misses */
+static void bench_interner(unsigned long calls)
+{
+  char         *text    = xmalloc(NAME_COUNT * 16);
+  Header       *names   = xmalloc(sizeof(Header) * NAME_COUNT);
+  Map          *map     = map_new(&header_hash, &header_equal);
+  unsigned long state   = 1;
+  unsigned long offset  = 0;
+  unsigned long i;
+  clock_t       start;
+
+  for (i = 0; i < NAME_COUNT; ++i) {
+    names[i].data   = text + offset;
+    names[i].length = (unsigned long) sprintf(text + offset, "%c%lu", (char) ('a' + i % 26), i * 7919 % 100003);
+    offset += names[i].length;
+  }
+
+  start = clock();
+  for (i = 0; i < calls; ++i) {
+    MapIndex index;
+    Header  *name;
+
+    /* favor the first names the way keywords and locals dominate a program */
+    state = state * 1103515245ul + 12345ul;
+    name  = names + ((state >> 8) % NAME_COUNT) * ((state >> 4) % 4 + 1) / 4;
+    if (!map_entry(map, name, &index)) {
+      map_update(map, &index, name, name);
+    }
+    sink ^= (unsigned long) map_value(map, &index);
+  }
+  printf("interner, %lu calls on %lu names (ns/op)\n  %.1f\n", calls, map_count(map), elapsed_ns(start, calls));
+
+  map_free(map);
+  free(names);
+  free(text);
+}
+
+/* look up or insert array types over TYPE_COUNT (element, length) pairs */
+static void bench_types(unsigned long rounds)
+{
+  TypeKey      *keys  = xmalloc(sizeof(TypeKey) * TYPE_COUNT);
+  Map          *map   = map_new(&type_key_hash, &type_key_equal);
+  unsigned long state = 1;
+  unsigned long i;
+  clock_t       start;
+
+  for (i = 0; i < TYPE_COUNT; ++i) {
+    keys[i].element = i % 4;
+    keys[i].length  = i / 4 + 1;
+  }
+
+  start = clock();
+  for (i = 0; i < rounds; ++i) {
+    MapIndex index;
+    TypeKey *key;
+
+    state = state * 1103515245ul + 12345ul;
+    key   = keys + (state >> 8) % TYPE_COUNT;
+    if (!map_entry(map, key, &index)) {
+      map_update(map, &index, key, key);
+    }
+    sink ^= (unsigned long) map_value(map, &index);
+  }
+  printf("array types, %lu rounds on %lu types (ns/op)\n  %.1f\n", rounds, map_count(map), elapsed_ns(start, rounds));
+
+  map_free(map);
+  free(keys);
+}
+
+/* fill a scope with SCOPE_NAMES names, look each up four times, clear it */
+static void bench_scopes(unsigned long lookups)
+{
+  Header       *keys   = xmalloc(sizeof(Header) * SCOPE_NAMES);
+  Map          *map    = map_new(NULL, NULL);
+  unsigned long scopes = lookups / (SCOPE_NAMES * 4) + 1;
+  unsigned long i, j;
+  clock_t       start;
+
+  start = clock();
+  for (i = 0; i < scopes; ++i) {
+    MapIndex index;
+    for (j = 0; j < SCOPE_NAMES; ++j) {
+      map_entry(map, keys + j, &index);
+      map_update(map, &index, keys + j, keys + j);
+    }
+    for (j = 0; j < SCOPE_NAMES * 4; ++j) {
+      sink ^= map_entry(map, keys + j % SCOPE_NAMES, &index);
+    }
+    map_clear(map);
+  }
+  printf("scopes of %d names, filled, read and cleared (ns/scope)\n  %.1f\n", SCOPE_NAMES, elapsed_ns(start, scopes));
+
+  map_free(map);
+  free(keys);
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned long lookups = 20000000;
+
+  if (argc > 2 && strcmp(argv[1], "--lookups") == 0) {
+    lookups = strtoul(argv[2], NULL, 10);
+  }
+
+  printf("backend: %s\n", MAP_BACKEND);
+  bench_pointers(lookups);
+  bench_interner(lookups / 20);
+  bench_types(lookups / 10);
+  bench_scopes(lookups);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,719 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utility.h"
+
+/* assembles a CASL2 program as emitted by mpplc and runs it on a COMET2 model.
+   IN reads one line from stdin and OUT writes the buffer as one line. the exit status
+   is the operand of SVC, 0 when the program returns to the os, 124 when the
+   step limit is hit and 125 when the program cannot be assembled or run */
+
+#define MEMORY_SIZE   65536ul
+#define LINE_LENGTH   4096
+#define OPERAND_COUNT 64
+#define RECORD_LENGTH 256
+
+#define STATUS_LIMIT 124
+#define STATUS_FAULT 125
+
+typedef enum {
+  OP_NONE,
+  OP_LD,
+  OP_ST,
+  OP_LAD,
+  OP_ADDA,
+  OP_SUBA,
+  OP_ADDL,
+  OP_SUBL,
+  OP_MULA,
+  OP_DIVA,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_CPA,
+  OP_CPL,
+  OP_JMI,
+  OP_JNZ,
+  OP_JZE,
+  OP_JUMP,
+  OP_JPL,
+  OP_JOV,
+  OP_PUSH,
+  OP_POP,
+  OP_CALL,
+  OP_RET,
+  OP_SVC,
+  OP_NOP,
+  OP_IN,
+  OP_OUT
+} Opcode;
+
+typedef struct Inst   Inst;
+typedef struct Line   Line;
+typedef struct Symbol Symbol;
+
+struct Inst {
+  Opcode        op;
+  int           register_form;
+  int           r;
+  int           x;
+  unsigned long adr;
+};
+
+struct Line {
+  unsigned long number;
+  char         *label;
+  char         *op;
+  char         *operands[OPERAND_COUNT];
+  int           operand_count;
+};
+
+struct Symbol {
+  const char   *name;
+  unsigned long address;
+};
+
+static const char *opcode_names[] = {
+  "", "LD", "ST", "LAD", "ADDA", "SUBA", "ADDL", "SUBL", "MULA", "DIVA", "AND", "OR", "XOR", "CPA", "CPL",
+  "JMI", "JNZ", "JZE", "JUMP", "JPL", "JOV", "PUSH", "POP", "CALL", "RET", "SVC", "NOP", "IN", "OUT"
+};
+
+static const char *file_name;
+
+static Line         *lines;
+static unsigned long line_count;
+static Symbol       *symbols;
+static unsigned long symbol_count;
+static const char  **literals;
+static unsigned long literal_count;
+
+static Inst           code[MEMORY_SIZE];
+static unsigned short memory[MEMORY_SIZE];
+static unsigned long  entry;
+
+static void fail(unsigned long number, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "%s:%lu: ", file_name, number);
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  exit(STATUS_FAULT);
+}
+
+static char *token(const char *start, const char *end)
+{
+  char *result;
+  while (start < end && is_space(*start)) {
+    ++start;
+  }
+  while (end > start && is_space(end[-1])) {
+    --end;
+  }
+  result = xmalloc(end - start + 1);
+  memcpy(result, start, end - start);
+  result[end - start] = '\0';
+  return result;
+}
+
+/* splits the operand field at commas outside of quotes and stops at a comment */
+static void split_operands(Line *line, const char *text)
+{
+  const char *start  = text;
+  int         quoted = 0;
+
+  for (;; ++text) {
+    if (quoted) {
+      if (!*text) {
+        fail(line->number, "unterminated string");
+      } else if (*text == '\'') {
+        if (text[1] == '\'') {
+          ++text;
+        } else {
+          quoted = 0;
+        }
+      }
+    } else if (*text == '\'') {
+      quoted = 1;
+    } else if (!*text || *text == ',' || *text == ';') {
+      char *operand = token(start, text);
+      if (*operand) {
+        if (line->operand_count == OPERAND_COUNT) {
+          fail(line->number, "too many operands");
+        }
+        line->operands[line->operand_count++] = operand;
+      } else {
+        free(operand);
+      }
+      if (*text != ',') {
+        break;
+      }
+      start = text + 1;
+    }
+  }
+}
+
+static void read_lines(FILE *file)
+{
+  char          buffer[LINE_LENGTH];
+  unsigned long number = 0;
+
+  while (fgets(buffer, sizeof(buffer), file)) {
+    const char *text = buffer;
+    const char *start;
+    Line       *line;
+
+    ++number;
+    buffer[strcspn(buffer, "\r\n")] = '\0';
+    while (is_space(*text)) {
+      ++text;
+    }
+    if (!*text || *text == ';') {
+      continue;
+    }
+
+    if (line_count % 256 == 0) {
+      lines = xrealloc(lines, sizeof(Line) * (line_count + 256));
+    }
+    line                = lines + line_count++;
+    line->number        = number;
+    line->label         = NULL;
+    line->operand_count = 0;
+
+    text = buffer;
+    if (!is_space(*text)) {
+      start = text;
+      while (*text && !is_space(*text)) {
+        ++text;
+      }
+      line->label = token(start, text);
+    }
+    while (is_space(*text)) {
+      ++text;
+    }
+    start = text;
+    while (*text && !is_space(*text)) {
+      ++text;
+    }
+    line->op = token(start, text);
+    split_operands(line, text);
+  }
+}
+
+static long find_symbol(const char *name)
+{
+  unsigned long i;
+  for (i = 0; i < symbol_count; ++i) {
+    if (strcmp(symbols[i].name, name) == 0) {
+      return (long) i;
+    }
+  }
+  return -1;
+}
+
+static void define_symbol(const Line *line, unsigned long address)
+{
+  if (find_symbol(line->label) >= 0) {
+    fail(line->number, "duplicate label %s", line->label);
+  }
+  if (symbol_count % 256 == 0) {
+    symbols = xrealloc(symbols, sizeof(Symbol) * (symbol_count + 256));
+  }
+  symbols[symbol_count].name    = line->label;
+  symbols[symbol_count].address = address;
+  ++symbol_count;
+}
+
+static int register_number(const char *operand)
+{
+  if (operand[0] == 'G' && operand[1] == 'R' && operand[2] >= '0' && operand[2] <= '7' && !operand[3]) {
+    return operand[2] - '0';
+  }
+  return -1;
+}
+
+static Opcode find_opcode(const char *name)
+{
+  int i;
+  for (i = OP_LD; i <= OP_OUT; ++i) {
+    if (strcmp(opcode_names[i], name) == 0) {
+      return (Opcode) i;
+    }
+  }
+  return OP_NONE;
+}
+
+static int is_jump(Opcode op)
+{
+  return (op >= OP_JMI && op <= OP_JOV) || op == OP_PUSH || op == OP_CALL || op == OP_SVC;
+}
+
+static int has_register_form(Opcode op)
+{
+  return op == OP_LD || (op >= OP_ADDA && op <= OP_CPL);
+}
+
+/* the number of words a string constant occupies, including the terminator
+   that mpplc relies on */
+static unsigned long string_size(const char *operand)
+{
+  unsigned long size = 1;
+  for (++operand; *operand; ++operand) {
+    if (*operand == '\'') {
+      if (operand[1] != '\'') {
+        break;
+      }
+      ++operand;
+    }
+    ++size;
+  }
+  return size;
+}
+
+static unsigned long store_string(unsigned long address, const char *operand)
+{
+  for (++operand; *operand; ++operand) {
+    if (*operand == '\'') {
+      if (operand[1] != '\'') {
+        break;
+      }
+      ++operand;
+    }
+    memory[address++ % MEMORY_SIZE] = (unsigned char) *operand;
+  }
+  memory[address++ % MEMORY_SIZE] = 0;
+  return address;
+}
+
+static unsigned long instruction_size(const Line *line, Opcode op)
+{
+  if (op == OP_RET || op == OP_NOP || op == OP_POP) {
+    return 1;
+  }
+  if (line->operand_count == 2 && has_register_form(op) && register_number(line->operands[0]) >= 0
+    && register_number(line->operands[1]) >= 0) {
+    return 1;
+  }
+  return 2;
+}
+
+static unsigned long literal_size(const char *literal)
+{
+  return literal[0] == '\'' ? string_size(literal) : 1;
+}
+
+/* first pass: places every line and collects labels and literals */
+static unsigned long layout(void)
+{
+  unsigned long address = 0;
+  unsigned long i;
+  int           j;
+
+  for (i = 0; i < line_count; ++i) {
+    Line  *line = lines + i;
+    Opcode op;
+
+    if (line->label) {
+      define_symbol(line, address);
+    }
+
+    if (strcmp(line->op, "START") == 0) {
+      continue;
+    } else if (strcmp(line->op, "END") == 0) {
+      break;
+    } else if (strcmp(line->op, "DS") == 0) {
+      if (line->operand_count != 1) {
+        fail(line->number, "DS takes one operand");
+      }
+      address += strtoul(line->operands[0], NULL, 10);
+    } else if (strcmp(line->op, "DC") == 0) {
+      for (j = 0; j < line->operand_count; ++j) {
+        address += line->operands[j][0] == '\'' ? string_size(line->operands[j]) : 1;
+      }
+    } else if ((op = find_opcode(line->op)) != OP_NONE) {
+      address += instruction_size(line, op);
+      for (j = 0; j < line->operand_count; ++j) {
+        if (line->operands[j][0] == '=') {
+          if (literal_count % 256 == 0) {
+            literals = xrealloc(literals, sizeof(char *) * (literal_count + 256));
+          }
+          literals[literal_count++] = line->operands[j] + 1;
+        }
+      }
+    } else {
+      fail(line->number, "unknown instruction %s", line->op);
+    }
+  }
+  return address;
+}
+
+static unsigned long literal_address(unsigned long base, const char *literal)
+{
+  unsigned long i;
+  for (i = 0; i < literal_count; ++i) {
+    if (literals[i] == literal) {
+      return base;
+    }
+    base += literal_size(literals[i]);
+  }
+  unreachable();
+}
+
+static unsigned long value_of(const Line *line, const char *operand, unsigned long base)
+{
+  long symbol;
+
+  if (operand[0] == '=') {
+    return literal_address(base, operand + 1);
+  } else if (operand[0] == '#') {
+    return strtoul(operand + 1, NULL, 16) & 0xFFFF;
+  } else if (operand[0] == '-' || is_number(operand[0])) {
+    return (unsigned long) strtol(operand, NULL, 10) & 0xFFFF;
+  } else if ((symbol = find_symbol(operand)) >= 0) {
+    return symbols[symbol].address;
+  }
+  fail(line->number, "undefined label %s", operand);
+  return 0;
+}
+
+static unsigned long constant_of(const Line *line, const char *operand)
+{
+  if (operand[0] == '=' || operand[0] == '\'') {
+    fail(line->number, "unexpected constant %s", operand);
+  }
+  return value_of(line, operand, 0);
+}
+
+static int index_register(const Line *line, int operand)
+{
+  int x = 0;
+  if (line->operand_count > operand) {
+    x = register_number(line->operands[operand]);
+    if (x <= 0) {
+      fail(line->number, "bad index register %s", line->operands[operand]);
+    }
+  }
+  return x;
+}
+
+/* second pass: encodes instructions and stores constants and literals */
+static void assemble(unsigned long base)
+{
+  unsigned long address = 0;
+  unsigned long i;
+  int           j;
+
+  entry = 0;
+  for (i = 0; i < line_count; ++i) {
+    Line  *line = lines + i;
+    Inst  *inst = code + address;
+    Opcode op;
+
+    if (strcmp(line->op, "START") == 0) {
+      if (line->operand_count > 0) {
+        entry = value_of(line, line->operands[0], base);
+      }
+      continue;
+    } else if (strcmp(line->op, "END") == 0) {
+      break;
+    } else if (strcmp(line->op, "DS") == 0) {
+      address += strtoul(line->operands[0], NULL, 10);
+      continue;
+    } else if (strcmp(line->op, "DC") == 0) {
+      for (j = 0; j < line->operand_count; ++j) {
+        if (line->operands[j][0] == '\'') {
+          address = store_string(address, line->operands[j]);
+        } else {
+          memory[address++ % MEMORY_SIZE] = (unsigned short) constant_of(line, line->operands[j]);
+        }
+      }
+      continue;
+    }
+
+    op                  = find_opcode(line->op);
+    inst->op            = op;
+    inst->register_form = 0;
+    inst->r             = 0;
+    inst->x             = 0;
+    inst->adr           = 0;
+
+    if (op == OP_RET || op == OP_NOP) {
+      /* no operands */
+    } else if (op == OP_POP) {
+      inst->r = register_number(line->operands[0]);
+    } else if (op == OP_IN || op == OP_OUT) {
+      if (line->operand_count != 2) {
+        fail(line->number, "%s takes a buffer and a length", line->op);
+      }
+      inst->adr = value_of(line, line->operands[0], base);
+      inst->x   = (int) value_of(line, line->operands[1], base);
+    } else if (is_jump(op)) {
+      if (line->operand_count < 1) {
+        fail(line->number, "%s needs an address", line->op);
+      }
+      inst->adr = value_of(line, line->operands[0], base);
+      inst->x   = index_register(line, 1);
+    } else {
+      if (line->operand_count < 2 || (inst->r = register_number(line->operands[0])) < 0) {
+        fail(line->number, "%s needs a register and an operand", line->op);
+      }
+      if (instruction_size(line, op) == 1) {
+        inst->register_form = 1;
+        inst->x             = register_number(line->operands[1]);
+      } else {
+        inst->adr = value_of(line, line->operands[1], base);
+        inst->x   = index_register(line, 2);
+      }
+    }
+    address += instruction_size(line, op);
+  }
+
+  for (i = 0; i < literal_count; ++i) {
+    if (literals[i][0] == '\'') {
+      base = store_string(base, literals[i]);
+    } else {
+      memory[base++ % MEMORY_SIZE] = (unsigned short) constant_of(lines, literals[i]);
+    }
+  }
+}
+
+static long signed_word(unsigned long value)
+{
+  value &= 0xFFFF;
+  return value >= 0x8000 ? (long) value - 0x10000 : (long) value;
+}
+
+/* runs from `entry` until the program returns to the os or calls SVC */
+static int run(unsigned long limit, unsigned long *steps)
+{
+  unsigned long gr[8] = { 0 };
+  unsigned long pc    = entry;
+  unsigned long sp    = MEMORY_SIZE - 1;
+  int           of    = 0;
+  int           sf    = 0;
+  int           zf    = 0;
+
+  memory[sp] = 0xFFFF;
+  for (*steps = 0;; ++*steps) {
+    const Inst   *inst = code + pc;
+    unsigned long e    = 0;
+    unsigned long value;
+    long          wide;
+
+    if (*steps >= limit) {
+      fprintf(stderr, "%s: step limit of %lu exceeded\n", file_name, limit);
+      return STATUS_LIMIT;
+    }
+    if (inst->op == OP_NONE) {
+      fprintf(stderr, "%s: executed data at #%04lX\n", file_name, pc);
+      return STATUS_FAULT;
+    }
+
+    if (inst->register_form) {
+      value = gr[inst->x];
+      pc    = (pc + 1) % MEMORY_SIZE;
+    } else if (inst->op == OP_RET || inst->op == OP_NOP || inst->op == OP_POP) {
+      value = 0;
+      pc    = (pc + 1) % MEMORY_SIZE;
+    } else {
+      e     = (inst->adr + (inst->x && inst->op != OP_IN && inst->op != OP_OUT ? gr[inst->x] : 0)) & 0xFFFF;
+      value = memory[e];
+      pc    = (pc + 2) % MEMORY_SIZE;
+    }
+
+    switch (inst->op) {
+    case OP_LD:
+      gr[inst->r] = value;
+      zf          = value == 0;
+      sf          = (value >> 15) & 1;
+      of          = 0;
+      break;
+    case OP_ST:
+      memory[e] = (unsigned short) gr[inst->r];
+      break;
+    case OP_LAD:
+      gr[inst->r] = e;
+      break;
+    case OP_ADDA:
+    case OP_SUBA:
+      wide = inst->op == OP_ADDA ? signed_word(gr[inst->r]) + signed_word(value) : signed_word(gr[inst->r]) - signed_word(value);
+      gr[inst->r] = (unsigned long) wide & 0xFFFF;
+      zf          = gr[inst->r] == 0;
+      sf          = (gr[inst->r] >> 15) & 1;
+      of          = wide < -32768 || wide > 32767;
+      break;
+    case OP_ADDL:
+    case OP_SUBL:
+      wide = inst->op == OP_ADDL ? (long) gr[inst->r] + (long) value : (long) gr[inst->r] - (long) value;
+      gr[inst->r] = (unsigned long) wide & 0xFFFF;
+      zf          = gr[inst->r] == 0;
+      sf          = (gr[inst->r] >> 15) & 1;
+      of          = wide < 0 || wide > 0xFFFF;
+      break;
+    case OP_MULA:
+      wide        = signed_word(gr[inst->r]) * signed_word(value);
+      gr[inst->r] = (unsigned long) wide & 0xFFFF;
+      zf          = gr[inst->r] == 0;
+      sf          = (gr[inst->r] >> 15) & 1;
+      of          = wide < -32768 || wide > 32767;
+      break;
+    case OP_DIVA:
+      if (signed_word(value) == 0) {
+        zf = gr[inst->r] == 0;
+        sf = (gr[inst->r] >> 15) & 1;
+        of = 1;
+      } else {
+        wide        = signed_word(gr[inst->r]) / signed_word(value);
+        gr[inst->r] = (unsigned long) wide & 0xFFFF;
+        zf          = gr[inst->r] == 0;
+        sf          = (gr[inst->r] >> 15) & 1;
+        of          = wide > 32767;
+      }
+      break;
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+      gr[inst->r] = inst->op == OP_AND ? gr[inst->r] & value : inst->op == OP_OR ? gr[inst->r] | value : gr[inst->r] ^ value;
+      zf          = gr[inst->r] == 0;
+      sf          = (gr[inst->r] >> 15) & 1;
+      of          = 0;
+      break;
+    case OP_CPA:
+      zf = signed_word(gr[inst->r]) == signed_word(value);
+      sf = signed_word(gr[inst->r]) < signed_word(value);
+      of = 0;
+      break;
+    case OP_CPL:
+      zf = gr[inst->r] == value;
+      sf = gr[inst->r] < value;
+      of = 0;
+      break;
+    case OP_JMI:
+      pc = sf ? e : pc;
+      break;
+    case OP_JNZ:
+      pc = !zf ? e : pc;
+      break;
+    case OP_JZE:
+      pc = zf ? e : pc;
+      break;
+    case OP_JUMP:
+      pc = e;
+      break;
+    case OP_JPL:
+      pc = !sf && !zf ? e : pc;
+      break;
+    case OP_JOV:
+      pc = of ? e : pc;
+      break;
+    case OP_PUSH:
+      sp         = (sp + MEMORY_SIZE - 1) % MEMORY_SIZE;
+      memory[sp] = (unsigned short) e;
+      break;
+    case OP_POP:
+      gr[inst->r] = memory[sp];
+      sp          = (sp + 1) % MEMORY_SIZE;
+      break;
+    case OP_CALL:
+      sp         = (sp + MEMORY_SIZE - 1) % MEMORY_SIZE;
+      memory[sp] = (unsigned short) pc;
+      pc         = e;
+      break;
+    case OP_RET:
+      pc = memory[sp];
+      sp = (sp + 1) % MEMORY_SIZE;
+      if (pc == 0xFFFF) {
+        ++*steps;
+        return 0;
+      }
+      break;
+    case OP_SVC:
+      ++*steps;
+      return (int) (e & 0xFF);
+    case OP_NOP:
+      break;
+    case OP_IN: {
+      int           c      = EOF;
+      unsigned long length = 0;
+      while ((c = getchar()) != EOF && c != '\n') {
+        if (length < RECORD_LENGTH) {
+          memory[(inst->adr + length++) % MEMORY_SIZE] = (unsigned short) c;
+        }
+      }
+      memory[inst->x] = c == EOF && length == 0 ? 0xFFFF : (unsigned short) length;
+      break;
+    }
+    case OP_OUT: {
+      long length = signed_word(memory[inst->x]);
+      long i;
+      for (i = 0; i < length; ++i) {
+        putchar(memory[(inst->adr + i) % MEMORY_SIZE] & 0xFF);
+      }
+      putchar('\n');
+      break;
+    }
+    default:
+      unreachable();
+    }
+  }
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned long limit = 20000000ul;
+  unsigned long steps = 0;
+  int           stats = 0;
+  int           status;
+  int           i;
+  FILE         *file;
+
+  for (i = 1; i < argc - 1; ++i) {
+    if (strcmp(argv[i], "--steps") == 0 && i + 2 < argc) {
+      limit = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      stats = 1;
+    } else {
+      break;
+    }
+  }
+  if (i != argc - 1) {
+    fprintf(stderr, "Usage: %s [--steps N] [--stats] FILE.csl\n", argv[0]);
+    return STATUS_FAULT;
+  }
+
+  file_name = argv[i];
+  file      = fopen(file_name, "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open file: %s\n", file_name);
+    return STATUS_FAULT;
+  }
+  read_lines(file);
+  fclose(file);
+
+  assemble(layout());
+  status = run(limit, &steps);
+  fflush(stdout);
+  if (stats) {
+    fprintf(stderr, "steps %lu\n", steps);
+  }
+  return status;
+}
@@ -0,0 +1,76 @@
+# runs COUNT programs generated by MPPLGEN from seed FIRST on COMET2.
+#
+# with MODE expr the programs come with their expected output, which is
+# compared with the output of MPPLC. with MODE diff every program is compiled
+# by MPPLC with OPTIONS and by REFERENCE (MPPLC by default) with
+# REFERENCE_OPTIONS and both results must agree. runs that hit the step limit
+# are skipped since the two sides stop at different points. a failing program
+# is kept in WORK_DIR as fuzz<seed>.mpl
+
+if(NOT DEFINED REFERENCE)
+  set(REFERENCE ${MPPLC})
+endif()
+if(NOT DEFINED STEPS)
+  set(STEPS 2000000)
+endif()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# sets ${result} to the output and exit status of program ${name}.mpl
+function(compile_and_run compiler options name result)
+  separate_arguments(options UNIX_COMMAND "${options}")
+  file(REMOVE ${WORK_DIR}/${name}.csl)
+  execute_process(
+    COMMAND ${compiler} ${options} --emit-casl2 ${WORK_DIR}/${name}.mpl
+    OUTPUT_QUIET
+    ERROR_QUIET)
+  if(NOT EXISTS ${WORK_DIR}/${name}.csl)
+    set(${result} "[compile error]\n" PARENT_SCOPE)
+    return()
+  endif()
+
+  execute_process(
+    COMMAND ${COMET2} --steps ${STEPS} ${WORK_DIR}/${name}.csl
+    INPUT_FILE ${INPUT}
+    OUTPUT_VARIABLE output
+    ERROR_QUIET
+    RESULT_VARIABLE status)
+  set(${result} "${output}[status ${status}]\n" PARENT_SCOPE)
+endfunction()
+
+math(EXPR last "${FIRST} + ${COUNT} - 1")
+set(failures 0)
+set(skipped 0)
+foreach(seed RANGE ${FIRST} ${last})
+  if(MODE STREQUAL "expr")
+    execute_process(
+      COMMAND ${MPPLGEN} --expr ${WORK_DIR}/expected.out ${seed}
+      OUTPUT_FILE ${WORK_DIR}/actual.mpl
+      RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+      message(FATAL_ERROR "${MPPLGEN} failed on seed ${seed}")
+    endif()
+    file(READ ${WORK_DIR}/expected.out expected)
+  else()
+    execute_process(
+      COMMAND ${MPPLGEN} ${seed}
+      OUTPUT_FILE ${WORK_DIR}/actual.mpl
+      RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+      message(FATAL_ERROR "${MPPLGEN} failed on seed ${seed}")
+    endif()
+    configure_file(${WORK_DIR}/actual.mpl ${WORK_DIR}/expected.mpl COPYONLY)
+    compile_and_run(${REFERENCE} "${REFERENCE_OPTIONS}" expected expected)
+  endif()
+  compile_and_run(${MPPLC} "${OPTIONS}" actual actual)
+
+  if(expected MATCHES "\\[status 124\\]\n$" OR actual MATCHES "\\[status 124\\]\n$")
+    math(EXPR skipped "${skipped} + 1")
+  elseif(NOT actual STREQUAL expected)
+    math(EXPR failures "${failures} + 1")
+    configure_file(${WORK_DIR}/actual.mpl ${WORK_DIR}/fuzz${seed}.mpl COPYONLY)
+    message(SEND_ERROR "seed ${seed}: output differs, program kept in ${WORK_DIR}/fuzz${seed}.mpl\nexpected:\n${expected}actual:\n${actual}")
+  endif()
+endforeach()
+
+message(STATUS "${COUNT} programs, ${failures} failed, ${skipped} hit the step limit")
@@ -0,0 +1,787 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string_builder.h"
+#include "utility.h"
+
+/* writes a random well-typed MPPL program for SEED to stdout. by default the
+   program exercises statements, procedures, loops and arrays and is meant to be
+   compared between two compilers or option sets. with --expr the program
+   evaluates deep arithmetic and boolean expressions and their values, as
+   computed here, are written to EXPECTED in the format of run_sample.cmake */
+
+#define SCOPE_SIZE      64
+#define PROCEDURE_COUNT 3
+#define PARAMETER_COUNT 3
+#define LOOP_DEPTH      3
+
+#define EXPR_VARIABLES  9
+#define EXPR_ARRAY      5
+#define EXPR_STATEMENTS 6
+
+typedef enum {
+  KIND_INTEGER,
+  KIND_CHAR,
+  KIND_BOOLEAN
+} Kind;
+
+typedef struct Variable  Variable;
+typedef struct Procedure Procedure;
+
+struct Variable {
+  char name[16];
+  Kind kind;
+  int  size;
+};
+
+struct Procedure {
+  char name[16];
+  Kind kinds[PARAMETER_COUNT];
+  int  count;
+};
+
+static const char *kind_names[] = { "integer", "char", "boolean" };
+
+static unsigned long random_state;
+
+static Variable        scope[SCOPE_SIZE];
+static int             scope_count;
+static const Variable *loop_variables[LOOP_DEPTH];
+static int             loop_count;
+static Procedure       procedures[PROCEDURE_COUNT];
+static int             procedure_count;
+static int             in_procedure;
+static int             name_count;
+
+static unsigned long next_random(void)
+{
+  /* xorshift32, kept to 32 bits so that a seed gives the same program everywhere */
+  random_state ^= (random_state << 13) & 0xFFFFFFFFul;
+  random_state ^= random_state >> 17;
+  random_state ^= (random_state << 5) & 0xFFFFFFFFul;
+  return random_state;
+}
+
+static long below(long bound)
+{
+  return (long) (next_random() % (unsigned long) bound);
+}
+
+static long between(long low, long high)
+{
+  return low + below(high - low + 1);
+}
+
+static int percent(int chance)
+{
+  return below(100) < chance;
+}
+
+static Kind any_kind(void)
+{
+  static const Kind kinds[] = { KIND_INTEGER, KIND_INTEGER, KIND_CHAR, KIND_BOOLEAN };
+  return kinds[below(4)];
+}
+
+static Kind operand_kind(void)
+{
+  static const Kind kinds[] = { KIND_INTEGER, KIND_INTEGER, KIND_INTEGER, KIND_CHAR, KIND_BOOLEAN };
+  return kinds[below(5)];
+}
+
+static void new_name(char *name, const char *prefix)
+{
+  sprintf(name, "%s%d", prefix, ++name_count);
+}
+
+static int is_loop_variable(const Variable *variable)
+{
+  int i;
+  for (i = 0; i < loop_count; ++i) {
+    if (loop_variables[i] == variable) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static const Variable *pick_variable(unsigned kinds, int array, int assignable)
+{
+  const Variable *candidates[SCOPE_SIZE];
+  int             count = 0;
+  int             i;
+
+  for (i = 0; i < scope_count; ++i) {
+    const Variable *variable = scope + i;
+    if ((kinds & (1u << variable->kind)) && (variable->size > 0) == array
+      && !(assignable && is_loop_variable(variable))) {
+      candidates[count++] = variable;
+    }
+  }
+  return count ? candidates[below(count)] : NULL;
+}
+
+static Variable *add_variable(const char *prefix, Kind kind, int size)
+{
+  Variable *variable = scope + scope_count++;
+  new_name(variable->name, prefix);
+  variable->kind = kind;
+  variable->size = size;
+  return variable;
+}
+
+static void gen_expression(StringBuilder *out, Kind kind, int depth);
+
+static void gen_literal(StringBuilder *out, Kind kind)
+{
+  static const long integers[]   = { 0, 1, 2, 3, 5, 7, 10, 100, 255 };
+  static const char characters[] = "abcXYZ09 #";
+
+  switch (kind) {
+  case KIND_INTEGER: {
+    long choice = below(11);
+    if (choice < 9) {
+      string_builder_printf(out, "%ld", integers[choice]);
+    } else {
+      string_builder_printf(out, "%ld", choice == 9 ? between(0, 40) : between(0, 32767));
+    }
+    break;
+  }
+  case KIND_CHAR:
+    string_builder_printf(out, "'%c'", characters[below(10)]);
+    break;
+  case KIND_BOOLEAN:
+    string_builder_printf(out, "%s", percent(50) ? "true" : "false");
+    break;
+  }
+}
+
+static void gen_index(StringBuilder *out, const Variable *array)
+{
+  if (loop_count && percent(50)) {
+    const char *name = loop_variables[below(loop_count)]->name;
+    switch (below(4)) {
+    case 0:
+    case 1:
+      string_builder_printf(out, "%s", name);
+      break;
+    case 2:
+      string_builder_printf(out, "%s div 2", name);
+      break;
+    default:
+      string_builder_printf(out, "%s + %ld", name, below(2));
+      break;
+    }
+  } else {
+    /* occasionally one past the end to exercise the range check */
+    string_builder_printf(out, "%ld", between(0, percent(3) ? array->size : array->size - 1));
+  }
+}
+
+static int gen_variable(StringBuilder *out, Kind kind, int assignable)
+{
+  const Variable *scalar = pick_variable(1u << kind, 0, assignable);
+  const Variable *array  = pick_variable(1u << kind, 1, 0);
+
+  if (array && (!scalar || percent(30))) {
+    string_builder_printf(out, "%s[", array->name);
+    gen_index(out, array);
+    string_builder_printf(out, "]");
+    return 1;
+  } else if (scalar) {
+    string_builder_printf(out, "%s", scalar->name);
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+static void gen_factor(StringBuilder *out, Kind kind, int depth)
+{
+  long choice = below(100);
+  if (choice < 50 && gen_variable(out, kind, 0)) {
+    return;
+  }
+  if (choice < 80) {
+    gen_literal(out, kind);
+  } else {
+    string_builder_printf(out, "(");
+    gen_expression(out, kind, depth + 1);
+    string_builder_printf(out, ")");
+  }
+}
+
+static void gen_term(StringBuilder *out, Kind kind, int depth)
+{
+  if (kind == KIND_INTEGER) {
+    long choice = below(100);
+    if (choice < 50) {
+      if (!gen_variable(out, kind, 0)) {
+        gen_literal(out, kind);
+      }
+    } else if (choice < 70) {
+      gen_literal(out, kind);
+    } else {
+      string_builder_printf(out, "(");
+      gen_expression(out, kind, depth + 1);
+      string_builder_printf(out, ")");
+    }
+  } else {
+    gen_factor(out, kind, depth);
+  }
+}
+
+static void gen_leaf(StringBuilder *out, Kind kind, int chance)
+{
+  if (!percent(chance) || !gen_variable(out, kind, 0)) {
+    gen_literal(out, kind);
+  }
+}
+
+static void gen_expression(StringBuilder *out, Kind kind, int depth)
+{
+  static const char *arithmetic[] = { "+", "+", "-", "-", "*", "div" };
+  static const char *relational[] = { "=", "<>", "<", "<=", ">", ">=" };
+
+  int  leaf = depth > 3 || percent(30);
+  long choice;
+
+  switch (kind) {
+  case KIND_INTEGER:
+    if (leaf) {
+      gen_leaf(out, kind, 70);
+      break;
+    }
+    choice = below(100);
+    if (choice < 55) {
+      const char *op = arithmetic[below(6)];
+      gen_expression(out, kind, depth + 1);
+      string_builder_printf(out, " %s ", op);
+      if (strcmp(op, "div") != 0 || percent(30)) {
+        gen_term(out, kind, depth + 1);
+      } else {
+        string_builder_printf(out, "%ld", between(1, 9));
+      }
+    } else if (choice < 65) {
+      string_builder_printf(out, "(");
+      gen_expression(out, kind, depth + 1);
+      string_builder_printf(out, ")");
+    } else if (choice < 72) {
+      string_builder_printf(out, "-");
+      gen_term(out, kind, depth + 1);
+    } else if (choice < 85) {
+      string_builder_printf(out, "integer(");
+      gen_expression(out, percent(50) ? KIND_CHAR : KIND_BOOLEAN, depth + 1);
+      string_builder_printf(out, ")");
+    } else {
+      gen_term(out, kind, depth + 1);
+    }
+    break;
+
+  case KIND_CHAR:
+    if (leaf || percent(60)) {
+      gen_leaf(out, kind, 60);
+      break;
+    }
+    string_builder_printf(out, "char(");
+    if (percent(50)) {
+      gen_term(out, KIND_INTEGER, depth + 1);
+      string_builder_printf(out, " div 1");
+    } else if (percent(50)) {
+      gen_literal(out, KIND_INTEGER);
+    } else {
+      string_builder_printf(out, "65 + ");
+      gen_term(out, KIND_INTEGER, depth + 1);
+    }
+    string_builder_printf(out, ")");
+    break;
+
+  case KIND_BOOLEAN:
+    if (leaf) {
+      gen_leaf(out, kind, 60);
+      break;
+    }
+    choice = below(100);
+    if (choice < 45) {
+      Kind operand = operand_kind();
+      if (operand == KIND_BOOLEAN) {
+        gen_factor(out, operand, depth + 1);
+      } else {
+        gen_expression(out, operand, depth + 1);
+      }
+      string_builder_printf(out, " %s ", relational[below(6)]);
+      if (operand == KIND_BOOLEAN) {
+        gen_factor(out, operand, depth + 1);
+      } else {
+        gen_expression(out, operand, depth + 1);
+      }
+    } else if (choice < 65) {
+      string_builder_printf(out, "(");
+      gen_expression(out, kind, depth + 1);
+      string_builder_printf(out, ") %s (", percent(50) ? "and" : "or");
+      gen_expression(out, kind, depth + 1);
+      string_builder_printf(out, ")");
+    } else if (choice < 75) {
+      string_builder_printf(out, "not ");
+      gen_factor(out, kind, depth + 1);
+    } else if (choice < 85) {
+      string_builder_printf(out, "boolean(");
+      gen_expression(out, percent(50) ? KIND_INTEGER : KIND_CHAR, depth + 1);
+      string_builder_printf(out, ")");
+    } else {
+      gen_factor(out, kind, depth + 1);
+    }
+    break;
+  }
+}
+
+static void gen_statement(StringBuilder *out, int depth);
+
+static void gen_statements(StringBuilder *out, int depth, long count)
+{
+  long i;
+  for (i = 0; i < count; ++i) {
+    if (i) {
+      string_builder_printf(out, "; ");
+    }
+    gen_statement(out, depth);
+  }
+}
+
+static void gen_write(StringBuilder *out)
+{
+  StringBuilder *items = string_builder_new();
+  long           count = below(4);
+  long           i;
+
+  for (i = 0; i < count; ++i) {
+    if (i) {
+      string_builder_printf(items, ", ");
+    }
+    if (percent(20)) {
+      string_builder_printf(items, "'s%ld'", below(100));
+    } else {
+      gen_expression(items, any_kind(), 0);
+      if (percent(20)) {
+        string_builder_printf(items, " : %ld", below(9));
+      }
+    }
+  }
+
+  if (percent(50)) {
+    string_builder_printf(out, count ? "writeln(%s)" : "writeln", string_builder_data(items));
+  } else {
+    string_builder_printf(out, count ? "write(%s)" : "write('.')", string_builder_data(items));
+  }
+  string_builder_free(items);
+}
+
+static void gen_read(StringBuilder *out)
+{
+  const Variable *variable = pick_variable((1u << KIND_INTEGER) | (1u << KIND_CHAR), 0, 1);
+  if (variable) {
+    string_builder_printf(out, "%s(%s)", percent(50) ? "read" : "readln", variable->name);
+  } else {
+    string_builder_printf(out, "readln");
+  }
+}
+
+static void gen_call(StringBuilder *out)
+{
+  const Procedure *procedure = procedures + below(procedure_count);
+  int              i;
+
+  string_builder_printf(out, "call %s", procedure->name);
+  for (i = 0; i < procedure->count; ++i) {
+    Kind            kind   = procedure->kinds[i];
+    const Variable *scalar = pick_variable(1u << kind, 0, 1);
+    const Variable *array  = pick_variable(1u << kind, 1, 0);
+    long            choice = below(100);
+
+    string_builder_printf(out, i ? ", " : "(");
+    if (choice < 40 && scalar) {
+      string_builder_printf(out, "%s", scalar->name);
+    } else if (choice < 55 && array) {
+      string_builder_printf(out, "%s[%ld]", array->name, below(array->size));
+    } else {
+      gen_expression(out, kind, 0);
+    }
+  }
+  if (procedure->count) {
+    string_builder_printf(out, ")");
+  }
+}
+
+static void gen_loop(StringBuilder *out, int depth)
+{
+  const Variable *counter = pick_variable(1u << KIND_INTEGER, 0, 1);
+  long            bound;
+
+  if (!counter || loop_count == LOOP_DEPTH) {
+    gen_write(out);
+    return;
+  }
+
+  bound                        = between(1, 12);
+  loop_variables[loop_count++] = counter;
+  string_builder_printf(out, "begin %s := 0; while %s < %ld do begin ", counter->name, counter->name, bound);
+  gen_statements(out, depth + 1, between(1, 5));
+  string_builder_printf(out, "; %s := %s + 1 end end", counter->name, counter->name);
+  --loop_count;
+}
+
+static void gen_statement(StringBuilder *out, int depth)
+{
+  long choice = below(100);
+  if (depth > 3 && choice > 50) {
+    choice = 50;
+  }
+
+  if (choice < 35) {
+    Kind kind = operand_kind();
+    if (gen_variable(out, kind, 1)) {
+      string_builder_printf(out, " := ");
+      gen_expression(out, kind, 0);
+    } else {
+      gen_write(out);
+    }
+  } else if (choice < 50) {
+    gen_write(out);
+  } else if (choice < 55 && procedure_count) {
+    gen_call(out);
+  } else if (choice < 58 && loop_count) {
+    string_builder_printf(out, "if ");
+    gen_expression(out, KIND_BOOLEAN, 0);
+    string_builder_printf(out, " then break");
+  } else if (choice < 60 && in_procedure && percent(50)) {
+    string_builder_printf(out, "if ");
+    gen_expression(out, KIND_BOOLEAN, 0);
+    string_builder_printf(out, " then return");
+  } else if (choice < 62) {
+    gen_read(out);
+  } else if (choice < 78) {
+    string_builder_printf(out, "if ");
+    gen_expression(out, KIND_BOOLEAN, 0);
+    string_builder_printf(out, " then ");
+    gen_statement(out, depth + 1);
+    if (percent(50)) {
+      string_builder_printf(out, " else ");
+      gen_statement(out, depth + 1);
+    }
+  } else if (choice < 92) {
+    gen_loop(out, depth);
+  } else {
+    string_builder_printf(out, "begin ");
+    gen_statements(out, depth + 1, between(1, 4));
+    string_builder_printf(out, " end");
+  }
+}
+
+static void gen_declarations(StringBuilder *out, const char *prefix, const char *counters)
+{
+  long groups = between(1, 4);
+  long i, j;
+
+  for (i = 0; i < groups; ++i) {
+    Kind kind  = any_kind();
+    long count = between(1, 3);
+    int  size  = percent(30) ? (int) between(1, 8) : 0;
+
+    for (j = 0; j < count; ++j) {
+      string_builder_printf(out, j ? ", %s" : "%s", add_variable(prefix, kind, size)->name);
+    }
+    if (size) {
+      string_builder_printf(out, " : array[%d] of %s; ", size, kind_names[kind]);
+    } else {
+      string_builder_printf(out, " : %s; ", kind_names[kind]);
+    }
+  }
+
+  /* guarantee some integer scalars for loop counters */
+  for (j = 0; j < 2; ++j) {
+    string_builder_printf(out, j ? ", %s" : "%s", add_variable(counters, KIND_INTEGER, 0)->name);
+  }
+  string_builder_printf(out, " : integer;");
+}
+
+static void gen_program(StringBuilder *out)
+{
+  long count;
+  int  globals;
+
+  string_builder_printf(out, "program p%ld;\nvar ", below(1000));
+  gen_declarations(out, "v", "i");
+  string_builder_printf(out, "\n");
+  globals      = scope_count;
+  in_procedure = 1;
+  for (count = below(PROCEDURE_COUNT + 1); procedure_count < count; ++procedure_count) {
+    Procedure *procedure = procedures + procedure_count;
+    int        i;
+
+    new_name(procedure->name, "p");
+    procedure->count = (int) below(PARAMETER_COUNT + 1);
+    string_builder_printf(out, "procedure %s", procedure->name);
+    for (i = 0; i < procedure->count; ++i) {
+      procedure->kinds[i] = any_kind();
+      string_builder_printf(out, "%s%s : %s", i ? "; " : "(",
+        add_variable("a", procedure->kinds[i], 0)->name, kind_names[procedure->kinds[i]]);
+    }
+    string_builder_printf(out, "%s; var ", procedure->count ? ")" : "");
+    gen_declarations(out, "l", "j");
+    string_builder_printf(out, " begin ");
+    gen_statements(out, 0, between(1, 6));
+    string_builder_printf(out, " end;\n");
+    scope_count = globals;
+  }
+  in_procedure = 0;
+
+  string_builder_printf(out, "begin ");
+  gen_statements(out, 0, between(3, 10));
+  string_builder_printf(out, " end.\n");
+}
+
+/* expression mode: every subexpression is generated together with its value */
+
+static long expr_variables[EXPR_VARIABLES];
+static long expr_array[EXPR_ARRAY];
+
+static long gen_value(StringBuilder *out, int depth)
+{
+  StringBuilder *lhs, *rhs;
+  char           op;
+  long           left, right, value;
+  long           choice, skew;
+
+  if (depth <= 0 || percent(12)) {
+    long index;
+    choice = below(100);
+    if (choice < 45) {
+      index = below(EXPR_VARIABLES);
+      string_builder_printf(out, "v%ld", index);
+      return expr_variables[index];
+    } else if (choice < 70) {
+      value = below(10);
+      string_builder_printf(out, "%ld", value);
+      return value;
+    }
+
+    index = below(EXPR_ARRAY);
+    if (percent(50)) {
+      string_builder_printf(out, "a[%ld]", index);
+    } else {
+      /* index by an expression that evaluates to index */
+      lhs   = string_builder_new();
+      value = index - gen_value(lhs, 1);
+      string_builder_printf(out, "a[(%s) %c %ld]", string_builder_data(lhs), value < 0 ? '-' : '+', labs(value));
+      string_builder_free(lhs);
+    }
+    return expr_array[index];
+  }
+
+  op    = "+-*+-"[below(5)];
+  skew  = below(100);
+  lhs   = string_builder_new();
+  rhs   = string_builder_new();
+  left  = gen_value(lhs, skew > 30 ? depth - 1 : (int) below(2));
+  right = gen_value(rhs, skew < 70 ? depth - 1 : (int) below(2));
+
+  if (op == '*' && labs(left * right) > 2000) {
+    op = '-';
+  }
+  switch (op) {
+  case '+':
+    value = left + right;
+    break;
+  case '-':
+    value = left - right;
+    break;
+  default:
+    value = left * right;
+    break;
+  }
+
+  /* keep every intermediate value well inside 16 bits */
+  if (labs(value) > 3000) {
+    string_builder_printf(out, "((%s) - (%s))", string_builder_data(lhs), string_builder_data(lhs));
+    value = 0;
+  } else {
+    string_builder_printf(out, "(%s %c %s)", string_builder_data(lhs), op, string_builder_data(rhs));
+  }
+  string_builder_free(lhs);
+  string_builder_free(rhs);
+  return value;
+}
+
+static int gen_condition(StringBuilder *out, int depth)
+{
+  StringBuilder *lhs, *rhs;
+  long           choice = below(100);
+  int            value;
+
+  if (depth <= 0 || choice < 30) {
+    static const char *operators[] = { "=", "<>", "<", ">", "<=", ">=" };
+
+    long op = below(6);
+    long left, right;
+
+    lhs   = string_builder_new();
+    rhs   = string_builder_new();
+    left  = gen_value(lhs, depth > 0 ? depth - 1 : 0);
+    right = gen_value(rhs, depth > 0 ? depth - 1 : 0);
+    switch (op) {
+    case 0:
+      value = left == right;
+      break;
+    case 1:
+      value = left != right;
+      break;
+    case 2:
+      value = left < right;
+      break;
+    case 3:
+      value = left > right;
+      break;
+    case 4:
+      value = left <= right;
+      break;
+    default:
+      value = left >= right;
+      break;
+    }
+    string_builder_printf(out, "(%s %s %s)", string_builder_data(lhs), operators[op], string_builder_data(rhs));
+  } else if (choice < 45) {
+    lhs   = string_builder_new();
+    rhs   = NULL;
+    value = !gen_condition(lhs, depth - 1);
+    string_builder_printf(out, "(not %s)", string_builder_data(lhs));
+  } else {
+    int left, right;
+    lhs   = string_builder_new();
+    rhs   = string_builder_new();
+    left  = gen_condition(lhs, depth - 1);
+    right = gen_condition(rhs, depth - 1);
+    if (percent(50)) {
+      value = left && right;
+      string_builder_printf(out, "(%s and %s)", string_builder_data(lhs), string_builder_data(rhs));
+    } else {
+      value = left || right;
+      string_builder_printf(out, "(%s or %s)", string_builder_data(lhs), string_builder_data(rhs));
+    }
+  }
+  string_builder_free(lhs);
+  string_builder_free(rhs);
+  return value;
+}
+
+static void gen_expression_program(StringBuilder *out, StringBuilder *expected, int depth)
+{
+  long i;
+
+  string_builder_printf(out, "program p;\nvar ");
+  for (i = 0; i < EXPR_VARIABLES; ++i) {
+    string_builder_printf(out, "v%ld, ", i);
+  }
+  string_builder_printf(out, "i : integer;\n    a : array[%d] of integer;\nbegin\n", EXPR_ARRAY);
+  for (i = 0; i < EXPR_VARIABLES; ++i) {
+    expr_variables[i] = between(-20, 20);
+    string_builder_printf(out, "  v%ld := %ld;\n", i, expr_variables[i]);
+  }
+  for (i = 0; i < EXPR_ARRAY; ++i) {
+    expr_array[i] = between(-20, 20);
+    string_builder_printf(out, "  a[%ld] := %ld;\n", i, expr_array[i]);
+  }
+
+  /* wrapped in a loop so that the values are not all known at compile time */
+  string_builder_printf(out, "  i := 0;\n  while i < 1 do begin\n");
+  for (i = 0; i < EXPR_STATEMENTS; ++i) {
+    StringBuilder *text = string_builder_new();
+    if (percent(70)) {
+      long value = gen_value(text, depth);
+      if (percent(50)) {
+        long target = below(EXPR_VARIABLES);
+        string_builder_printf(out, "    v%ld := %s;\n    writeln('[', v%ld, ']');\n", target, string_builder_data(text), target);
+        expr_variables[target] = value;
+      } else {
+        string_builder_printf(out, "    writeln('[', %s, ']');\n", string_builder_data(text));
+      }
+      string_builder_printf(expected, "[%ld]\n", value);
+    } else {
+      int value = gen_condition(text, depth - 2);
+      string_builder_printf(out, "    writeln('[', %s, ']');\n", string_builder_data(text));
+      string_builder_printf(expected, "[%s]\n", value ? "TRUE" : "FALSE");
+    }
+    string_builder_free(text);
+  }
+  string_builder_printf(out, "    i := i + 1\n  end\nend.\n");
+  string_builder_printf(expected, "[status 0]\n");
+}
+
+int main(int argc, const char **argv)
+{
+  StringBuilder *out;
+  StringBuilder *expected      = NULL;
+  const char    *expected_name = NULL;
+  int            depth         = 7;
+  int            i;
+
+  for (i = 1; i < argc - 1; ++i) {
+    if (strcmp(argv[i], "--expr") == 0 && i + 2 < argc) {
+      expected_name = argv[++i];
+    } else if (strcmp(argv[i], "--depth") == 0 && i + 2 < argc) {
+      depth = atoi(argv[++i]);
+    } else {
+      break;
+    }
+  }
+  if (i != argc - 1 || depth < 2) {
+    fprintf(stderr, "Usage: %s [--expr EXPECTED [--depth N]] SEED\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  /* a zero state would stay zero */
+  random_state = (strtoul(argv[i], NULL, 10) * 2654435761ul + 1) & 0xFFFFFFFFul;
+  if (!random_state) {
+    random_state = 1;
+  }
+  for (i = 0; i < 8; ++i) {
+    next_random();
+  }
+
+  out = string_builder_new();
+  if (expected_name) {
+    FILE *file;
+
+    expected = string_builder_new();
+    gen_expression_program(out, expected, depth);
+    file = fopen(expected_name, "w");
+    if (!file) {
+      fprintf(stderr, "Cannot open file: %s\n", expected_name);
+      return EXIT_FAILURE;
+    }
+    fputs(string_builder_data(expected), file);
+    fclose(file);
+    string_builder_free(expected);
+  } else {
+    gen_program(out);
+  }
+  fputs(string_builder_data(out), stdout);
+  string_builder_free(out);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+# compiles SOURCE with MPPLC, runs it on COMET2 with INPUT and compares the
+# output and exit status with EXPECTED. OPTIONS is passed to mpplc and
+# WORK_DIR receives the intermediate files. with UPDATE set, EXPECTED is
+# rewritten instead
+
+get_filename_component(name ${SOURCE} NAME_WE)
+file(MAKE_DIRECTORY ${WORK_DIR})
+file(REMOVE ${WORK_DIR}/${name}.csl)
+configure_file(${SOURCE} ${WORK_DIR}/${name}.mpl COPYONLY)
+
+separate_arguments(options UNIX_COMMAND "${OPTIONS}")
+execute_process(
+  COMMAND ${MPPLC} ${options} --emit-casl2 ${WORK_DIR}/${name}.mpl
+  RESULT_VARIABLE result
+  ERROR_VARIABLE errors)
+if(NOT result EQUAL 0 OR NOT EXISTS ${WORK_DIR}/${name}.csl)
+  message(FATAL_ERROR "mpplc failed on ${SOURCE} (${result})\n${errors}")
+endif()
+
+execute_process(
+  COMMAND ${COMET2} ${WORK_DIR}/${name}.csl
+  INPUT_FILE ${INPUT}
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE errors
+  RESULT_VARIABLE status)
+string(APPEND output "[status ${status}]\n")
+
+if(UPDATE)
+  file(WRITE ${EXPECTED} "${output}")
+  return()
+endif()
+
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+  file(WRITE ${WORK_DIR}/${name}.out "${output}")
+  message(FATAL_ERROR "output of ${SOURCE} differs from ${EXPECTED}\nactual output: ${WORK_DIR}/${name}.out\n${errors}")
+endif()
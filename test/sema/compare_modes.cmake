@@ -0,0 +1,37 @@
+# runs MPPLC --syntax-only on SOURCE with the default checker, with
+# --fused-sema and with --jobs 4, and checks that the diagnostics are the same
+# byte for byte. mpplc prints the path it was given, so it is run from the
+# directory of SOURCE
+
+get_filename_component(name ${SOURCE} NAME)
+get_filename_component(directory ${SOURCE} DIRECTORY)
+
+set(modes default fused_sema jobs)
+set(default_options)
+set(fused_sema_options --fused-sema)
+set(jobs_options --jobs 4)
+
+foreach(mode IN LISTS modes)
+  execute_process(
+    COMMAND ${MPPLC} --syntax-only ${${mode}_options} ${name}
+    WORKING_DIRECTORY ${directory}
+    OUTPUT_VARIABLE ${mode}_output
+    ERROR_VARIABLE ${mode}_output
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "mpplc ${${mode}_options} failed on ${SOURCE} (${result})\n${${mode}_output}")
+  endif()
+endforeach()
+
+if(default_output STREQUAL "")
+  message(FATAL_ERROR "mpplc reported nothing on ${SOURCE}")
+endif()
+
+foreach(mode IN LISTS modes)
+  if(NOT ${mode}_output STREQUAL default_output)
+    file(MAKE_DIRECTORY ${WORK_DIR})
+    file(WRITE ${WORK_DIR}/${name}.default.out "${default_output}")
+    file(WRITE ${WORK_DIR}/${name}.${mode}.out "${${mode}_output}")
+    message(FATAL_ERROR "diagnostics of ${SOURCE} differ with ${${mode}_options}\nsee ${WORK_DIR}/${name}.default.out and ${WORK_DIR}/${name}.${mode}.out")
+  endif()
+endforeach()
@@ -0,0 +1,219 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utility.h"
+
+/* checks that hash_bytes and hash_pointer spread typical keys over the low bits
+   that Map uses, and that every input bit reaches the output */
+
+#define KEY_COUNT 32768
+
+#define check(cond)                                                               \
+  do {                                                                            \
+    if (!(cond)) {                                                                \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(EXIT_FAILURE);                                                         \
+    }                                                                             \
+  } while (0)
+
+typedef struct Header Header;
+
+/* shaped like the interner's String headers */
+struct Header {
+  const char   *data;
+  unsigned long length;
+};
+
+static unsigned long hashes[KEY_COUNT];
+static unsigned long counts[4096];
+
+/* chi-squared over `buckets` low-bit buckets, divided by the degrees of freedom */
+static double chi2_per_df(unsigned long count, unsigned long buckets)
+{
+  unsigned long i;
+  double        expected = (double) count / buckets;
+  double        chi2     = 0.0;
+
+  for (i = 0; i < buckets; ++i) {
+    counts[i] = 0;
+  }
+  for (i = 0; i < count; ++i) {
+    ++counts[hashes[i] & (buckets - 1)];
+  }
+  for (i = 0; i < buckets; ++i) {
+    double diff = counts[i] - expected;
+    chi2 += diff * diff / expected;
+  }
+  return chi2 / (buckets - 1);
+}
+
+static void check_spread(const char *name, unsigned long count)
+{
+  unsigned long buckets;
+  double        worst = 0.0;
+
+  for (buckets = 64; buckets <= 4096; buckets <<= 1) {
+    double value = chi2_per_df(count, buckets);
+    if (value > worst) {
+      worst = value;
+    }
+  }
+  printf("%-24s worst chi2/df %.2f\n", name, worst);
+  check(worst < 1.5);
+}
+
+static int compare_hash(const void *left, const void *right)
+{
+  unsigned long l = *(const unsigned long *) left;
+  unsigned long r = *(const unsigned long *) right;
+  return (l > r) - (l < r);
+}
+
+static void check_distinct(const char *name, unsigned long count)
+{
+  unsigned long i;
+  unsigned long collisions = 0;
+
+  qsort(hashes, count, sizeof(unsigned long), &compare_hash);
+  for (i = 1; i < count; ++i) {
+    if (hashes[i] == hashes[i - 1]) {
+      ++collisions;
+    }
+  }
+  printf("%-24s %lu full-width collisions\n", name, collisions);
+  /* a 32-bit unsigned long expects about one collision per 2^17 pairs */
+  check(collisions <= (ULONG_BIT > 32 ? 0 : count * (count / 2) / 0x7FFFFFFFul + 4));
+}
+
+static void test_identifiers(void)
+{
+  unsigned long i;
+  char          buffer[32];
+
+  for (i = 0; i < KEY_COUNT; ++i) {
+    sprintf(buffer, "x%lu", i);
+    hashes[i] = hash_bytes(HASH_INIT, buffer, strlen(buffer));
+  }
+  check_spread("numbered identifiers", KEY_COUNT);
+  check_distinct("numbered identifiers", KEY_COUNT);
+}
+
+static void test_short_keys(void)
+{
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+
+  unsigned long count = 0;
+  unsigned long length;
+  unsigned long i, j;
+  char          buffer[3];
+
+  /* every key of up to three characters until KEY_COUNT */
+  for (length = 1; length <= 3 && count < KEY_COUNT; ++length) {
+    unsigned long total = 1;
+    for (i = 0; i < length; ++i) {
+      total *= sizeof(alphabet) - 1;
+    }
+    for (i = 0; i < total && count < KEY_COUNT; ++i) {
+      unsigned long rest = i;
+      for (j = 0; j < length; ++j) {
+        buffer[j] = alphabet[rest % (sizeof(alphabet) - 1)];
+        rest /= sizeof(alphabet) - 1;
+      }
+      hashes[count++] = hash_bytes(HASH_INIT, buffer, length);
+    }
+  }
+  check_spread("short keys", count);
+  check_distinct("short keys", count);
+}
+
+static void test_fixed_length(void)
+{
+  unsigned long length;
+  unsigned long i;
+  char          buffer[64];
+
+  /* keys that differ only in one position, for each length */
+  for (length = 1; length <= sizeof(buffer); length += length < 16 ? 1 : 16) {
+    unsigned long count = 0;
+    unsigned long position;
+
+    for (position = 0; position < length; ++position) {
+      for (i = 0; i < 256 && count < KEY_COUNT; ++i) {
+        memset(buffer, 'a', length);
+        buffer[position] = (char) i;
+        if (position > 0 && i == 'a') {
+          continue;
+        }
+        hashes[count++] = hash_bytes(HASH_INIT, buffer, length);
+      }
+    }
+    check_distinct("one differing byte", count);
+  }
+}
+
+static void test_pointers(void)
+{
+  unsigned long i;
+  Header       *headers = xmalloc(sizeof(Header) * KEY_COUNT);
+
+  for (i = 0; i < KEY_COUNT; ++i) {
+    hashes[i] = hash_pointer(headers + i);
+  }
+  check_spread("pointers, 16-byte stride", KEY_COUNT);
+  check_distinct("pointers, 16-byte stride", KEY_COUNT);
+  free(headers);
+}
+
+/* flipping any input bit should flip close to half of the output bits */
+static void test_avalanche(void)
+{
+  unsigned long bit;
+  unsigned long trial;
+  double        worst = 0.5;
+
+  for (bit = 0; bit < ULONG_BIT; ++bit) {
+    unsigned long flipped = 0;
+    double        ratio;
+
+    for (trial = 0; trial < 256; ++trial) {
+      unsigned long key  = trial * 0x10001ul + 0x1234ul;
+      unsigned long diff = hash_bytes(HASH_INIT, &key, sizeof(key));
+      key ^= 1ul << bit;
+      diff ^= hash_bytes(HASH_INIT, &key, sizeof(key));
+      flipped += popcount(&diff, sizeof(diff));
+    }
+    ratio = (double) flipped / (256.0 * ULONG_BIT);
+    if ((ratio < 0.5 ? 0.5 - ratio : ratio - 0.5) > (worst < 0.5 ? 0.5 - worst : worst - 0.5)) {
+      worst = ratio;
+    }
+  }
+  printf("%-24s worst flip ratio %.3f\n", "avalanche", worst);
+  check(worst > 0.4 && worst < 0.6);
+}
+
+int main(void)
+{
+  test_identifiers();
+  test_short_keys();
+  test_fixed_length();
+  test_pointers();
+  test_avalanche();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/*
+   Copyright 2022 Shota Minami
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "map.h"
+#include "utility.h"
+
+/* runs random operations on Map against a flat reference model; built once
+   for each backend so that map.c and map_swiss.c must agree */
+
+#define KEY_COUNT 4096
+
+#define check(cond)                                                               \
+  do {                                                                            \
+    if (!(cond)) {                                                                \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(EXIT_FAILURE);                                                         \
+    }                                                                             \
+  } while (0)
+
+static unsigned long keys[KEY_COUNT];
+static unsigned long aliases[KEY_COUNT];
+static int           present[KEY_COUNT];
+static unsigned long values[KEY_COUNT];
+static unsigned long model_count;
+
+static unsigned long random_state = 1;
+
+static unsigned long random_next(unsigned long bound)
+{
+  random_state = (random_state * 1103515245ul + 12345ul) & 0x7FFFFFFFul;
+  return (random_state >> 8) % bound;
+}
+
+static unsigned long key_hash(const void *key)
+{
+  return hash_bytes(HASH_INIT, key, sizeof(unsigned long));
+}
+
+/* four keys share each hash so that lookups have to compare keys */
+static unsigned long key_hash_colliding(const void *key)
+{
+  unsigned long value = *(const unsigned long *) key / 4;
+  return hash_bytes(HASH_INIT, &value, sizeof(unsigned long));
+}
+
+static int key_equal(const void *left, const void *right)
+{
+  return *(const unsigned long *) left == *(const unsigned long *) right;
+}
+
+static void model_reset(void)
+{
+  unsigned long i;
+  for (i = 0; i < KEY_COUNT; ++i) {
+    present[i] = 0;
+  }
+  model_count = 0;
+}
+
+static void check_lookup(Map *map, unsigned long key)
+{
+  MapIndex index;
+  int      found = map_entry(map, aliases + key, &index);
+  check(found == present[key]);
+  if (found) {
+    check(map_key(map, &index) == keys + key);
+    check(*(unsigned long *) map_value(map, &index) == values[key]);
+  }
+}
+
+static void check_all(Map *map)
+{
+  unsigned long i;
+  unsigned long seen = 0;
+  MapIndex      index;
+
+  check(map_count(map) == model_count);
+  for (map_iterator(map, &index); map_next(map, &index);) {
+    unsigned long *key = map_key(map, &index);
+    check(key >= keys && key < keys + KEY_COUNT);
+    check(present[key - keys]);
+    ++seen;
+  }
+  check(seen == model_count);
+  for (i = 0; i < KEY_COUNT; ++i) {
+    check_lookup(map, i);
+  }
+}
+
+static void insert(Map *map, unsigned long key, unsigned long value)
+{
+  MapIndex index;
+  int      found = map_entry(map, aliases + key, &index);
+  check(found == present[key]);
+  values[key] = value;
+  map_update(map, &index, keys + key, values + key);
+  if (!present[key]) {
+    present[key] = 1;
+    ++model_count;
+  }
+  check(map_key(map, &index) == keys + key);
+  check(map_count(map) == model_count);
+}
+
+static void erase(Map *map, unsigned long key)
+{
+  MapIndex index;
+  int      found = map_entry(map, aliases + key, &index);
+  check(found == present[key]);
+  if (found) {
+    map_erase(map, &index);
+    present[key] = 0;
+    --model_count;
+  }
+  check(map_count(map) == model_count);
+  check(!map_entry(map, aliases + key, &index));
+}
+
+static void run_random(Map *map, unsigned long operations)
+{
+  unsigned long i;
+
+  for (i = 0; i < operations; ++i) {
+    unsigned long key = random_next(KEY_COUNT);
+    switch (random_next(8)) {
+    case 0:
+    case 1:
+    case 2:
+      insert(map, key, random_next(1000000));
+      break;
+    case 3:
+    case 4:
+      erase(map, key);
+      break;
+    default:
+      check_lookup(map, key);
+      break;
+    }
+    if (i % 2048 == 0) {
+      check_all(map);
+    }
+  }
+  check_all(map);
+
+  map_clear(map);
+  model_reset();
+  check_all(map);
+}
+
+static void run_fill(Map *map)
+{
+  unsigned long i;
+
+  model_reset();
+  for (i = 0; i < KEY_COUNT; ++i) {
+    insert(map, i, i);
+  }
+  check_all(map);
+  for (i = 0; i < KEY_COUNT; i += 2) {
+    erase(map, i);
+  }
+  check_all(map);
+  for (i = 0; i < KEY_COUNT; ++i) {
+    insert(map, i, i * 3);
+  }
+  check_all(map);
+}
+
+static void run_reserve(void)
+{
+  unsigned long i;
+  Map          *map = map_new_with_capacity(KEY_COUNT, &key_hash, &key_equal);
+
+  model_reset();
+  for (i = 0; i < KEY_COUNT / 2; ++i) {
+    insert(map, i * 2 + 1, i);
+  }
+  map_reserve(map, KEY_COUNT * 4);
+  check_all(map);
+  map_free(map);
+}
+
+static void run_default_hasher(void)
+{
+  unsigned long i;
+  MapIndex      index;
+  Map          *map = map_new(NULL, NULL);
+
+  for (i = 0; i < KEY_COUNT; ++i) {
+    check(!map_entry(map, keys + i, &index));
+    map_update(map, &index, keys + i, values + i);
+  }
+  check(map_count(map) == KEY_COUNT);
+  for (i = 0; i < KEY_COUNT; ++i) {
+    check(map_entry(map, keys + i, &index));
+    check(map_value(map, &index) == values + i);
+    check(!map_entry(map, aliases + i, &index));
+  }
+  map_free(map);
+}
+
+int main(void)
+{
+  unsigned long i;
+  Map          *map;
+
+  for (i = 0; i < KEY_COUNT; ++i) {
+    keys[i]    = i;
+    aliases[i] = i;
+  }
+
+  map = map_new(&key_hash, &key_equal);
+  run_fill(map);
+  run_random(map, 200000);
+  map_free(map);
+
+  map = map_new(&key_hash_colliding, &key_equal);
+  run_fill(map);
+  run_random(map, 200000);
+  map_free(map);
+
+  run_reserve();
+  run_default_hasher();
+  return EXIT_SUCCESS;
+}